@@ -40,6 +40,12 @@ PyAPI_FUNC(int) _PyDict_DelItem_KnownHash(PyObject *mp, PyObject *key,
                                           Py_hash_t hash);
 PyAPI_FUNC(int) _PyDict_DelItemIf(PyObject *mp, PyObject *key,
                                   int (*predicate)(PyObject *value));
+/* PyDict_SetItem() and PyDict_DelItem() for a change that is logged to the
+   rewind log with a DICT_* event if rewindLog is 1, noted if it is 0, or
+   logged by the caller if it is REWIND_CALLER_LOGS, see Include/rewind.h */
+#define REWIND_CALLER_LOGS 2
+int _PyDict_SetItem(PyObject *mp, PyObject *key, PyObject *item, char rewindLog);
+int _PyDict_DelItem(PyObject *mp, PyObject *key, char rewindLog);
 PyDictKeysObject *_PyDict_NewKeysForClass(void);
 PyAPI_FUNC(int) _PyDict_Next(
     PyObject *mp, Py_ssize_t *pos, PyObject **key, PyObject **value, Py_hash_t *hash);
@@ -1,9 +1,27 @@
+#ifndef Py_REWIND_H
+#define Py_REWIND_H
+
 #include "Python.h"
+#include "rewindlog.h"
+
+void Rewind_Activate(const wchar_t *filename, const wchar_t *options);
 
-void Rewind_Activate(const wchar_t * filename);
+int Rewind_Start(PyObject *path, const wchar_t *options);
 
 void Rewind_Deactivate(void);
 
+void Rewind_Pause(void);
+
+void Rewind_Resume(void);
+
+int Rewind_IsRecording(void);
+
+void Rewind_FatalError(void);
+
+int Rewind_Dump(void);
+
+void Rewind_AfterForkChild(void);
+
 int Rewind_isSimpleType(PyObject *obj);
 
 void Rewind_Cleanup(void);
@@ -30,7 +48,9 @@ void Rewind_ListClear(PyListObject *list);
 
 void Rewind_ListReverse(PyListObject *list);
 
-void Rewind_ListSort(PyListObject *list);
+PyObject **Rewind_ListSortBegin(PyListObject *list);
+
+void Rewind_ListSort(PyListObject *list, PyObject **before, int modified);
 
 void Rewind_ListStoreSubscript(PyListObject *list, PyObject* item, PyObject* value);
 
@@ -58,19 +78,23 @@ void Rewind_SetDiscard(PySetObject *set, PyObject *item);
 
 void Rewind_SetClear(PySetObject *set);
 
-void Rewind_SetUpdate(PySetObject *set);
+PyObject **Rewind_SetUpdateBegin(PySetObject *set);
 
-void Rewind_YieldValue(PyObject *retval);
+void Rewind_SetUpdate(PySetObject *set, PyObject **before);
+
+void Rewind_YieldValue(PyFrameObject *frame, PyObject *retval);
 
 void Rewind_StoreName(PyObject *ns, PyObject *name, PyObject *value);
 
-void Rewind_StoreFast(int index, PyObject *value);
+void Rewind_StoreFast(PyFrameObject *frame, int index, PyObject *value);
 
 void Rewind_StoreGlobal(PyObject *ns, PyObject *name, PyObject *value);
 
+void Rewind_JumpAbsolute(PyFrameObject *frame, int target);
+
 void Rewind_DeleteGlobal(PyObject *ns, PyObject *name);
 
-void Rewind_ReturnValue(PyObject *retval);
+void Rewind_ReturnValue(PyFrameObject *frame, PyObject *retval);
 
 void Rewind_SetAttr(PyObject *obj, PyObject *attr, PyObject *value);
 
@@ -78,11 +102,95 @@ void Rewind_StringInPlaceAdd(PyObject *left, PyObject *right, PyObject *result);
 
 void Rewind_Dealloc(PyObject *obj);
 
+// One counter per address bucket of how many logged objects live in it, or
+// NULL when not recording. Lets _Py_Dealloc skip Rewind_Dealloc for the
+// objects that were never logged with a single load.
+#define REWIND_TRACKED_FILTER_SIZE (1 << 20)
+
+PyAPI_DATA(unsigned char *) Rewind_TrackedFilter;
+
+static inline size_t Rewind_TrackedFilterSlot(PyObject *obj) {
+    // objects are 16 byte aligned in practice, drop those bits
+    return ((uintptr_t)obj >> 4) & (REWIND_TRACKED_FILTER_SIZE - 1);
+}
+
+static inline int Rewind_MaybeTracked(PyObject *obj) {
+    unsigned char *filter = Rewind_TrackedFilter;
+    return filter != NULL && filter[Rewind_TrackedFilterSlot(obj)] != 0;
+}
+
+// Changes to lists, dicts and sets that no hook above logs, such as those C
+// code makes with PyList_SetItem() or PyDict_SetItem(). On the first since
+// the log last caught up with a container it knows,
+// Rewind_ContainerChanging copies the items of the container into a table
+// of the recorder's, and before the next event that could depend on them,
+// at the latest the next frame boundary, the recorder logs what changed
+// since. So the changes are not logged one by one, and containers the log
+// doesn't know, most of them, cost no more than Rewind_MaybeTracked.
+// Functions that take a rewindLog argument log the change themselves if it
+// is 1, and note it if it is 0, just before making it: code that runs in
+// between, such as a key's __eq__, may start a frame and so catch up.
+PyAPI_FUNC(void) Rewind_ContainerChanging(PyObject *op);
+
+static inline void Rewind_Changing(PyObject *op) {
+    if (Rewind_MaybeTracked(op)) {
+        Rewind_ContainerChanging(op);
+    }
+}
+
+// Called before a change that isn't logged, with the container's type
+// checked already.
+static inline void Rewind_ListChanging(PyListObject *list) {
+    Rewind_Changing((PyObject *)list);
+}
+
+static inline void Rewind_DictChanging(PyDictObject *dict) {
+    Rewind_Changing((PyObject *)dict);
+}
+
+static inline void Rewind_SetChanging(PySetObject *set) {
+    Rewind_Changing((PyObject *)set);
+}
+
+// What the program takes from outside: the "inputs" option logs that
+// rather than every event, and the "replay" option feeds it back from such
+// a log to another run of the program, which is then as deterministic as
+// the inputs logged make it. Rewind_InputMode is one of these, or 0. These
+// are exported for the extension modules that take inputs, such as _socket.
+#define REWIND_INPUTS_RECORD 1
+#define REWIND_INPUTS_REPLAY 2
+
+PyAPI_DATA(int) Rewind_InputMode;
+
+PyAPI_FUNC(void) Rewind_ClockInput(_PyTime_t *t);
+
+// A reading of a clock: logs it, or when replaying, replaces it by the one
+// logged.
+static inline void Rewind_Clock(_PyTime_t *t) {
+    if (Rewind_InputMode != 0) {
+        Rewind_ClockInput(t);
+    }
+}
+
+PyAPI_FUNC(Py_ssize_t) Rewind_ReplayData(int source, void *buf, size_t count);
+
+PyAPI_FUNC(void) Rewind_LogData(int source, const void *buf, Py_ssize_t n, int err);
+
+PyAPI_FUNC(Py_ssize_t) Rewind_ReadInput(int fd, void *buf, size_t count);
+
+// _Py_read(), for reads whose data is an input of the program
+static inline Py_ssize_t Rewind_Read(int fd, void *buf, size_t count) {
+    if (Rewind_InputMode == 0) {
+        return _Py_read(fd, buf, count);
+    }
+    return Rewind_ReadInput(fd, buf, count);
+}
+
 void Rewind_FlushDeallocatedIds(void);
 
 void Rewind_TrackObject(PyObject *obj);
 
-void Rewind_serializeObject(FILE *file, PyObject *obj);
+void Rewind_serializeObject(PyObject *obj);
 
 void Rewind_Log(char *message);
 
@@ -90,4 +198,10 @@ void printObject(FILE *file, PyObject *obj);
 
 void printStack(FILE *file, PyObject **stack_pointer, int level);
 
-void logOp(char *label, PyObject **stack_pointer, int level, PyFrameObject *frame, int oparg);
\ No newline at end of file
+void logOp(char *label, PyObject **stack_pointer, int level, PyFrameObject *frame, int oparg,
+           PyCodeAddressRange *bounds);
+
+// _PyEval_EvalFrameDefault with the hooks that follow the running frame
+PyObject *_PyEval_EvalFrameRewind(PyThreadState *tstate, PyFrameObject *f, int throwflag);
+
+#endif /* !Py_REWIND_H */
@@ -0,0 +1,227 @@
+#ifndef Py_REWINDLOG_H
+#define Py_REWINDLOG_H
+
+/* Binary format of .rewind log files.
+
+   A log starts with REWIND_LOG_MAGIC, a REWIND_LOG_VERSION byte and a
+   REWIND_COMPRESS_* byte giving how the data of its blocks is stored. The
+   rest of the log is a sequence of blocks, each of which starts with a
+   REWIND_BLOCK_HEADER_SIZE byte header of little endian integers:
+
+     u32  size of the block data that follows the header, as stored
+     u32  size of the block data once decompressed
+     u64  index of the first event in the block, counting from 0 (LOG
+          events are not counted)
+     u32  smallest line number VISITed in the block, 0 if there is none
+     u32  largest line number VISITed in the block, 0 if there is none
+     u32  REWIND_BLOCK_* flags
+
+   so readers can skip from block to block without decompressing any.
+   The data of a block is a sequence of whole events, compressed on its
+   own if the log is compressed. Symbols and the bases of heap ids and line
+   numbers start afresh in each block, which can therefore be decoded
+   without reading the ones before it.
+
+   Each event is a single opcode byte followed by its fields, in the order
+   given by the layout next to each opcode below:
+
+     h  heap id: zigzag varint of the difference to one of the last two
+        heap ids written in the block (both start out as 0), shifted left
+        by one bit; the freed low bit tells which of the two it is relative
+        to, and that one is then replaced by the new id
+     l  line number: zigzag varint of the difference to the previous line
+        number written in the block (starting out as 0)
+     u  unsigned varint (LEB128)
+     i  signed varint (zigzag, then LEB128)
+     s  symbol: unsigned varint, 0 for a new symbol followed by its text
+        (as in t), otherwise the index of a previous symbol plus 1
+     t  text: unsigned varint byte length followed by UTF-8 data
+     c  code object: unsigned varint, 0 for a new code object followed by
+        its file name and function name (as in s) and the names of its
+        local, cell and free variables (each as in #s), otherwise the index
+        of a previous code object plus 1
+     v  value: one REWIND_VALUE_* tag byte followed by its payload
+     #x unsigned varint count n, followed by n fields of kind x; readers
+        pass n and then the n fields on as arguments
+     *x same as #x, but readers pass on only the n fields
+
+   Symbols are strings that recur across events (file, function and variable
+   names, and the text of strings the program makes over and over). The
+   text of a symbol is written once per block, where it is first used;
+   symbols are numbered from 0 in the order they first appear in the block.
+   Code objects are numbered the same way, so the names of a function are
+   written once per block rather than on every call. Likewise a
+   NEW_TUPLE_COPY event refers to the NEW_TUPLE event earlier in the block
+   that gave the same items, and readers pass on a NEW_TUPLE event with
+   those items in its place.
+
+   The events of all threads are logged in the order they run, in one
+   sequence. A THREAD event gives the id of the thread the events after it
+   come from, up to the next THREAD event; every block starts with one, as
+   do the events after a checkpoint. Ids are those of the thread states of
+   the interpreter, from 1 up, and are never reused. The first instruction
+   a thread runs after another thread was on a line always VISITs its line;
+   a new block or a checkpoint doesn't make it VISIT its line again.
+
+   Objects are given by NEW_* events the first time the log refers to them,
+   along with the objects they refer to in turn, which may come after them.
+   A large structure is only given up to a point: the objects past that are
+   given once the program stores, passes or changes them, as they are then.
+   Until its NEW_* event, readers don't know what an object holds.
+
+   Changes to lists, dicts and sets that are made without a method of
+   theirs, such as by C code, are logged late: before the next event for
+   any container, frame or checkpoint, as the LIST_SPLICE,
+   LIST_STORE_SUBSCRIPT, DICT_DELETE_SUBSCRIPT, DICT_STORE_SUBSCRIPT or
+   SET_UPDATE events that get from what the log gave the container to what
+   it holds then. Other mutable containers, such as bytearray, array.array
+   and collections.deque, are given as opaque objects, whose changes the
+   log doesn't follow.
+
+   A block flagged REWIND_BLOCK_CHECKPOINT starts with a checkpoint: a
+   CHECKPOINT event, a NEW_* event for every object known at that point
+   (followed by STORE_ATTR events for the attributes of instances of
+   classes and a STORE_DEREF event for the contents of cells), a PUSH_FRAME
+   event for every frame on the stacks that the log has pushed and not
+   popped, with the current values of its variables, a VISIT event for the
+   line the program is on, if any, which is not a step, and a
+   CHECKPOINT_END event. The frames of each thread come after a THREAD
+   event for it, outermost first. That is all it takes to replay the rest
+   of the log without the blocks before. The events of a checkpoint are not
+   counted as events, and a checkpoint never spans blocks. Readers going
+   through the log from the start skip checkpoints.
+
+   A log of inputs, as written with the "inputs" recording option, holds
+   nothing but THREAD and INPUT events: what the program took from outside
+   (the REWIND_INPUT_* sources below), in the order it took it, so that a
+   run of the program with the "replay" option can be fed the same.
+
+   A block also flagged REWIND_BLOCK_RESYNC comes after a stretch of the
+   program that wasn't logged: recording was paused, started from running
+   code or while frames pushed by an earlier recording still ran, or, in a
+   log dumped by the flight recorder, the blocks before were dropped.
+   Readers replay the checkpoint of such a block instead of skipping it,
+   after which they have the stack it gives and no other.
+
+   Readers make steps of the events from the first PUSH_FRAME of code
+   from a source file on, which leaves out the frozen code that gets the
+   interpreter to run a script, or from the first checkpoint they replay
+   on, whichever comes first. Events may come with no frame on the stack:
+   those of frames that were running when recording started, which the log
+   never pushes.
+
+   With the "sample" recording option, the calls and loop iterations of
+   hot code past the first few are left out of the log, but for every so
+   many. A call left out has no PUSH_FRAME, POP_FRAME or any other event of
+   its frame, nor have the calls it makes; they are summed up in an ELIDED
+   event, after the event the call was made at, giving the code called and
+   how many calls were left out. Iterations left out have no VISIT,
+   STORE_FAST or other event of their frame, nor have the calls they make;
+   once a logged event of the frame follows, an ELIDED event gives its code,
+   the calls left out and the iterations, preceded by STORE_FAST events for
+   the variables the iterations changed. Changes to the heap are logged
+   all the same.
+
+   rewindlog.py in the root of the repository is the reference reader; keep
+   it in sync with this file. */
+
+#define REWIND_LOG_MAGIC "RWND"
+#define REWIND_LOG_VERSION 11
+#define REWIND_BLOCK_HEADER_SIZE 28
+
+/* Block header flags */
+enum {
+    REWIND_BLOCK_CHECKPOINT = 1,    /* the block starts with a checkpoint */
+    REWIND_BLOCK_RESYNC = 2,        /* and readers must replay it */
+};
+
+enum {
+    REWIND_COMPRESS_NONE = 0,
+    REWIND_COMPRESS_ZLIB,       /* each block is a zlib stream */
+};
+
+enum {
+    REWIND_LOG = 1,                         /* t */
+    REWIND_VISIT,                           /* l */
+    REWIND_PUSH_FRAME,                      /* c h h *v */
+    REWIND_POP_FRAME,                       /* s s */
+    REWIND_STORE_DEREF,                     /* h v */
+    REWIND_LIST_APPEND,                     /* h v */
+    REWIND_LIST_INSERT,                     /* h i v */
+    REWIND_LIST_EXTEND,                     /* h v */
+    REWIND_LIST_REMOVE,                     /* h v */
+    REWIND_LIST_POP,                        /* h i */
+    REWIND_LIST_CLEAR,                      /* h */
+    REWIND_LIST_REVERSE,                    /* h */
+    REWIND_LIST_SORT,                       /* h *v, the sorted list */
+    REWIND_LIST_STORE_SUBSCRIPT,            /* h v v */
+    REWIND_LIST_STORE_SUBSCRIPT_SLICE,      /* h v v v v */
+    REWIND_LIST_DELETE_SUBSCRIPT,           /* h v */
+    REWIND_LIST_DELETE_SUBSCRIPT_SLICE,     /* h v v v */
+    REWIND_DICT_STORE_SUBSCRIPT,            /* h v v */
+    REWIND_DICT_DELETE_SUBSCRIPT,           /* h v */
+    REWIND_DICT_UPDATE,                     /* h v */
+    REWIND_DICT_CLEAR,                      /* h */
+    REWIND_DICT_POP,                        /* h v */
+    REWIND_DICT_POP_ITEM,                   /* h v */
+    REWIND_DICT_SET_DEFAULT,                /* h v v */
+    REWIND_SET_ADD,                         /* h v */
+    REWIND_SET_DISCARD,                     /* h v */
+    REWIND_SET_CLEAR,                       /* h */
+    REWIND_SET_UPDATE,                      /* h #v (added) #v (removed) */
+    REWIND_YIELD_VALUE,                     /* v */
+    REWIND_RETURN_VALUE,                    /* v */
+    REWIND_STORE_NAME,                      /* h v v */
+    REWIND_STORE_FAST,                      /* u v */
+    REWIND_STORE_GLOBAL,                    /* h v v */
+    REWIND_DELETE_GLOBAL,                   /* h s */
+    REWIND_STORE_ATTR,                      /* h v v */
+    REWIND_STRING_INPLACE_ADD_RESULT,       /* h t */
+    REWIND_NEW_LIST,                        /* h *v */
+    REWIND_NEW_STRING,                      /* h s */
+    REWIND_NEW_DICT,                        /* h *v (key, value, ...) */
+    REWIND_NEW_SET,                         /* h *v */
+    REWIND_NEW_TUPLE,                       /* h *v */
+    REWIND_NEW_OBJECT,                      /* h v */
+    REWIND_CHECKPOINT,                      /* u, index of the next event */
+    REWIND_CHECKPOINT_END,                  /* no fields */
+    REWIND_LIST_PERMUTE,                    /* h *u (old index, length, ...) */
+    REWIND_THREAD,                          /* u, id of the thread state */
+    REWIND_INPUT,                           /* u v, REWIND_INPUT_* source and
+                                               what it gave */
+    REWIND_LIST_SPLICE,                     /* h u u *v, items from start up
+                                               to stop replaced by those */
+    REWIND_NEW_TUPLE_COPY,                  /* h u, index of the NEW_TUPLE
+                                               event in the block, from 0 */
+    REWIND_ELIDED,                          /* c u u, code, calls and loop
+                                               iterations left out */
+};
+
+/* Tags of "v" fields */
+enum {
+    REWIND_VALUE_NONE = 0,
+    REWIND_VALUE_FALSE,
+    REWIND_VALUE_TRUE,
+    REWIND_VALUE_INT,       /* i */
+    REWIND_VALUE_BIGINT,    /* t, decimal digits */
+    REWIND_VALUE_FLOAT,     /* 8 bytes, IEEE 754 double, little endian */
+    REWIND_VALUE_REF,       /* h */
+    REWIND_VALUE_BYTES,     /* unsigned varint length, then the bytes */
+};
+
+/* Sources of INPUT events. Data is given as BYTES, a read that failed as
+   the INT errno it failed with. */
+enum {
+    REWIND_INPUT_ARGV = 0,      /* sys.argv, each item encoded with the file
+                                   system encoding and followed by a NUL */
+    REWIND_INPUT_ENVIRON,       /* os.environ as name=value items, the same */
+    REWIND_INPUT_HASH_SEED,     /* INT PYTHONHASHSEED, NONE if random */
+    REWIND_INPUT_CLOCK,         /* INT nanoseconds, any clock of time */
+    REWIND_INPUT_URANDOM,       /* os.urandom() */
+    REWIND_INPUT_RANDOM_SEED,   /* seed of a random.Random from the system */
+    REWIND_INPUT_READ,          /* read from a file descriptor */
+    REWIND_INPUT_RECV,          /* received from a socket */
+    REWIND_INPUT_SOURCES
+};
+
+#endif /* !Py_REWINDLOG_H */
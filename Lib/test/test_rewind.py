@@ -0,0 +1,349 @@
+# tests recording programs with -X rewind and recreating their past
+
+import importlib.util
+import json
+import os
+import re
+import signal
+import sqlite3
+import subprocess
+import sys
+import textwrap
+import unittest
+from test import support
+from test.support import import_helper
+from test.support import os_helper
+from test.support.script_helper import make_script, assert_python_ok
+
+# recreate.py lives at the root of the source tree, next to Lib
+SOURCE_DIR = os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+RECREATE = os.path.join(SOURCE_DIR, 'recreate.py')
+if not os.path.isfile(RECREATE):
+    raise unittest.SkipTest('recreate.py not found')
+import_helper.import_module('_rewind')
+with import_helper.DirsOnSysPath(SOURCE_DIR):
+    import recreate
+    import rewindlog
+
+# a program that runs long enough to cross many checkpoints
+loop_source = """\
+def collatz(n):
+    steps = 0
+    while n != 1:
+        n = n // 2 if n % 2 == 0 else 3 * n + 1
+        steps += 1
+    return steps
+
+lengths = {}
+for i in range(1, 200):
+    lengths[i] = collatz(i)
+longest = max(lengths, key=lengths.get)
+"""
+
+
+class RewindTestBase(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = os_helper.TESTFN + '_rewind'
+        os.mkdir(self.dir)
+        self.addCleanup(os_helper.rmtree, self.dir)
+
+    def record(self, source, options, name='script', log=None):
+        """Runs source as a script recorded with options, and returns the
+        path of its log, which the script is also given as its argument."""
+        script = make_script(self.dir, name, textwrap.dedent(source))
+        if log is None:
+            log = os.path.join(self.dir, name + '.rewind')
+        assert_python_ok('-X', 'rewind=' + options, script, log)
+        self.assertTrue(os.path.isfile(log))
+        return log
+
+    def recreate(self, log, native=True):
+        """Recreates the past from log with the native importer, or else
+        recreate_past, and returns the connection to the database."""
+        conn = sqlite3.connect(':memory:')
+        self.addCleanup(conn.close)
+        recreate.define_schema(conn)
+        if native:
+            if recreate.recreate_native is None:
+                self.skipTest('_rewindimport not built')
+            recreate.recreate_native(conn, log)
+        else:
+            # it tells how far it got
+            with support.captured_stdout():
+                recreate.recreate_past(conn, log)
+        return conn
+
+    def steps(self, conn):
+        return conn.execute('SELECT f.fun_name, s.line_no FROM Snapshot s '
+                            'JOIN FunCall f ON f.id = s.fun_call_id '
+                            'ORDER BY s.id').fetchall()
+
+    def data(self, conn, heap_id, version):
+        """Returns the object heap_id as of heap version, with the objects
+        it refers to given as '^id' strings."""
+        data, = conn.execute('SELECT o.data FROM HeapRef h '
+                             'JOIN Object o ON o.id = h.object_id '
+                             'WHERE h.id = ? AND h.heap_version <= ? '
+                             'ORDER BY h.heap_version DESC LIMIT 1',
+                             (heap_id, version)).fetchone()
+        return json.loads(re.sub(r'\^(\d+)', r'"^\1"', data))
+
+    def value(self, conn, ref, version):
+        """Returns the value of the object that the '^id' string ref refers
+        to as of heap version, for lists, dicts and strings."""
+        def resolve(value):
+            if isinstance(value, str) and value.startswith('^'):
+                return self.value(conn, value, version)
+            if isinstance(value, list):
+                return [resolve(item) for item in value]
+            if isinstance(value, dict):
+                return {resolve(key): resolve(item) for key, item in value.items()}
+            return value
+        return resolve(self.data(conn, int(ref[1:]), version))
+
+
+class CheckpointTests(RewindTestBase):
+
+    def test_checkpoints_add_no_steps(self):
+        # a checkpoint, and the block it starts, don't VISIT the line the
+        # program is on again
+        plain = self.record(loop_source, '', 'plain')
+        checkpoints = self.record(loop_source, 'checkpoint=50', 'checkpoints')
+        for native in (True, False):
+            with self.subTest(native=native):
+                expected = self.steps(self.recreate(plain, native))
+                self.assertGreater(len(expected), 1000)
+                self.assertEqual(self.steps(self.recreate(checkpoints, native)),
+                                 expected)
+
+
+class StartTests(RewindTestBase):
+
+    def check_steps(self, log, expected):
+        """Checks that both importers give the steps in expected, and
+        returns the connections to their databases."""
+        conns = []
+        for native in (True, False):
+            with self.subTest(native=native):
+                conn = self.recreate(log, native)
+                steps = self.steps(conn)
+                for step in expected:
+                    self.assertIn(step, steps)
+                conns.append(conn)
+        return conns
+
+    def test_recording_in_function(self):
+        log = self.record("""\
+            import sys, _rewind
+
+            def square(x):
+                y = x * x
+                return y
+
+            def main():
+                with _rewind.recording(sys.argv[1]):
+                    values = [square(i) for i in range(5)]
+                return values
+
+            main()
+            """, 'off')
+        self.check_steps(log, [('<listcomp>', 9), ('square', 4), ('square', 5)])
+
+    def test_start_in_module(self):
+        # the stores of the module, whose frame the log never pushes, have
+        # no call on the stack
+        log = self.record("""\
+            import sys, threading, _rewind
+
+            def square(x):
+                y = x * x
+                return y
+
+            def cube(x):
+                return x * square(x)
+
+            _rewind.start(sys.argv[1], 'sample=3/2')
+            values = [square(i) for i in range(10)]
+            thread = threading.Thread(target=cube, args=(7,))
+            thread.start()
+            thread.join()
+            total = sum(values)
+            _rewind.stop()
+            """, 'off')
+        for conn in self.check_steps(log, [('<listcomp>', 11), ('square', 4),
+                                           ('cube', 8)]):
+            threads = conn.execute('SELECT count(DISTINCT thread_id) FROM FunCall '
+                                   'WHERE fun_name IN (?, ?)',
+                                   ('<listcomp>', 'cube')).fetchone()[0]
+            self.assertEqual(threads, 2)
+
+    def test_failed_start_keeps_no_options(self):
+        log = self.record("""\
+            import os, sys, _rewind
+
+            def square(x):
+                return x * x
+
+            missing = os.path.join(os.path.dirname(sys.argv[1]), 'missing', 'x.rewind')
+            try:
+                _rewind.start(missing, 'include=nothing.*,sample=1')
+            except OSError:
+                pass
+            else:
+                raise AssertionError('recording into ' + missing)
+            with _rewind.recording(sys.argv[1]):
+                square(3)
+            """, 'off')
+        self.check_steps(log, [('square', 4)])
+
+    @unittest.skipUnless(os_helper.TESTFN_UNDECODABLE, 'need an undecodable file name')
+    def test_undecodable_path(self):
+        log = os.fsdecode(os.path.join(os.fsencode(self.dir),
+                                       os_helper.TESTFN_UNDECODABLE + b'.rewind'))
+        self.record("""\
+            import sys, _rewind
+
+            def square(x):
+                return x * x
+
+            with _rewind.recording(sys.argv[1]):
+                square(3)
+            """, 'off', log=log)
+        self.check_steps(log, [('square', 4)])
+
+
+class FlightTests(RewindTestBase):
+
+    @unittest.skipUnless(hasattr(signal, 'SIGUSR2'), 'need signal.SIGUSR2')
+    def test_sigusr2(self):
+        # SIGUSR2 dumps the log and still reaches the handler the program
+        # had, which gets it back after the recording
+        log = self.record("""\
+            import os, signal, sys, _rewind
+
+            def square(x):
+                return x * x
+
+            hits = []
+            signal.signal(signal.SIGUSR2, lambda signum, frame: hits.append(signum))
+            _rewind.start(sys.argv[1], 'flight')
+            square(3)
+            os.kill(os.getpid(), signal.SIGUSR2)
+            square(4)
+            _rewind.stop()
+            os.kill(os.getpid(), signal.SIGUSR2)
+            assert hits == [signal.SIGUSR2] * 2, hits
+            """, 'off')
+        self.assertIn(('square', 4), self.steps(self.recreate(log)))
+
+
+class ContainerTests(RewindTestBase):
+
+    def test_changes_through_c_api(self):
+        # heapq swaps items in place, and Counter.update counts into the
+        # dict itself, without the hooks that log stores
+        log = self.record("""\
+            import collections, heapq
+
+            def build():
+                heap = []
+                for x in [5, 3, 8, 1, 9, 2, 7]:
+                    heapq.heappush(heap, x)
+                smallest = heapq.heappop(heap)
+                heapq.heapify(heap)
+                counts = collections.Counter({'z': 1})
+                counts.update('abracadabra')
+                return smallest
+
+            build()
+            """, '')
+        for native in (True, False):
+            with self.subTest(native=native):
+                conn = self.recreate(log, native)
+                call, locals_id = conn.execute("SELECT id, locals FROM FunCall "
+                                               "WHERE fun_name = 'build'").fetchone()
+                version, = conn.execute('SELECT max(heap) FROM Snapshot '
+                                        'WHERE fun_call_id = ?', (call,)).fetchone()
+                variables = self.data(conn, locals_id, version)
+                self.assertEqual(self.value(conn, variables['heap'], version),
+                                 [2, 3, 7, 5, 9, 8])
+                self.assertEqual(self.value(conn, variables['counts'], version),
+                                 {'z': 1, 'a': 5, 'b': 2, 'r': 2, 'c': 1, 'd': 1})
+
+
+class InputTests(RewindTestBase):
+
+    def run_script(self, script, options, stdin):
+        """Runs script with options, given stdin, and returns its output;
+        it writes the bytecode of what it imports."""
+        env = dict(os.environ)
+        env.pop('PYTHONDONTWRITEBYTECODE', None)
+        process = subprocess.run([sys.executable, '-X', 'rewind=' + options, script],
+                                 input=stdin, stdout=subprocess.PIPE,
+                                 stderr=subprocess.PIPE, text=True, env=env)
+        self.assertEqual(process.returncode, 0, process.stderr)
+        return process.stdout
+
+    def test_replay(self):
+        # the module next to the script is compiled when the inputs are
+        # logged and loaded from its bytecode when they are replayed, which
+        # makes no difference as imports aren't inputs
+        make_script(self.dir, 'helper', 'def twice(x):\n    return 2 * x\n')
+        script = make_script(self.dir, 'inputs', textwrap.dedent("""\
+            import json, os, random, sys, time
+            import email.utils
+            import helper
+
+            print(time.time(), time.monotonic())
+            print(random.random(), helper.twice(random.randrange(100)))
+            print(os.urandom(8).hex())
+            print(json.dumps(sys.stdin.readline()))
+            """))
+        recorded = self.run_script(script, 'inputs', 'first line\n')
+        log = os.path.join(self.dir, 'inputs.inputs.rewind')
+        self.assertTrue(os.path.isfile(log))
+        self.assertTrue(os.path.isfile(importlib.util.cache_from_source(
+            os.path.join(self.dir, 'helper.py'))))
+        replayed = self.run_script(script, 'replay=' + log, 'second line\n')
+        self.assertEqual(replayed, recorded)
+        self.assertIn('"first line\\n"', replayed)
+
+        # only what the script read from stdin, none of what it imported
+        reads = [args[1] for name, args in rewindlog.read_log(log)
+                 if name == 'INPUT' and rewindlog.INPUT_SOURCES[args[0]] == 'READ']
+        self.assertEqual(b''.join(reads), b'first line\n')
+
+
+class FilterTests(RewindTestBase):
+
+    def test_include_filter(self):
+        # the module isn't recorded, but what it stores in its globals is
+        log = self.record("""\
+            def handler(x):
+                y = x + 1
+                return y
+
+            def other(x):
+                return handler(x) * 2
+
+            results = [other(i) for i in range(300)]
+            total = sum(results)
+            """, 'include=*.handler,checkpoint=100')
+        # in one go and in segments, which replay checkpoints
+        for args in ([], ['-j', '3']):
+            with self.subTest(args=args):
+                # recreate.py imports rewindlog from its own directory
+                assert_python_ok('-X', 'rewind=off', RECREATE, *args, log,
+                                 __isolated=False)
+                conn = sqlite3.connect(os.path.splitext(log)[0] + '.sqlite')
+                try:
+                    steps = self.steps(conn)
+                finally:
+                    conn.close()
+                self.assertEqual(steps, [('handler', 2), ('handler', 3),
+                                         ('handler', 3)] * 300)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -8,6 +8,7 @@ annotated by François Pinard, and converted to C by Raymond Hettinger.
 
 #include "Python.h"
 #include "pycore_list.h"          // _PyList_ITEMS()
+#include "rewind.h"               // Rewind_ListChanging()
 
 #include "clinic/_heapqmodule.c.h"
 
@@ -55,6 +56,7 @@ siftdown(PyListObject *heap, Py_ssize_t startpos, Py_ssize_t pos)
         arr = _PyList_ITEMS(heap);
         parent = arr[parentpos];
         newitem = arr[pos];
+        Rewind_ListChanging(heap);
         arr[parentpos] = newitem;
         arr[pos] = parent;
         pos = parentpos;
@@ -104,6 +106,7 @@ siftup(PyListObject *heap, Py_ssize_t pos)
         /* Move the smaller child up. */
         tmp1 = arr[childpos];
         tmp2 = arr[pos];
+        Rewind_ListChanging(heap);
         arr[childpos] = tmp2;
         arr[pos] = tmp1;
         pos = childpos;
@@ -158,6 +161,7 @@ heappop_internal(PyObject *heap, int siftup_func(PyListObject *, Py_ssize_t))
     if (!n)
         return lastelt;
     returnitem = PyList_GET_ITEM(heap, 0);
+    Rewind_ListChanging((PyListObject *)heap);
     PyList_SET_ITEM(heap, 0, lastelt);
     if (siftup_func((PyListObject *)heap, 0)) {
         Py_DECREF(returnitem);
@@ -194,6 +198,7 @@ heapreplace_internal(PyObject *heap, PyObject *item, int siftup_func(PyListObjec
 
     returnitem = PyList_GET_ITEM(heap, 0);
     Py_INCREF(item);
+    Rewind_ListChanging((PyListObject *)heap);
     PyList_SET_ITEM(heap, 0, item);
     if (siftup_func((PyListObject *)heap, 0)) {
         Py_DECREF(returnitem);
@@ -271,6 +276,7 @@ _heapq_heappushpop_impl(PyObject *module, PyObject *heap, PyObject *item)
 
     returnitem = PyList_GET_ITEM(heap, 0);
     Py_INCREF(item);
+    Rewind_ListChanging((PyListObject *)heap);
     PyList_SET_ITEM(heap, 0, item);
     if (siftup((PyListObject *)heap, 0)) {
         Py_DECREF(returnitem);
@@ -424,6 +430,7 @@ siftdown_max(PyListObject *heap, Py_ssize_t startpos, Py_ssize_t pos)
         arr = _PyList_ITEMS(heap);
         parent = arr[parentpos];
         newitem = arr[pos];
+        Rewind_ListChanging(heap);
         arr[parentpos] = newitem;
         arr[pos] = parent;
         pos = parentpos;
@@ -473,6 +480,7 @@ siftup_max(PyListObject *heap, Py_ssize_t pos)
         /* Move the smaller child up. */
         tmp1 = arr[childpos];
         tmp2 = arr[pos];
+        Rewind_ListChanging(heap);
         arr[childpos] = tmp2;
         arr[pos] = tmp1;
         pos = childpos;
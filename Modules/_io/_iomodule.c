@@ -520,7 +520,12 @@ static PyObject *
 _io_open_code_impl(PyObject *module, PyObject *path)
 /*[clinic end generated code: output=2fe4ecbd6f3d6844 input=f5c18e23f4b2ed9f]*/
 {
-    return PyFile_OpenCodeObject(path);
+    PyObject *file = PyFile_OpenCodeObject(path);
+    if (file != NULL && _PyFileIO_MarkCode(file) < 0) {
+        Py_DECREF(file);
+        return NULL;
+    }
+    return file;
 }
 
 /*
@@ -48,6 +48,10 @@ extern int _PyIOBase_finalize(PyObject *self);
    Doesn't check the argument type, so be careful! */
 extern int _PyFileIO_closed(PyObject *self);
 
+/* Marks the FileIO object file, or the one a buffered file reads from, as
+   holding code, whose reads aren't logged as inputs of the program. */
+extern int _PyFileIO_MarkCode(PyObject *file);
+
 /* Shortcut to the core of the IncrementalNewlineDecoder.decode method */
 extern PyObject *_PyIncrementalNewlineDecoder_decode(
     PyObject *self, PyObject *input, int final);
@@ -4,6 +4,7 @@
 #include "Python.h"
 #include "pycore_object.h"
 #include "structmember.h"         // PyMemberDef
+#include "rewind.h"               // Rewind_Read()
 #include <stdbool.h>
 #ifdef HAVE_SYS_TYPES_H
 #include <sys/types.h>
@@ -63,6 +64,7 @@ typedef struct {
     unsigned int appending : 1;
     signed int seekable : 2; /* -1 means unknown */
     unsigned int closefd : 1;
+    unsigned int code : 1; /* opened by io.open_code() */
     char finalizing;
     unsigned int blksize;
     PyObject *weakreflist;
@@ -84,6 +86,37 @@ _PyFileIO_closed(PyObject *self)
     return ((fileio *)self)->fd < 0;
 }
 
+int
+_PyFileIO_MarkCode(PyObject *file)
+{
+    _Py_IDENTIFIER(raw);
+    PyObject *raw;
+
+    if (PyFileIO_Check(file)) {
+        ((fileio *)file)->code = 1;
+        return 0;
+    }
+    if (_PyObject_LookupAttrId(file, &PyId_raw, &raw) < 0)
+        return -1;
+    if (raw != NULL) {
+        if (PyFileIO_Check(raw))
+            ((fileio *)raw)->code = 1;
+        Py_DECREF(raw);
+    }
+    return 0;
+}
+
+/* Reads from the file, through the recorder unless the file holds code:
+   which code imports read depends on the bytecode cache, not on the
+   program, so it isn't logged as one of its inputs. */
+static Py_ssize_t
+fileio_read(fileio *self, void *buf, size_t count)
+{
+    if (self->code)
+        return _Py_read(self->fd, buf, count);
+    return Rewind_Read(self->fd, buf, count);
+}
+
 /* Because this can call arbitrary code, it shouldn't be called when
    the refcount is 0 (that is, not directly from tp_dealloc unless
    the refcount has been temporarily re-incremented). */
@@ -642,7 +675,7 @@ _io_FileIO_readinto_impl(fileio *self, Py_buffer *buffer)
     if (!self->readable)
         return err_mode("reading");
 
-    n = _Py_read(self->fd, buffer->buf, buffer->len);
+    n = fileio_read(self, buffer->buf, buffer->len);
     /* copy errno because PyBuffer_Release() can indirectly modify it */
     err = errno;
 
@@ -747,9 +780,9 @@ _io_FileIO_readall_impl(fileio *self)
             }
         }
 
-        n = _Py_read(self->fd,
-                     PyBytes_AS_STRING(result) + bytes_read,
-                     bufsize - bytes_read);
+        n = fileio_read(self,
+                        PyBytes_AS_STRING(result) + bytes_read,
+                        bufsize - bytes_read);
 
         if (n == 0)
             break;
@@ -812,7 +845,7 @@ _io_FileIO_read_impl(fileio *self, Py_ssize_t size)
         return NULL;
     ptr = PyBytes_AS_STRING(bytes);
 
-    n = _Py_read(self->fd, ptr, size);
+    n = fileio_read(self, ptr, size);
     if (n == -1) {
         /* copy errno because Py_DECREF() can indirectly modify it */
         int err = errno;
@@ -67,6 +67,7 @@
 /* ---------------------------------------------------------------*/
 
 #include "Python.h"
+#include "rewind.h"               // Rewind_ReplayData()
 #ifdef HAVE_PROCESS_H
 #  include <process.h>            // getpid()
 #endif
@@ -236,8 +237,14 @@ random_seed_urandom(RandomObject *self)
 {
     uint32_t key[N];
 
-    if (_PyOS_URandomNonblock(key, sizeof(key)) < 0) {
-        return -1;
+    /* the seed is an input of the program for rewind to log or replay */
+    if (Rewind_ReplayData(REWIND_INPUT_RANDOM_SEED, key, sizeof(key))
+        != (Py_ssize_t)sizeof(key))
+    {
+        if (_PyOS_URandomNonblock(key, sizeof(key)) < 0) {
+            return -1;
+        }
+        Rewind_LogData(REWIND_INPUT_RANDOM_SEED, key, sizeof(key), 0);
     }
     init_by_array(self, key, Py_ARRAY_LENGTH(key));
     return 0;
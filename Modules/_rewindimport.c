@@ -0,0 +1,2482 @@
+/* _rewindimport module: recreates the past states of a program from its
+   rewind log into the database recreate.py defines, in a single pass.
+
+   It does what recreate.py's recreate_past() does, event for event, and
+   writes the same rows. The current version of each heap object is kept as
+   a Python list, dict, set, tuple or str, so they behave the same, and the
+   rows go through prepared statements on the database handle of a
+   connection of the bundled sqlite3 module, in large transactions. */
+
+#define PY_SSIZE_T_CLEAN
+#include "Python.h"
+#include "rewindlog.h"
+#include "_sqlite/connection.h"
+
+#include <sys/stat.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+/* rows are committed every so many events */
+#define EVENTS_PER_TRANSACTION 1000000
+/* and progress is shown every so many */
+#define EVENTS_PER_PROGRESS 100000
+
+/* Containers with more than CHUNK_MAX items are saved in chunks, see
+   recreate.py's split_chunks() */
+#define CHUNK_MIN 4
+#define CHUNK_MAX 64
+#define CHUNK_MASK 15
+
+/*[clinic input]
+module _rewindimport
+[clinic start generated code]*/
+/*[clinic end generated code: output=da39a3ee5e6b4b0d input=0a15d8940a912fc4]*/
+
+
+/* HeapRef: a value that refers to a heap object of the recorded program,
+   as recreate.py's HeapRef */
+
+typedef struct {
+    PyObject_HEAD
+    unsigned long long id;
+} HeapRefObject;
+
+static PyTypeObject HeapRefType;
+
+#define HeapRef_Check(op) Py_IS_TYPE(op, &HeapRefType)
+
+static PyObject *
+heapref_new(unsigned long long id)
+{
+    HeapRefObject *ref = PyObject_New(HeapRefObject, &HeapRefType);
+    if (ref != NULL) {
+        ref->id = id;
+    }
+    return (PyObject *)ref;
+}
+
+static PyObject *
+heapref_repr(HeapRefObject *self)
+{
+    return PyUnicode_FromFormat("HeapRef(%llu)", self->id);
+}
+
+/* hash of the id as an int, like recreate.py's HeapRef, which puts the
+   items of sets in the same order */
+static Py_hash_t
+heapref_hash(HeapRefObject *self)
+{
+    Py_hash_t hash = (Py_hash_t)(self->id % _PyHASH_MODULUS);
+    return hash == -1 ? -2 : hash;
+}
+
+static PyObject *
+heapref_richcompare(PyObject *self, PyObject *other, int op)
+{
+    if (!HeapRef_Check(other) || (op != Py_EQ && op != Py_NE)) {
+        Py_RETURN_NOTIMPLEMENTED;
+    }
+    int equal = ((HeapRefObject *)self)->id == ((HeapRefObject *)other)->id;
+    return PyBool_FromLong(op == Py_EQ ? equal : !equal);
+}
+
+static PyTypeObject HeapRefType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_rewindimport.HeapRef",
+    .tp_basicsize = sizeof(HeapRefObject),
+    .tp_dealloc = (destructor)PyObject_Del,
+    .tp_repr = (reprfunc)heapref_repr,
+    .tp_hash = (hashfunc)heapref_hash,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_richcompare = heapref_richcompare,
+};
+
+
+/* Reading the log, as rewindlog.py's LogReader */
+
+typedef struct {
+    long offset;                /* where the block data starts in the file */
+    uint32_t storedSize;
+    uint32_t size;
+    uint64_t firstEvent;
+    uint32_t flags;
+} Block;
+
+typedef struct {
+    FILE *file;
+    int compression;
+    Block *blocks;
+    size_t blockCount;
+    unsigned char *stored;      /* block data as read */
+    unsigned char *data;        /* and decompressed */
+    size_t dataSize;
+    size_t pos;
+    PyObject *symbols;          /* list */
+    PyObject *codes;            /* list of (filename, name, varnames,
+                                   cellvars, freevars) */
+    PyObject *tuples;           /* list of the items of the NEW_TUPLE
+                                   events of the block, as tuples */
+    unsigned long long lastHeapIds[2];
+    long long lastLine;
+    /* arguments of the event read last */
+    PyObject **args;
+    Py_ssize_t argCount;
+    Py_ssize_t argsSize;
+} LogReader;
+
+/* Field layouts of the events, indexed by opcode, see Include/rewindlog.h */
+static const char *const eventLayouts[] = {
+    [REWIND_LOG] = "t",
+    [REWIND_VISIT] = "l",
+    [REWIND_PUSH_FRAME] = "c h h *v",
+    [REWIND_POP_FRAME] = "s s",
+    [REWIND_STORE_DEREF] = "h v",
+    [REWIND_LIST_APPEND] = "h v",
+    [REWIND_LIST_INSERT] = "h i v",
+    [REWIND_LIST_EXTEND] = "h v",
+    [REWIND_LIST_REMOVE] = "h v",
+    [REWIND_LIST_POP] = "h i",
+    [REWIND_LIST_CLEAR] = "h",
+    [REWIND_LIST_REVERSE] = "h",
+    [REWIND_LIST_SORT] = "h *v",
+    [REWIND_LIST_STORE_SUBSCRIPT] = "h v v",
+    [REWIND_LIST_STORE_SUBSCRIPT_SLICE] = "h v v v v",
+    [REWIND_LIST_DELETE_SUBSCRIPT] = "h v",
+    [REWIND_LIST_DELETE_SUBSCRIPT_SLICE] = "h v v v",
+    [REWIND_DICT_STORE_SUBSCRIPT] = "h v v",
+    [REWIND_DICT_DELETE_SUBSCRIPT] = "h v",
+    [REWIND_DICT_UPDATE] = "h v",
+    [REWIND_DICT_CLEAR] = "h",
+    [REWIND_DICT_POP] = "h v",
+    [REWIND_DICT_POP_ITEM] = "h v",
+    [REWIND_DICT_SET_DEFAULT] = "h v v",
+    [REWIND_SET_ADD] = "h v",
+    [REWIND_SET_DISCARD] = "h v",
+    [REWIND_SET_CLEAR] = "h",
+    [REWIND_SET_UPDATE] = "h #v #v",
+    [REWIND_YIELD_VALUE] = "v",
+    [REWIND_RETURN_VALUE] = "v",
+    [REWIND_STORE_NAME] = "h v v",
+    [REWIND_STORE_FAST] = "u v",
+    [REWIND_STORE_GLOBAL] = "h v v",
+    [REWIND_DELETE_GLOBAL] = "h s",
+    [REWIND_STORE_ATTR] = "h v v",
+    [REWIND_STRING_INPLACE_ADD_RESULT] = "h t",
+    [REWIND_NEW_LIST] = "h *v",
+    [REWIND_NEW_STRING] = "h s",
+    [REWIND_NEW_DICT] = "h *v",
+    [REWIND_NEW_SET] = "h *v",
+    [REWIND_NEW_TUPLE] = "h *v",
+    [REWIND_NEW_OBJECT] = "h v",
+    [REWIND_CHECKPOINT] = "u",
+    [REWIND_CHECKPOINT_END] = "",
+    [REWIND_LIST_PERMUTE] = "h *u",
+    [REWIND_THREAD] = "u",
+    [REWIND_INPUT] = "u v",
+    [REWIND_LIST_SPLICE] = "h u u *v",
+    [REWIND_NEW_TUPLE_COPY] = "h u",
+    [REWIND_ELIDED] = "c u u",
+};
+
+static const char *const eventNames[] = {
+    [REWIND_LOG] = "LOG",
+    [REWIND_VISIT] = "VISIT",
+    [REWIND_PUSH_FRAME] = "PUSH_FRAME",
+    [REWIND_POP_FRAME] = "POP_FRAME",
+    [REWIND_STORE_DEREF] = "STORE_DEREF",
+    [REWIND_LIST_APPEND] = "LIST_APPEND",
+    [REWIND_LIST_INSERT] = "LIST_INSERT",
+    [REWIND_LIST_EXTEND] = "LIST_EXTEND",
+    [REWIND_LIST_REMOVE] = "LIST_REMOVE",
+    [REWIND_LIST_POP] = "LIST_POP",
+    [REWIND_LIST_CLEAR] = "LIST_CLEAR",
+    [REWIND_LIST_REVERSE] = "LIST_REVERSE",
+    [REWIND_LIST_SORT] = "LIST_SORT",
+    [REWIND_LIST_STORE_SUBSCRIPT] = "LIST_STORE_SUBSCRIPT",
+    [REWIND_LIST_STORE_SUBSCRIPT_SLICE] = "LIST_STORE_SUBSCRIPT_SLICE",
+    [REWIND_LIST_DELETE_SUBSCRIPT] = "LIST_DELETE_SUBSCRIPT",
+    [REWIND_LIST_DELETE_SUBSCRIPT_SLICE] = "LIST_DELETE_SUBSCRIPT_SLICE",
+    [REWIND_DICT_STORE_SUBSCRIPT] = "DICT_STORE_SUBSCRIPT",
+    [REWIND_DICT_DELETE_SUBSCRIPT] = "DICT_DELETE_SUBSCRIPT",
+    [REWIND_DICT_UPDATE] = "DICT_UPDATE",
+    [REWIND_DICT_CLEAR] = "DICT_CLEAR",
+    [REWIND_DICT_POP] = "DICT_POP",
+    [REWIND_DICT_POP_ITEM] = "DICT_POP_ITEM",
+    [REWIND_DICT_SET_DEFAULT] = "DICT_SET_DEFAULT",
+    [REWIND_SET_ADD] = "SET_ADD",
+    [REWIND_SET_DISCARD] = "SET_DISCARD",
+    [REWIND_SET_CLEAR] = "SET_CLEAR",
+    [REWIND_SET_UPDATE] = "SET_UPDATE",
+    [REWIND_YIELD_VALUE] = "YIELD_VALUE",
+    [REWIND_RETURN_VALUE] = "RETURN_VALUE",
+    [REWIND_STORE_NAME] = "STORE_NAME",
+    [REWIND_STORE_FAST] = "STORE_FAST",
+    [REWIND_STORE_GLOBAL] = "STORE_GLOBAL",
+    [REWIND_DELETE_GLOBAL] = "DELETE_GLOBAL",
+    [REWIND_STORE_ATTR] = "STORE_ATTR",
+    [REWIND_STRING_INPLACE_ADD_RESULT] = "STRING_INPLACE_ADD_RESULT",
+    [REWIND_NEW_LIST] = "NEW_LIST",
+    [REWIND_NEW_STRING] = "NEW_STRING",
+    [REWIND_NEW_DICT] = "NEW_DICT",
+    [REWIND_NEW_SET] = "NEW_SET",
+    [REWIND_NEW_TUPLE] = "NEW_TUPLE",
+    [REWIND_NEW_OBJECT] = "NEW_OBJECT",
+    [REWIND_CHECKPOINT] = "CHECKPOINT",
+    [REWIND_CHECKPOINT_END] = "CHECKPOINT_END",
+    [REWIND_LIST_PERMUTE] = "LIST_PERMUTE",
+    [REWIND_THREAD] = "THREAD",
+    [REWIND_INPUT] = "INPUT",
+    [REWIND_LIST_SPLICE] = "LIST_SPLICE",
+    [REWIND_NEW_TUPLE_COPY] = "NEW_TUPLE_COPY",
+    [REWIND_ELIDED] = "ELIDED",
+};
+
+#define EVENT_COUNT ((int)Py_ARRAY_LENGTH(eventLayouts))
+
+static uint32_t
+getUint32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+           (uint32_t)p[3] << 24;
+}
+
+static uint64_t
+getUint64(const unsigned char *p)
+{
+    return getUint32(p) | (uint64_t)getUint32(p + 4) << 32;
+}
+
+static int
+truncated(void)
+{
+    PyErr_SetString(PyExc_ValueError, "rewind log block cut short");
+    return -1;
+}
+
+static int
+readUvarint(LogReader *reader, unsigned long long *value)
+{
+    unsigned long long result = 0;
+    int shift = 0;
+    unsigned char byte;
+    do {
+        if (reader->pos >= reader->dataSize) {
+            return truncated();
+        }
+        byte = reader->data[reader->pos++];
+        if (shift < 64) {
+            result |= (unsigned long long)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+    } while (byte & 0x80);
+    *value = result;
+    return 0;
+}
+
+static int
+readVarint(LogReader *reader, long long *value)
+{
+    unsigned long long u;
+    if (readUvarint(reader, &u) < 0) {
+        return -1;
+    }
+    *value = (long long)(u >> 1) ^ -(long long)(u & 1);
+    return 0;
+}
+
+static int
+readHeapId(LogReader *reader, unsigned long long *id)
+{
+    unsigned long long value;
+    if (readUvarint(reader, &value) < 0) {
+        return -1;
+    }
+    int base = value & 1;
+    value >>= 1;
+    unsigned long long delta = (value >> 1) ^ -(value & 1);
+    reader->lastHeapIds[base] += delta;
+    *id = reader->lastHeapIds[base];
+    return 0;
+}
+
+static PyObject *
+readText(LogReader *reader)
+{
+    unsigned long long length;
+    if (readUvarint(reader, &length) < 0) {
+        return NULL;
+    }
+    if (length > reader->dataSize - reader->pos) {
+        truncated();
+        return NULL;
+    }
+    PyObject *text = PyUnicode_DecodeUTF8(
+        (const char *)reader->data + reader->pos, (Py_ssize_t)length,
+        "surrogatepass");
+    reader->pos += length;
+    return text;
+}
+
+static PyObject *
+readSymbol(LogReader *reader)
+{
+    unsigned long long index;
+    if (readUvarint(reader, &index) < 0) {
+        return NULL;
+    }
+    if (index == 0) {
+        PyObject *symbol = readText(reader);
+        if (symbol == NULL || PyList_Append(reader->symbols, symbol) < 0) {
+            Py_XDECREF(symbol);
+            return NULL;
+        }
+        return symbol;
+    }
+    if (index > (unsigned long long)PyList_GET_SIZE(reader->symbols)) {
+        PyErr_SetString(PyExc_ValueError, "unknown symbol in rewind log");
+        return NULL;
+    }
+    PyObject *symbol = PyList_GET_ITEM(reader->symbols, index - 1);
+    Py_INCREF(symbol);
+    return symbol;
+}
+
+static PyObject *
+readSymbols(LogReader *reader)
+{
+    unsigned long long count;
+    if (readUvarint(reader, &count) < 0) {
+        return NULL;
+    }
+    if (count > reader->dataSize - reader->pos) {
+        truncated();
+        return NULL;
+    }
+    PyObject *symbols = PyTuple_New((Py_ssize_t)count);
+    if (symbols == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < (Py_ssize_t)count; i++) {
+        PyObject *symbol = readSymbol(reader);
+        if (symbol == NULL) {
+            Py_DECREF(symbols);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(symbols, i, symbol);
+    }
+    return symbols;
+}
+
+static PyObject *
+readCode(LogReader *reader)
+{
+    unsigned long long index;
+    if (readUvarint(reader, &index) < 0) {
+        return NULL;
+    }
+    if (index == 0) {
+        PyObject *code = PyTuple_New(5);
+        if (code == NULL) {
+            return NULL;
+        }
+        for (int i = 0; i < 5; i++) {
+            PyObject *item = i < 2 ? readSymbol(reader) : readSymbols(reader);
+            if (item == NULL) {
+                Py_DECREF(code);
+                return NULL;
+            }
+            PyTuple_SET_ITEM(code, i, item);
+        }
+        if (PyList_Append(reader->codes, code) < 0) {
+            Py_DECREF(code);
+            return NULL;
+        }
+        return code;
+    }
+    if (index > (unsigned long long)PyList_GET_SIZE(reader->codes)) {
+        PyErr_SetString(PyExc_ValueError, "unknown code object in rewind log");
+        return NULL;
+    }
+    PyObject *code = PyList_GET_ITEM(reader->codes, index - 1);
+    Py_INCREF(code);
+    return code;
+}
+
+static PyObject *
+readValue(LogReader *reader)
+{
+    if (reader->pos >= reader->dataSize) {
+        truncated();
+        return NULL;
+    }
+    unsigned char tag = reader->data[reader->pos++];
+    switch (tag) {
+    case REWIND_VALUE_NONE:
+        Py_RETURN_NONE;
+    case REWIND_VALUE_FALSE:
+        Py_RETURN_FALSE;
+    case REWIND_VALUE_TRUE:
+        Py_RETURN_TRUE;
+    case REWIND_VALUE_INT: {
+        long long value;
+        if (readVarint(reader, &value) < 0) {
+            return NULL;
+        }
+        return PyLong_FromLongLong(value);
+    }
+    case REWIND_VALUE_BIGINT: {
+        PyObject *digits = readText(reader);
+        if (digits == NULL) {
+            return NULL;
+        }
+        PyObject *value = PyLong_FromUnicodeObject(digits, 10);
+        Py_DECREF(digits);
+        return value;
+    }
+    case REWIND_VALUE_FLOAT: {
+        if (reader->dataSize - reader->pos < 8) {
+            truncated();
+            return NULL;
+        }
+        double value = _PyFloat_Unpack8(reader->data + reader->pos, 1);
+        reader->pos += 8;
+        if (value == -1.0 && PyErr_Occurred()) {
+            return NULL;
+        }
+        return PyFloat_FromDouble(value);
+    }
+    case REWIND_VALUE_REF: {
+        unsigned long long id;
+        if (readHeapId(reader, &id) < 0) {
+            return NULL;
+        }
+        return heapref_new(id);
+    }
+    case REWIND_VALUE_BYTES: {
+        unsigned long long length;
+        if (readUvarint(reader, &length) < 0) {
+            return NULL;
+        }
+        if (length > reader->dataSize - reader->pos) {
+            truncated();
+            return NULL;
+        }
+        PyObject *data = PyBytes_FromStringAndSize(
+            (const char *)reader->data + reader->pos, (Py_ssize_t)length);
+        reader->pos += length;
+        return data;
+    }
+    default:
+        PyErr_Format(PyExc_ValueError, "unknown value tag %d", tag);
+        return NULL;
+    }
+}
+
+static PyObject *
+readField(LogReader *reader, char kind)
+{
+    switch (kind) {
+    case 'h': {
+        unsigned long long id;
+        if (readHeapId(reader, &id) < 0) {
+            return NULL;
+        }
+        return PyLong_FromUnsignedLongLong(id);
+    }
+    case 'l': {
+        long long delta;
+        if (readVarint(reader, &delta) < 0) {
+            return NULL;
+        }
+        reader->lastLine += delta;
+        return PyLong_FromLongLong(reader->lastLine);
+    }
+    case 'u': {
+        unsigned long long value;
+        if (readUvarint(reader, &value) < 0) {
+            return NULL;
+        }
+        return PyLong_FromUnsignedLongLong(value);
+    }
+    case 'i': {
+        long long value;
+        if (readVarint(reader, &value) < 0) {
+            return NULL;
+        }
+        return PyLong_FromLongLong(value);
+    }
+    case 's':
+        return readSymbol(reader);
+    case 't':
+        return readText(reader);
+    case 'c':
+        return readCode(reader);
+    case 'v':
+        return readValue(reader);
+    }
+    Py_UNREACHABLE();
+}
+
+static int
+addArg(LogReader *reader, PyObject *arg)
+{
+    if (arg == NULL) {
+        return -1;
+    }
+    if (reader->argCount == reader->argsSize) {
+        Py_ssize_t size = Py_MAX(2 * reader->argsSize, 16);
+        PyObject **args = PyMem_Realloc(reader->args, size * sizeof(PyObject *));
+        if (args == NULL) {
+            Py_DECREF(arg);
+            PyErr_NoMemory();
+            return -1;
+        }
+        reader->args = args;
+        reader->argsSize = size;
+    }
+    reader->args[reader->argCount++] = arg;
+    return 0;
+}
+
+static void
+clearArgs(LogReader *reader)
+{
+    while (reader->argCount > 0) {
+        Py_DECREF(reader->args[--reader->argCount]);
+    }
+}
+
+/* Keep the items of the NEW_TUPLE event read last, for the NEW_TUPLE_COPY
+   events after it in the block. */
+static int
+keepTuple(LogReader *reader)
+{
+    PyObject *items = PyTuple_New(reader->argCount - 1);
+    if (items == NULL) {
+        return -1;
+    }
+    for (Py_ssize_t i = 1; i < reader->argCount; i++) {
+        Py_INCREF(reader->args[i]);
+        PyTuple_SET_ITEM(items, i - 1, reader->args[i]);
+    }
+    int result = PyList_Append(reader->tuples, items);
+    Py_DECREF(items);
+    return result;
+}
+
+/* Turn the NEW_TUPLE_COPY event read last into the NEW_TUPLE event it
+   stands for, returns REWIND_NEW_TUPLE. */
+static int
+copyTuple(LogReader *reader)
+{
+    Py_ssize_t index = PyLong_AsSsize_t(reader->args[1]);
+    if (index < 0 || index >= PyList_GET_SIZE(reader->tuples)) {
+        if (!PyErr_Occurred() || PyErr_ExceptionMatches(PyExc_OverflowError)) {
+            PyErr_Clear();
+            PyErr_SetString(PyExc_ValueError, "unknown tuple in rewind log");
+        }
+        return -1;
+    }
+    PyObject *items = PyList_GET_ITEM(reader->tuples, index);
+    Py_DECREF(reader->args[--reader->argCount]);
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(items); i++) {
+        PyObject *item = PyTuple_GET_ITEM(items, i);
+        Py_INCREF(item);
+        if (addArg(reader, item) < 0) {
+            return -1;
+        }
+    }
+    return REWIND_NEW_TUPLE;
+}
+
+/* Read the next event of the block into reader->args, returns its opcode,
+   or -1 with an exception set. */
+static int
+readEvent(LogReader *reader)
+{
+    clearArgs(reader);
+    int opcode = reader->data[reader->pos++];
+    if (opcode <= 0 || opcode >= EVENT_COUNT || eventLayouts[opcode] == NULL) {
+        PyErr_Format(PyExc_ValueError, "unknown event opcode %d", opcode);
+        return -1;
+    }
+    for (const char *p = eventLayouts[opcode]; *p != '\0'; p++) {
+        char repeat = 0;
+        if (*p == ' ') {
+            continue;
+        }
+        if (*p == '#' || *p == '*') {
+            repeat = *p++;
+        }
+        if (!repeat) {
+            if (addArg(reader, readField(reader, *p)) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        unsigned long long count;
+        if (readUvarint(reader, &count) < 0) {
+            return -1;
+        }
+        if (count > reader->dataSize - reader->pos) {
+            return truncated();
+        }
+        if (repeat == '#' && addArg(reader, PyLong_FromUnsignedLongLong(count)) < 0) {
+            return -1;
+        }
+        for (unsigned long long i = 0; i < count; i++) {
+            if (addArg(reader, readField(reader, *p)) < 0) {
+                return -1;
+            }
+        }
+    }
+    if (opcode == REWIND_NEW_TUPLE) {
+        return keepTuple(reader) < 0 ? -1 : opcode;
+    }
+    if (opcode == REWIND_NEW_TUPLE_COPY) {
+        return copyTuple(reader);
+    }
+    return opcode;
+}
+
+static int
+openLog(LogReader *reader, PyObject *filename)
+{
+    reader->file = _Py_fopen_obj(filename, "rb");
+    if (reader->file == NULL) {
+        return -1;
+    }
+    unsigned char header[sizeof(REWIND_LOG_MAGIC) + 1];
+    size_t magicLength = sizeof(REWIND_LOG_MAGIC) - 1;
+    if (fread(header, 1, magicLength + 2, reader->file) != magicLength + 2 ||
+        memcmp(header, REWIND_LOG_MAGIC, magicLength) != 0) {
+        PyErr_SetString(PyExc_ValueError, "not a rewind log");
+        return -1;
+    }
+    if (header[magicLength] != REWIND_LOG_VERSION) {
+        PyErr_Format(PyExc_ValueError, "unsupported rewind log version %d",
+                     header[magicLength]);
+        return -1;
+    }
+    reader->compression = header[magicLength + 1];
+    if (reader->compression != REWIND_COMPRESS_NONE &&
+        reader->compression != REWIND_COMPRESS_ZLIB) {
+        PyErr_Format(PyExc_ValueError, "unknown rewind log compression %d",
+                     reader->compression);
+        return -1;
+    }
+#ifndef HAVE_LIBZ
+    if (reader->compression == REWIND_COMPRESS_ZLIB) {
+        PyErr_SetString(PyExc_ValueError,
+                        "rewind log is compressed, built without zlib");
+        return -1;
+    }
+#endif
+
+    /* the block headers, without a last block cut short */
+    struct _Py_stat_struct status;
+    if (_Py_fstat_noraise(fileno(reader->file), &status) != 0) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    long size = (long)status.st_size;
+    long offset = (long)(magicLength + 2);
+    size_t blocksSize = 0;
+    while (offset + REWIND_BLOCK_HEADER_SIZE <= size) {
+        unsigned char blockHeader[REWIND_BLOCK_HEADER_SIZE];
+        if (fseek(reader->file, offset, SEEK_SET) != 0 ||
+            fread(blockHeader, 1, REWIND_BLOCK_HEADER_SIZE, reader->file)
+                != REWIND_BLOCK_HEADER_SIZE) {
+            PyErr_SetFromErrno(PyExc_OSError);
+            return -1;
+        }
+        Block block;
+        block.offset = offset + REWIND_BLOCK_HEADER_SIZE;
+        block.storedSize = getUint32(blockHeader);
+        block.size = getUint32(blockHeader + 4);
+        block.firstEvent = getUint64(blockHeader + 8);
+        block.flags = getUint32(blockHeader + 24);
+        if (block.offset + (long)block.storedSize > size) {
+            break;
+        }
+        if (reader->blockCount == blocksSize) {
+            blocksSize = Py_MAX(2 * blocksSize, 64);
+            Block *blocks = PyMem_Realloc(reader->blocks, blocksSize * sizeof(Block));
+            if (blocks == NULL) {
+                PyErr_NoMemory();
+                return -1;
+            }
+            reader->blocks = blocks;
+        }
+        reader->blocks[reader->blockCount++] = block;
+        offset = block.offset + block.storedSize;
+    }
+    reader->symbols = PyList_New(0);
+    reader->codes = PyList_New(0);
+    reader->tuples = PyList_New(0);
+    if (reader->symbols == NULL || reader->codes == NULL ||
+        reader->tuples == NULL) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Load the data of block, for readEvent to go through. */
+static int
+loadBlock(LogReader *reader, Block *block)
+{
+    PyMem_Free(reader->stored);
+    PyMem_Free(reader->data);
+    reader->data = reader->stored = NULL;
+    reader->stored = PyMem_Malloc(Py_MAX(block->storedSize, 1));
+    if (reader->stored == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    if (fseek(reader->file, block->offset, SEEK_SET) != 0 ||
+        fread(reader->stored, 1, block->storedSize, reader->file)
+            != block->storedSize) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    if (reader->compression == REWIND_COMPRESS_NONE) {
+        reader->data = reader->stored;
+        reader->stored = NULL;
+        reader->dataSize = block->storedSize;
+    }
+#ifdef HAVE_LIBZ
+    else {
+        reader->data = PyMem_Malloc(Py_MAX(block->size, 1));
+        if (reader->data == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        uLongf size = block->size;
+        if (uncompress(reader->data, &size, reader->stored, block->storedSize) != Z_OK) {
+            PyErr_SetString(PyExc_ValueError, "corrupt rewind log block");
+            return -1;
+        }
+        reader->dataSize = size;
+    }
+#endif
+    reader->pos = 0;
+    reader->lastHeapIds[0] = reader->lastHeapIds[1] = 0;
+    reader->lastLine = 0;
+    if (PyList_SetSlice(reader->symbols, 0, PY_SSIZE_T_MAX, NULL) < 0 ||
+        PyList_SetSlice(reader->codes, 0, PY_SSIZE_T_MAX, NULL) < 0 ||
+        PyList_SetSlice(reader->tuples, 0, PY_SSIZE_T_MAX, NULL) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void
+closeLog(LogReader *reader)
+{
+    clearArgs(reader);
+    PyMem_Free(reader->args);
+    PyMem_Free(reader->blocks);
+    PyMem_Free(reader->stored);
+    PyMem_Free(reader->data);
+    Py_XDECREF(reader->symbols);
+    Py_XDECREF(reader->codes);
+    Py_XDECREF(reader->tuples);
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+}
+
+
+/* Recreating the past, as recreate.py's recreate_past() */
+
+typedef struct {
+    long long id;
+    PyObject *name;
+    PyObject *varnames;
+    PyObject *localsId;
+} FunCall;
+
+/* The calls of a thread other than the one the current event comes from */
+typedef struct {
+    long long thread;
+    FunCall *calls;
+    size_t depth;
+    size_t size;
+} CallStack;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t size;
+} Text;
+
+typedef struct {
+    PyObject *connection;
+    sqlite3 *db;
+    sqlite3_stmt *insertSnapshot;
+    sqlite3_stmt *insertObject;
+    sqlite3_stmt *insertFunCall;
+    sqlite3_stmt *insertCodeFile;
+    sqlite3_stmt *insertHeapRef;
+    sqlite3_stmt *insertVariableChange;
+    sqlite3_stmt *insertElision;
+    /* heap id in the recorded program => current version of the object */
+    PyObject *heap;
+    /* file name => CodeFile id */
+    PyObject *codeFiles;
+    /* heap id of a module's globals => id of the FunCall that ran it */
+    PyObject *moduleCalls;
+    /* the calls of the thread the current event comes from, innermost
+       last, and its id, 0 until a THREAD event gives it */
+    FunCall *stack;
+    size_t depth;
+    size_t stackSize;
+    long long thread;
+    CallStack *otherStacks;
+    size_t otherStackCount;
+    size_t otherStacksSize;
+    long long nextSnapshotId;
+    long long nextFunCallId;
+    long long nextObjectId;
+    long long nextCodeFileId;
+    long long heapVersion;
+    long long eventNo;
+    long long checkpointNextEvent;
+    int inCheckpoint;
+    /* set when the import starts from a checkpoint: the heap version and
+       the number of FunCall rows once it is replayed */
+    int fromCheckpoint;
+    int haveStartCheckpoint;
+    long long startHeapVersion;
+    long long startFunCalls;
+    long long currLineNo;
+    int haveLineNo;
+    int activateSnapshots;
+    long long emptyListOid;
+    long long emptyDictOid;
+    long long emptySetOid;
+    Text text;
+    /* the data of a chunk, chunked flag first => its Object id */
+    PyObject *chunkIds;
+    /* the items of an object saved in chunks, as serialized, one after the
+       other, with where each ends */
+    Text entries;
+    size_t *entryEnds;
+    size_t entryCount;
+    size_t entryEndsSize;
+    /* ids of the chunks the items are split into */
+    long long *chunkOids;
+    size_t chunkOidsSize;
+} Importer;
+
+static int
+databaseError(Importer *importer)
+{
+    PyObject *error = PyObject_GetAttrString(importer->connection, "DatabaseError");
+    if (error != NULL) {
+        PyErr_SetString(error, sqlite3_errmsg(importer->db));
+        Py_DECREF(error);
+    }
+    return -1;
+}
+
+static int
+runStatement(Importer *importer, sqlite3_stmt *statement)
+{
+    int rc = sqlite3_step(statement);
+    sqlite3_reset(statement);
+    sqlite3_clear_bindings(statement);
+    if (rc != SQLITE_DONE) {
+        return databaseError(importer);
+    }
+    return 0;
+}
+
+static int
+execute(Importer *importer, const char *sql)
+{
+    if (sqlite3_exec(importer->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        return databaseError(importer);
+    }
+    return 0;
+}
+
+static int
+bindText(Importer *importer, sqlite3_stmt *statement, int column, PyObject *str)
+{
+    Py_ssize_t length;
+    const char *data = PyUnicode_AsUTF8AndSize(str, &length);
+    if (data == NULL) {
+        return -1;
+    }
+    if (sqlite3_bind_text(statement, column, data, (int)length,
+                          SQLITE_TRANSIENT) != SQLITE_OK) {
+        return databaseError(importer);
+    }
+    return 0;
+}
+
+static int
+textReserve(Text *text, size_t n)
+{
+    if (text->length + n <= text->size) {
+        return 0;
+    }
+    size_t size = Py_MAX(2 * text->size, text->length + n);
+    size = Py_MAX(size, 256);
+    char *data = PyMem_Realloc(text->data, size);
+    if (data == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    text->data = data;
+    text->size = size;
+    return 0;
+}
+
+static int
+textAppend(Text *text, const char *data, size_t n)
+{
+    if (textReserve(text, n) < 0) {
+        return -1;
+    }
+    memcpy(text->data + text->length, data, n);
+    text->length += n;
+    return 0;
+}
+
+#define textAppendString(text, s) textAppend(text, s, strlen(s))
+
+/* recreate.py's quote(): " turns into \\" and \ into \\ */
+static int
+textAppendQuoted(Text *text, PyObject *str)
+{
+    Py_ssize_t length;
+    const char *data = PyUnicode_AsUTF8AndSize(str, &length);
+    if (data == NULL || textReserve(text, 3 * length + 2) < 0) {
+        return -1;
+    }
+    char *p = text->data + text->length;
+    *p++ = '"';
+    for (Py_ssize_t i = 0; i < length; i++) {
+        if (data[i] == '"') {
+            *p++ = '\\';
+            *p++ = '\\';
+        }
+        else if (data[i] == '\\') {
+            *p++ = '\\';
+        }
+        *p++ = data[i];
+    }
+    *p++ = '"';
+    text->length = p - text->data;
+    return 0;
+}
+
+/* recreate.py's serialize_member() */
+static int
+serializeMember(Text *text, PyObject *value)
+{
+    char buffer[32];
+    if (HeapRef_Check(value)) {
+        PyOS_snprintf(buffer, sizeof(buffer), "^%llu", ((HeapRefObject *)value)->id);
+        return textAppendString(text, buffer);
+    }
+    if (value == Py_None) {
+        return textAppendString(text, "null");
+    }
+    if (PyBool_Check(value)) {
+        return textAppendString(text, value == Py_True ? "true" : "false");
+    }
+    if (PyLong_Check(value)) {
+        int overflow;
+        long long n = PyLong_AsLongLongAndOverflow(value, &overflow);
+        if (n == -1 && PyErr_Occurred()) {
+            return -1;
+        }
+        if (!overflow) {
+            PyOS_snprintf(buffer, sizeof(buffer), "%lld", n);
+            return textAppendString(text, buffer);
+        }
+    }
+    if (PyLong_Check(value) || PyFloat_Check(value)) {
+        PyObject *str = PyObject_Str(value);
+        if (str == NULL) {
+            return -1;
+        }
+        Py_ssize_t length;
+        const char *data = PyUnicode_AsUTF8AndSize(str, &length);
+        int result = data == NULL ? -1 : textAppend(text, data, length);
+        Py_DECREF(str);
+        return result;
+    }
+    if (PyUnicode_Check(value)) {
+        return textAppendQuoted(text, value);
+    }
+    PyErr_Format(PyExc_TypeError, "No entry for object %R", value);
+    return -1;
+}
+
+/* recreate.py's serialize() */
+static int
+serialize(Text *text, PyObject *value)
+{
+    if (PyDict_Check(value)) {
+        Py_ssize_t pos = 0;
+        PyObject *key, *item;
+        if (textAppendString(text, "{") < 0) {
+            return -1;
+        }
+        while (PyDict_Next(value, &pos, &key, &item)) {
+            if ((text->data[text->length - 1] != '{' &&
+                 textAppendString(text, ", ") < 0) ||
+                serializeMember(text, key) < 0 ||
+                textAppendString(text, ": ") < 0 ||
+                serializeMember(text, item) < 0) {
+                return -1;
+            }
+        }
+        return textAppendString(text, "}");
+    }
+    if (PyList_Check(value) || PyTuple_Check(value) || PyAnySet_Check(value)) {
+        PyObject *iterator = PyObject_GetIter(value);
+        if (iterator == NULL || textAppendString(text, "[") < 0) {
+            Py_XDECREF(iterator);
+            return -1;
+        }
+        PyObject *item;
+        int first = 1;
+        while ((item = PyIter_Next(iterator)) != NULL) {
+            if ((!first && textAppendString(text, ", ") < 0) ||
+                serializeMember(text, item) < 0) {
+                Py_DECREF(item);
+                Py_DECREF(iterator);
+                return -1;
+            }
+            first = 0;
+            Py_DECREF(item);
+        }
+        Py_DECREF(iterator);
+        if (PyErr_Occurred()) {
+            return -1;
+        }
+        return textAppendString(text, "]");
+    }
+    return serializeMember(text, value);
+}
+
+static int
+bindSerialized(Importer *importer, sqlite3_stmt *statement, int column, PyObject *value)
+{
+    importer->text.length = 0;
+    if (serialize(&importer->text, value) < 0) {
+        return -1;
+    }
+    if (sqlite3_bind_text(statement, column, importer->text.data,
+                          (int)importer->text.length, SQLITE_TRANSIENT) != SQLITE_OK) {
+        return databaseError(importer);
+    }
+    return 0;
+}
+
+static long long
+insertObject(Importer *importer, long long oid, PyObject *obj)
+{
+    sqlite3_stmt *statement = importer->insertObject;
+    sqlite3_bind_int64(statement, 1, oid);
+    if (bindSerialized(importer, statement, 2, obj) < 0 ||
+        runStatement(importer, statement) < 0) {
+        return -1;
+    }
+    return oid;
+}
+
+static int
+endEntry(Importer *importer)
+{
+    if (importer->entryCount == importer->entryEndsSize) {
+        size_t size = Py_MAX(2 * importer->entryEndsSize, 256);
+        size_t *ends = PyMem_Realloc(importer->entryEnds, size * sizeof(size_t));
+        if (ends == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        importer->entryEnds = ends;
+        importer->entryEndsSize = size;
+    }
+    importer->entryEnds[importer->entryCount++] = importer->entries.length;
+    return 0;
+}
+
+/* Serialize the items of obj, or the key: value pairs of a dict, into
+   importer->entries. */
+static int
+serializeEntries(Importer *importer, PyObject *obj)
+{
+    Text *entries = &importer->entries;
+    entries->length = 0;
+    importer->entryCount = 0;
+    if (PyDict_Check(obj)) {
+        Py_ssize_t pos = 0;
+        PyObject *key, *value;
+        while (PyDict_Next(obj, &pos, &key, &value)) {
+            if (serializeMember(entries, key) < 0 ||
+                textAppendString(entries, ": ") < 0 ||
+                serializeMember(entries, value) < 0 ||
+                endEntry(importer) < 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    PyObject *iterator = PyObject_GetIter(obj);
+    if (iterator == NULL) {
+        return -1;
+    }
+    PyObject *item;
+    while ((item = PyIter_Next(iterator)) != NULL) {
+        int result = serializeMember(entries, item);
+        Py_DECREF(item);
+        if (result < 0 || endEntry(importer) < 0) {
+            Py_DECREF(iterator);
+            return -1;
+        }
+    }
+    Py_DECREF(iterator);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static uint32_t
+chunkHash(const char *data, size_t length)
+{
+#ifdef HAVE_LIBZ
+    return (uint32_t)crc32(0, (const Bytef *)data, (uInt)length);
+#else
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (unsigned char)data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc >> 1 ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+#endif
+}
+
+/* Save the chunk of entries first to last (not included), unless the same
+   chunk was saved before. Returns its Object id or -1. */
+static long long
+saveChunk(Importer *importer, size_t first, size_t last, char open, char close,
+          int chunked)
+{
+    Text *text = &importer->text;
+    char flag = chunked ? '1' : '0';
+    text->length = 0;
+    if (textAppend(text, &flag, 1) < 0 || textAppend(text, &open, 1) < 0) {
+        return -1;
+    }
+    for (size_t i = first; i < last; i++) {
+        size_t start = i == 0 ? 0 : importer->entryEnds[i - 1];
+        if ((i > first && textAppendString(text, ", ") < 0) ||
+            textAppend(text, importer->entries.data + start,
+                       importer->entryEnds[i] - start) < 0) {
+            return -1;
+        }
+    }
+    if (textAppend(text, &close, 1) < 0) {
+        return -1;
+    }
+
+    PyObject *key = PyBytes_FromStringAndSize(text->data, text->length);
+    if (key == NULL) {
+        return -1;
+    }
+    long long oid = -1;
+    PyObject *known = PyDict_GetItemWithError(importer->chunkIds, key);
+    if (known != NULL) {
+        oid = PyLong_AsLongLong(known);
+        goto done;
+    }
+    if (PyErr_Occurred()) {
+        goto done;
+    }
+    sqlite3_stmt *statement = importer->insertObject;
+    sqlite3_bind_int64(statement, 1, importer->nextObjectId);
+    if (sqlite3_bind_text(statement, 2, text->data + 1, (int)text->length - 1,
+                          SQLITE_TRANSIENT) != SQLITE_OK) {
+        databaseError(importer);
+        goto done;
+    }
+    if (chunked) {
+        sqlite3_bind_int(statement, 3, 1);
+    }
+    if (runStatement(importer, statement) < 0) {
+        goto done;
+    }
+    PyObject *value = PyLong_FromLongLong(importer->nextObjectId);
+    if (value == NULL || PyDict_SetItem(importer->chunkIds, key, value) < 0) {
+        Py_XDECREF(value);
+        goto done;
+    }
+    Py_DECREF(value);
+    oid = importer->nextObjectId++;
+done:
+    Py_DECREF(key);
+    return oid;
+}
+
+/* Split the count entries into chunks and save them, as recreate.py's
+   split_chunks() and save_chunk(). Returns how many chunks there are, with
+   their ids in importer->chunkOids, or -1. */
+static Py_ssize_t
+saveChunks(Importer *importer, size_t count, char open, char close, int chunked)
+{
+    size_t first = 0;
+    Py_ssize_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = i + 1 - first;
+        size_t start = i == 0 ? 0 : importer->entryEnds[i - 1];
+        if (length == CHUNK_MAX ||
+            (length >= CHUNK_MIN &&
+             (chunkHash(importer->entries.data + start,
+                        importer->entryEnds[i] - start) & CHUNK_MASK) == 0)) {
+            long long oid = saveChunk(importer, first, i + 1, open, close, chunked);
+            if (oid < 0) {
+                return -1;
+            }
+            importer->chunkOids[n++] = oid;
+            first = i + 1;
+        }
+    }
+    if (first < count) {
+        long long oid = saveChunk(importer, first, count, open, close, chunked);
+        if (oid < 0) {
+            return -1;
+        }
+        importer->chunkOids[n++] = oid;
+    }
+    return n;
+}
+
+/* recreate.py's save_chunked() */
+static long long
+saveChunked(Importer *importer, PyObject *obj)
+{
+    if (serializeEntries(importer, obj) < 0) {
+        return -1;
+    }
+    if (importer->entryCount > importer->chunkOidsSize) {
+        size_t size = Py_MAX(2 * importer->chunkOidsSize, importer->entryCount);
+        long long *oids = PyMem_Realloc(importer->chunkOids, size * sizeof(long long));
+        if (oids == NULL) {
+            PyErr_NoMemory();
+            return -1;
+        }
+        importer->chunkOids = oids;
+        importer->chunkOidsSize = size;
+    }
+    int isDict = PyDict_Check(obj);
+    Py_ssize_t n = saveChunks(importer, importer->entryCount,
+                              isDict ? '{' : '[', isDict ? '}' : ']', 0);
+    while (n >= 0) {
+        /* the chunks are the entries of the level above */
+        importer->entries.length = 0;
+        importer->entryCount = 0;
+        for (Py_ssize_t i = 0; i < n; i++) {
+            char buffer[32];
+            PyOS_snprintf(buffer, sizeof(buffer), "*%lld", importer->chunkOids[i]);
+            if (textAppendString(&importer->entries, buffer) < 0 ||
+                endEntry(importer) < 0) {
+                return -1;
+            }
+        }
+        if (n <= CHUNK_MAX) {
+            return saveChunk(importer, 0, n, '[', ']', 1);
+        }
+        n = saveChunks(importer, n, '[', ']', 1);
+    }
+    return -1;
+}
+
+static Py_ssize_t
+containerSize(PyObject *obj)
+{
+    if (PyList_Check(obj)) {
+        return PyList_GET_SIZE(obj);
+    }
+    if (PyTuple_Check(obj)) {
+        return PyTuple_GET_SIZE(obj);
+    }
+    if (PyDict_Check(obj)) {
+        return PyDict_GET_SIZE(obj);
+    }
+    if (PyAnySet_Check(obj)) {
+        return PySet_GET_SIZE(obj);
+    }
+    return 0;
+}
+
+/* recreate.py's save_object(): empty containers share a row, large ones
+   are saved in chunks */
+static long long
+saveObject(Importer *importer, PyObject *obj)
+{
+    if (PyList_Check(obj) && PyList_GET_SIZE(obj) == 0) {
+        return importer->emptyListOid;
+    }
+    if (PyDict_Check(obj) && PyDict_GET_SIZE(obj) == 0) {
+        return importer->emptyDictOid;
+    }
+    if (PyAnySet_Check(obj) && PySet_GET_SIZE(obj) == 0) {
+        return importer->emptySetOid;
+    }
+    if (containerSize(obj) > CHUNK_MAX) {
+        return saveChunked(importer, obj);
+    }
+    return insertObject(importer, importer->nextObjectId++, obj);
+}
+
+/* Make obj the new version of the object at heapId, stealing the
+   reference to obj, which may be NULL for an error. */
+static int
+updateHeapObject(Importer *importer, PyObject *heapId, PyObject *obj)
+{
+    if (obj == NULL) {
+        return -1;
+    }
+    importer->heapVersion++;
+    if (PyDict_SetItem(importer->heap, heapId, obj) < 0) {
+        Py_DECREF(obj);
+        return -1;
+    }
+    long long oid = saveObject(importer, obj);
+    Py_DECREF(obj);
+    if (oid < 0) {
+        return -1;
+    }
+    sqlite3_stmt *statement = importer->insertHeapRef;
+    sqlite3_bind_int64(statement, 1, PyLong_AsLongLong(heapId));
+    sqlite3_bind_int64(statement, 2, importer->heapVersion);
+    sqlite3_bind_int64(statement, 3, oid);
+    return runStatement(importer, statement);
+}
+
+static PyObject *
+getHeapObject(Importer *importer, PyObject *heapId)
+{
+    PyObject *obj = PyDict_GetItemWithError(importer->heap, heapId);
+    if (obj == NULL && !PyErr_Occurred()) {
+        _PyErr_SetKeyError(heapId);
+    }
+    return obj;
+}
+
+static PyObject *
+getReferred(Importer *importer, PyObject *ref)
+{
+    if (!HeapRef_Check(ref)) {
+        PyErr_Format(PyExc_TypeError, "expected a heap reference, not %R", ref);
+        return NULL;
+    }
+    PyObject *heapId = PyLong_FromUnsignedLongLong(((HeapRefObject *)ref)->id);
+    if (heapId == NULL) {
+        return NULL;
+    }
+    PyObject *obj = getHeapObject(importer, heapId);
+    Py_DECREF(heapId);
+    return obj;
+}
+
+/* A new copy of the object at heapId, as obj.copy() */
+static PyObject *
+copyHeapObject(Importer *importer, PyObject *heapId)
+{
+    PyObject *obj = getHeapObject(importer, heapId);
+    if (obj == NULL) {
+        return NULL;
+    }
+    if (PyList_CheckExact(obj)) {
+        return PyList_GetSlice(obj, 0, PyList_GET_SIZE(obj));
+    }
+    if (PyDict_CheckExact(obj)) {
+        return PyDict_Copy(obj);
+    }
+    if (Py_IS_TYPE(obj, &PySet_Type)) {
+        return PySet_New(obj);
+    }
+    return PyObject_CallMethod(obj, "copy", NULL);
+}
+
+static PyObject *
+sequenceOf(PyObject *const *items, Py_ssize_t count, int tuple)
+{
+    PyObject *seq = tuple ? PyTuple_New(count) : PyList_New(count);
+    if (seq == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_INCREF(items[i]);
+        if (tuple) {
+            PyTuple_SET_ITEM(seq, i, items[i]);
+        }
+        else {
+            PyList_SET_ITEM(seq, i, items[i]);
+        }
+    }
+    return seq;
+}
+
+static int
+insertSnapshot(Importer *importer, long long lineNo, int haveLineNo)
+{
+    sqlite3_stmt *statement = importer->insertSnapshot;
+    sqlite3_bind_int64(statement, 1, importer->nextSnapshotId++);
+    if (importer->depth > 0) {
+        sqlite3_bind_int64(statement, 2, importer->stack[importer->depth - 1].id);
+    }
+    sqlite3_bind_int64(statement, 3, importer->heapVersion);
+    if (haveLineNo) {
+        sqlite3_bind_int64(statement, 4, lineNo);
+    }
+    return runStatement(importer, statement);
+}
+
+/* recreate.py's save_variable_change() */
+static int
+insertVariableChange(Importer *importer, long long funCallId, PyObject *name)
+{
+    if (HeapRef_Check(name) && (name = getReferred(importer, name)) == NULL) {
+        return -1;
+    }
+    if (!PyUnicode_Check(name)) {
+        return 0;
+    }
+    sqlite3_stmt *statement = importer->insertVariableChange;
+    sqlite3_bind_int64(statement, 1, funCallId);
+    if (bindText(importer, statement, 2, name) < 0) {
+        return -1;
+    }
+    sqlite3_bind_int64(statement, 3, importer->heapVersion);
+    return runStatement(importer, statement);
+}
+
+/* recreate.py's ensure_code_file_saved() */
+static int
+saveCodeFile(Importer *importer, PyObject *filename)
+{
+    int known = PyDict_Contains(importer->codeFiles, filename);
+    if (known != 0) {
+        return known;
+    }
+    PyObject *path = PyUnicode_EncodeFSDefault(filename);
+    if (path == NULL) {
+        return -1;
+    }
+    struct stat status;
+    int isFile = stat(PyBytes_AS_STRING(path), &status) == 0 && S_ISREG(status.st_mode);
+    Py_DECREF(path);
+    if (!isFile) {
+        return 0;
+    }
+    /* frozen code, such as the loader that runs a script, makes no steps
+       before the first code from a source file */
+    importer->activateSnapshots = 1;
+
+    PyObject *io = PyImport_ImportModule("io");
+    if (io == NULL) {
+        return -1;
+    }
+    PyObject *file = PyObject_CallMethod(io, "open", "Os", filename, "r");
+    Py_DECREF(io);
+    if (file == NULL) {
+        return -1;
+    }
+    PyObject *content = PyObject_CallMethod(file, "read", NULL);
+    PyObject *closed = PyObject_CallMethod(file, "close", NULL);
+    Py_DECREF(file);
+    if (content == NULL || closed == NULL) {
+        Py_XDECREF(content);
+        Py_XDECREF(closed);
+        return -1;
+    }
+    Py_DECREF(closed);
+
+    long long id = importer->nextCodeFileId++;
+    sqlite3_stmt *statement = importer->insertCodeFile;
+    sqlite3_bind_int64(statement, 1, id);
+    int result = -1;
+    if (bindText(importer, statement, 2, filename) == 0 &&
+        bindText(importer, statement, 3, content) == 0 &&
+        runStatement(importer, statement) == 0) {
+        PyObject *value = PyLong_FromLongLong(id);
+        if (value != NULL) {
+            result = PyDict_SetItem(importer->codeFiles, filename, value);
+            Py_DECREF(value);
+        }
+    }
+    Py_DECREF(content);
+    return result;
+}
+
+/* dict of names[i] => values[i] */
+static PyObject *
+varDict(PyObject *names, PyObject *const *values, Py_ssize_t count)
+{
+    if (PyTuple_GET_SIZE(names) > count) {
+        PyErr_SetString(PyExc_IndexError, "fewer values than variables in PUSH_FRAME");
+        return NULL;
+    }
+    PyObject *dict = PyDict_New();
+    if (dict == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(names); i++) {
+        if (PyDict_SetItem(dict, PyTuple_GET_ITEM(names, i), values[i]) < 0) {
+            Py_DECREF(dict);
+            return NULL;
+        }
+    }
+    return dict;
+}
+
+static int
+pushFrame(Importer *importer, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *code = args[0];
+    PyObject *filename = PyTuple_GET_ITEM(code, 0);
+    PyObject *name = PyTuple_GET_ITEM(code, 1);
+    PyObject *varnames = PyTuple_GET_ITEM(code, 2);
+    PyObject *cellvars = PyTuple_GET_ITEM(code, 3);
+    PyObject *freevars = PyTuple_GET_ITEM(code, 4);
+    PyObject *globalsId = args[1];
+    PyObject *localsId = args[2];
+    PyObject *const *values = args + 3;
+    Py_ssize_t count = nargs - 3;
+    Py_ssize_t localCount = Py_MIN(PyTuple_GET_SIZE(varnames), count);
+    Py_ssize_t cellCount = Py_MIN(PyTuple_GET_SIZE(cellvars), count - localCount);
+
+    PyObject *locals = varDict(varnames, values, count);
+    PyObject *cells = varDict(cellvars, values + localCount, count - localCount);
+    PyObject *frees = varDict(freevars, values + localCount + cellCount,
+                              count - localCount - cellCount);
+    int result = -1;
+    if (locals == NULL || cells == NULL || frees == NULL ||
+        saveCodeFile(importer, filename) < 0) {
+        Py_XDECREF(locals);
+        goto done;
+    }
+    if (updateHeapObject(importer, localsId, locals) < 0) {
+        goto done;
+    }
+
+    long long id = importer->nextFunCallId++;
+    sqlite3_stmt *statement = importer->insertFunCall;
+    sqlite3_bind_int64(statement, 1, id);
+    if (bindText(importer, statement, 2, name) < 0) {
+        goto done;
+    }
+    sqlite3_bind_int64(statement, 3, PyLong_AsLongLong(localsId));
+    sqlite3_bind_int64(statement, 4, PyLong_AsLongLong(globalsId));
+    if (bindSerialized(importer, statement, 5, cells) < 0 ||
+        bindSerialized(importer, statement, 6, frees) < 0) {
+        goto done;
+    }
+    if (importer->depth > 0) {
+        sqlite3_bind_int64(statement, 7, importer->stack[importer->depth - 1].id);
+    }
+    PyObject *codeFileId = PyDict_GetItemWithError(importer->codeFiles, filename);
+    if (codeFileId != NULL) {
+        sqlite3_bind_int64(statement, 8, PyLong_AsLongLong(codeFileId));
+    }
+    else if (PyErr_Occurred()) {
+        goto done;
+    }
+    if (importer->thread != 0) {
+        sqlite3_bind_int64(statement, 9, importer->thread);
+    }
+    if (runStatement(importer, statement) < 0) {
+        goto done;
+    }
+    if (_PyUnicode_EqualToASCIIString(name, "<module>")) {
+        PyObject *value = PyLong_FromLongLong(id);
+        if (value == NULL) {
+            goto done;
+        }
+        int stored = PyDict_SetItem(importer->moduleCalls, globalsId, value);
+        Py_DECREF(value);
+        if (stored < 0) {
+            goto done;
+        }
+    }
+    for (Py_ssize_t i = 0; i < localCount; i++) {
+        if (values[i] != Py_None &&
+            insertVariableChange(importer, id, PyTuple_GET_ITEM(varnames, i)) < 0) {
+            goto done;
+        }
+    }
+
+    if (importer->depth == importer->stackSize) {
+        size_t size = Py_MAX(2 * importer->stackSize, 64);
+        FunCall *stack = PyMem_Realloc(importer->stack, size * sizeof(FunCall));
+        if (stack == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        importer->stack = stack;
+        importer->stackSize = size;
+    }
+    FunCall *call = &importer->stack[importer->depth++];
+    call->id = id;
+    Py_INCREF(name);
+    call->name = name;
+    Py_INCREF(varnames);
+    call->varnames = varnames;
+    Py_INCREF(localsId);
+    call->localsId = localsId;
+    result = 0;
+done:
+    Py_XDECREF(cells);
+    Py_XDECREF(frees);
+    return result;
+}
+
+static void
+popFrame(Importer *importer)
+{
+    FunCall *call = &importer->stack[--importer->depth];
+    Py_DECREF(call->name);
+    Py_DECREF(call->varnames);
+    Py_DECREF(call->localsId);
+}
+
+static void
+clearCalls(FunCall *calls, size_t depth)
+{
+    for (size_t i = 0; i < depth; i++) {
+        Py_DECREF(calls[i].name);
+        Py_DECREF(calls[i].varnames);
+        Py_DECREF(calls[i].localsId);
+    }
+    PyMem_Free(calls);
+}
+
+/* Make thread the one the events from here on come from: set its calls
+   aside until then, and take up its own. */
+static int
+switchThread(Importer *importer, long long thread)
+{
+    if (thread == importer->thread) {
+        return 0;
+    }
+    if (importer->stack != NULL) {
+        if (importer->otherStackCount == importer->otherStacksSize) {
+            size_t size = Py_MAX(2 * importer->otherStacksSize, 8);
+            CallStack *stacks = PyMem_Realloc(importer->otherStacks,
+                                              size * sizeof(CallStack));
+            if (stacks == NULL) {
+                PyErr_NoMemory();
+                return -1;
+            }
+            importer->otherStacks = stacks;
+            importer->otherStacksSize = size;
+        }
+        CallStack *parked = &importer->otherStacks[importer->otherStackCount++];
+        parked->thread = importer->thread;
+        parked->calls = importer->stack;
+        parked->depth = importer->depth;
+        parked->size = importer->stackSize;
+    }
+    importer->thread = thread;
+    importer->stack = NULL;
+    importer->depth = 0;
+    importer->stackSize = 0;
+    for (size_t i = 0; i < importer->otherStackCount; i++) {
+        CallStack *parked = &importer->otherStacks[i];
+        if (parked->thread == thread) {
+            importer->stack = parked->calls;
+            importer->depth = parked->depth;
+            importer->stackSize = parked->size;
+            *parked = importer->otherStacks[--importer->otherStackCount];
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Drop the calls of all threads. */
+static void
+clearStacks(Importer *importer)
+{
+    clearCalls(importer->stack, importer->depth);
+    importer->stack = NULL;
+    importer->depth = 0;
+    importer->stackSize = 0;
+    importer->thread = 0;
+    for (size_t i = 0; i < importer->otherStackCount; i++) {
+        CallStack *parked = &importer->otherStacks[i];
+        clearCalls(parked->calls, parked->depth);
+    }
+    importer->otherStackCount = 0;
+}
+
+static FunCall *
+currentCall(Importer *importer)
+{
+    if (importer->depth == 0) {
+        PyErr_SetString(PyExc_RuntimeError, "no function call on the stack");
+        return NULL;
+    }
+    return &importer->stack[importer->depth - 1];
+}
+
+/* Store value under key in a copy of the object at heapId. */
+static int
+storeItem(Importer *importer, PyObject *heapId, PyObject *key, PyObject *value)
+{
+    PyObject *obj = copyHeapObject(importer, heapId);
+    if (obj == NULL) {
+        return -1;
+    }
+    if (PyObject_SetItem(obj, key, value) < 0) {
+        Py_DECREF(obj);
+        return -1;
+    }
+    return updateHeapObject(importer, heapId, obj);
+}
+
+/* Call method on a copy of the object at heapId. */
+static int
+callOnCopy(Importer *importer, PyObject *heapId, const char *method,
+           PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *obj = copyHeapObject(importer, heapId);
+    if (obj == NULL) {
+        return -1;
+    }
+    PyObject *callable = PyObject_GetAttrString(obj, method);
+    if (callable == NULL) {
+        Py_DECREF(obj);
+        return -1;
+    }
+    PyObject *result = PyObject_Vectorcall(callable, args, nargs, NULL);
+    Py_DECREF(callable);
+    if (result == NULL) {
+        Py_DECREF(obj);
+        return -1;
+    }
+    Py_DECREF(result);
+    return updateHeapObject(importer, heapId, obj);
+}
+
+static PyObject *
+sliceOf(PyObject *const *args)
+{
+    return PySlice_New(args[0], args[1], args[2]);
+}
+
+/* Apply the event with the given opcode and arguments. Returns 0, 1 for an
+   event recreate.py has no process function for, or -1 with an exception
+   set. */
+static int
+processEvent(Importer *importer, int opcode, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *heapId = nargs > 0 ? args[0] : NULL;
+    PyObject *obj;
+    FunCall *call;
+
+    switch (opcode) {
+    case REWIND_PUSH_FRAME:
+        return pushFrame(importer, args, nargs);
+
+    case REWIND_VISIT:
+        importer->currLineNo = PyLong_AsLongLong(args[0]);
+        importer->haveLineNo = 1;
+        /* the line a checkpoint gives isn't a step */
+        if (!importer->activateSnapshots || importer->inCheckpoint) {
+            return 0;
+        }
+        return insertSnapshot(importer, importer->currLineNo, 1);
+
+    case REWIND_STORE_NAME:
+    case REWIND_STORE_GLOBAL: {
+        if (storeItem(importer, heapId, args[1], args[2]) < 0) {
+            return -1;
+        }
+        /* A global changes in the call that ran its module, a name in the
+           current call. With no call on the stack, as when recording
+           started in the middle of a module, the name goes to the call of
+           the module if there is one, and is left out of VariableChange
+           otherwise. */
+        PyObject *moduleCall = NULL;
+        if (opcode == REWIND_STORE_GLOBAL || importer->depth == 0) {
+            moduleCall = PyDict_GetItemWithError(importer->moduleCalls, heapId);
+            if (moduleCall == NULL && PyErr_Occurred()) {
+                return -1;
+            }
+        }
+        if (moduleCall != NULL) {
+            return insertVariableChange(importer, PyLong_AsLongLong(moduleCall), args[1]);
+        }
+        if (importer->depth == 0) {
+            return 0;
+        }
+        return insertVariableChange(importer, currentCall(importer)->id, args[1]);
+    }
+
+    case REWIND_STORE_ATTR: {
+        int known = PyDict_Contains(importer->heap, heapId);
+        if (known <= 0) {
+            return known;
+        }
+        return storeItem(importer, heapId, args[1], args[2]);
+    }
+
+    case REWIND_STORE_FAST: {
+        /* the variables of a frame the log never pushed are not known */
+        if (importer->depth == 0) {
+            return 0;
+        }
+        call = currentCall(importer);
+        PyObject *varname = PySequence_GetItem(call->varnames, PyLong_AsSsize_t(args[0]));
+        if (varname == NULL) {
+            return -1;
+        }
+        int result = storeItem(importer, call->localsId, varname, args[1]);
+        if (result == 0) {
+            result = insertVariableChange(importer, call->id, varname);
+        }
+        Py_DECREF(varname);
+        return result;
+    }
+
+    case REWIND_STORE_DEREF: {
+        PyObject *key = PyUnicode_InternFromString("ob_ref");
+        if (key == NULL) {
+            return -1;
+        }
+        int result = storeItem(importer, heapId, key, args[1]);
+        Py_DECREF(key);
+        return result;
+    }
+
+    case REWIND_RETURN_VALUE:
+    case REWIND_YIELD_VALUE: {
+        if (!importer->activateSnapshots) {
+            return 0;
+        }
+        if ((call = currentCall(importer)) == NULL) {
+            return -1;
+        }
+        PyObject *key = PyUnicode_InternFromString("<ret val>");
+        if (key == NULL) {
+            return -1;
+        }
+        int result = storeItem(importer, call->localsId, key, args[0]);
+        Py_DECREF(key);
+        if (result < 0) {
+            return -1;
+        }
+        return insertSnapshot(importer, importer->currLineNo, importer->haveLineNo);
+    }
+
+    case REWIND_POP_FRAME: {
+        if ((call = currentCall(importer)) == NULL) {
+            return -1;
+        }
+        int same = PyObject_RichCompareBool(call->name, args[1], Py_EQ);
+        if (same <= 0) {
+            if (same == 0) {
+                PyErr_Format(PyExc_RuntimeError,
+                             "stack function names not matching: expected %R, got %R",
+                             args[1], call->name);
+            }
+            return -1;
+        }
+        popFrame(importer);
+        return 0;
+    }
+
+    case REWIND_NEW_LIST:
+    case REWIND_LIST_SORT:
+        return updateHeapObject(importer, heapId, sequenceOf(args + 1, nargs - 1, 0));
+
+    case REWIND_NEW_TUPLE:
+        return updateHeapObject(importer, heapId, sequenceOf(args + 1, nargs - 1, 1));
+
+    case REWIND_NEW_STRING:
+    case REWIND_STRING_INPLACE_ADD_RESULT:
+        Py_INCREF(args[1]);
+        return updateHeapObject(importer, heapId, args[1]);
+
+    case REWIND_LIST_APPEND:
+    case REWIND_LIST_EXTEND: {
+        if ((obj = getHeapObject(importer, heapId)) == NULL) {
+            return -1;
+        }
+        PyObject *tail;
+        if (opcode == REWIND_LIST_APPEND) {
+            tail = sequenceOf(args + 1, 1, 0);
+        }
+        else {
+            PyObject *other = getReferred(importer, args[1]);
+            tail = other == NULL ? NULL : PySequence_List(other);
+        }
+        if (tail == NULL) {
+            return -1;
+        }
+        PyObject *list = PyNumber_Add(obj, tail);
+        Py_DECREF(tail);
+        return updateHeapObject(importer, heapId, list);
+    }
+
+    case REWIND_LIST_STORE_SUBSCRIPT:
+    case REWIND_DICT_STORE_SUBSCRIPT:
+        return storeItem(importer, heapId, args[1], args[2]);
+
+    case REWIND_LIST_STORE_SUBSCRIPT_SLICE: {
+        PyObject *value = args[4];
+        if (HeapRef_Check(value) && (value = getReferred(importer, value)) == NULL) {
+            return -1;
+        }
+        PyObject *slice = sliceOf(args + 1);
+        if (slice == NULL) {
+            return -1;
+        }
+        int result = storeItem(importer, heapId, slice, value);
+        Py_DECREF(slice);
+        return result;
+    }
+
+    case REWIND_LIST_DELETE_SUBSCRIPT:
+    case REWIND_LIST_DELETE_SUBSCRIPT_SLICE:
+    case REWIND_DICT_DELETE_SUBSCRIPT: {
+        PyObject *key = opcode == REWIND_LIST_DELETE_SUBSCRIPT_SLICE ?
+            sliceOf(args + 1) : (Py_INCREF(args[1]), args[1]);
+        if (key == NULL) {
+            return -1;
+        }
+        obj = copyHeapObject(importer, heapId);
+        if (obj == NULL || PyObject_DelItem(obj, key) < 0) {
+            Py_XDECREF(obj);
+            Py_DECREF(key);
+            return -1;
+        }
+        Py_DECREF(key);
+        return updateHeapObject(importer, heapId, obj);
+    }
+
+    case REWIND_LIST_INSERT:
+        return callOnCopy(importer, heapId, "insert", args + 1, 2);
+    case REWIND_LIST_REMOVE:
+        return callOnCopy(importer, heapId, "remove", args + 1, 1);
+    case REWIND_LIST_POP:
+    case REWIND_DICT_POP:
+    case REWIND_DICT_POP_ITEM:
+        return callOnCopy(importer, heapId, "pop", args + 1, 1);
+    case REWIND_LIST_REVERSE:
+        return callOnCopy(importer, heapId, "reverse", NULL, 0);
+    case REWIND_DICT_SET_DEFAULT:
+        return callOnCopy(importer, heapId, "setdefault", args + 1, 2);
+    case REWIND_SET_ADD:
+        return callOnCopy(importer, heapId, "add", args + 1, 1);
+    case REWIND_SET_DISCARD:
+        return callOnCopy(importer, heapId, "discard", args + 1, 1);
+
+    case REWIND_LIST_CLEAR:
+        return updateHeapObject(importer, heapId, PyList_New(0));
+    case REWIND_DICT_CLEAR:
+    case REWIND_NEW_OBJECT:
+        return updateHeapObject(importer, heapId, PyDict_New());
+    case REWIND_SET_CLEAR:
+        return updateHeapObject(importer, heapId, PySet_New(NULL));
+
+    case REWIND_LIST_PERMUTE: {
+        if ((obj = getHeapObject(importer, heapId)) == NULL) {
+            return -1;
+        }
+        PyObject *list = PyList_New(0);
+        for (Py_ssize_t i = 1; list != NULL && i + 1 < nargs; i += 2) {
+            Py_ssize_t start = PyLong_AsSsize_t(args[i]);
+            Py_ssize_t length = PyLong_AsSsize_t(args[i + 1]);
+            PyObject *run = PySequence_GetSlice(obj, start, start + length);
+            if (run == NULL ||
+                PyList_SetSlice(list, PY_SSIZE_T_MAX, PY_SSIZE_T_MAX, run) < 0) {
+                Py_XDECREF(run);
+                Py_CLEAR(list);
+                break;
+            }
+            Py_DECREF(run);
+        }
+        return updateHeapObject(importer, heapId, list);
+    }
+
+    case REWIND_LIST_SPLICE: {
+        PyObject *items = sequenceOf(args + 3, nargs - 3, 0);
+        if (items == NULL) {
+            return -1;
+        }
+        obj = copyHeapObject(importer, heapId);
+        if (obj == NULL ||
+            PySequence_SetSlice(obj, PyLong_AsSsize_t(args[1]),
+                                PyLong_AsSsize_t(args[2]), items) < 0) {
+            Py_XDECREF(obj);
+            Py_DECREF(items);
+            return -1;
+        }
+        Py_DECREF(items);
+        return updateHeapObject(importer, heapId, obj);
+    }
+
+    case REWIND_NEW_DICT: {
+        PyObject *dict = PyDict_New();
+        for (Py_ssize_t i = 1; dict != NULL && i < nargs; i += 2) {
+            if (i + 1 >= nargs) {
+                PyErr_SetString(PyExc_IndexError, "NEW_DICT key without a value");
+                Py_CLEAR(dict);
+            }
+            else if (PyDict_SetItem(dict, args[i], args[i + 1]) < 0) {
+                Py_CLEAR(dict);
+            }
+        }
+        return updateHeapObject(importer, heapId, dict);
+    }
+
+    case REWIND_NEW_SET: {
+        PyObject *items = sequenceOf(args + 1, nargs - 1, 1);
+        if (items == NULL) {
+            return -1;
+        }
+        PyObject *set = PySet_New(items);
+        Py_DECREF(items);
+        return updateHeapObject(importer, heapId, set);
+    }
+
+    case REWIND_SET_UPDATE: {
+        if ((obj = getHeapObject(importer, heapId)) == NULL) {
+            return -1;
+        }
+        Py_ssize_t addedCount = PyLong_AsSsize_t(args[1]);
+        PyObject *added = sequenceOf(args + 2, addedCount, 1);
+        PyObject *removed = sequenceOf(args + 3 + addedCount, nargs - 3 - addedCount, 1);
+        PyObject *set = NULL;
+        if (added != NULL && removed != NULL) {
+            set = PyObject_CallMethod(obj, "difference", "(O)", removed);
+            if (set != NULL && _PySet_Update(set, added) < 0) {
+                Py_CLEAR(set);
+            }
+        }
+        Py_XDECREF(added);
+        Py_XDECREF(removed);
+        return updateHeapObject(importer, heapId, set);
+    }
+
+    case REWIND_THREAD:
+        return switchThread(importer, PyLong_AsLongLong(args[0]));
+
+    case REWIND_INPUT:
+        /* only replays of the program take inputs */
+        return 0;
+
+    case REWIND_ELIDED: {
+        /* what sampling left out, after the last step */
+        sqlite3_stmt *statement = importer->insertElision;
+        if (importer->nextSnapshotId > 1) {
+            sqlite3_bind_int64(statement, 1, importer->nextSnapshotId - 1);
+        }
+        if (importer->depth > 0) {
+            sqlite3_bind_int64(statement, 2, importer->stack[importer->depth - 1].id);
+        }
+        if (bindText(importer, statement, 3, PyTuple_GET_ITEM(args[0], 1)) < 0) {
+            return -1;
+        }
+        sqlite3_bind_int64(statement, 4, PyLong_AsLongLong(args[1]));
+        sqlite3_bind_int64(statement, 5, PyLong_AsLongLong(args[2]));
+        return runStatement(importer, statement);
+    }
+
+    case REWIND_CHECKPOINT:
+        /* a checkpoint restates the heap and the stacks as they are before
+           the event with the index it gives */
+        clearStacks(importer);
+        importer->checkpointNextEvent = PyLong_AsLongLong(args[0]);
+        importer->inCheckpoint = 1;
+        return 0;
+
+    case REWIND_CHECKPOINT_END:
+        /* count events as if replaying from the start */
+        importer->eventNo = importer->checkpointNextEvent;
+        importer->inCheckpoint = 0;
+        /* the program is running, as a segment or a recording started
+           from running code takes it up */
+        importer->activateSnapshots = 1;
+        if (importer->fromCheckpoint && !importer->haveStartCheckpoint) {
+            importer->haveStartCheckpoint = 1;
+            importer->startHeapVersion = importer->heapVersion;
+            importer->startFunCalls = importer->nextFunCallId - 1;
+        }
+        return 0;
+    }
+    return 1;
+}
+
+static int
+prepare(Importer *importer, sqlite3_stmt **statement, const char *sql)
+{
+    if (sqlite3_prepare_v2(importer->db, sql, -1, statement, NULL) != SQLITE_OK) {
+        return databaseError(importer);
+    }
+    return 0;
+}
+
+static int
+startImport(Importer *importer, PyObject *connection)
+{
+    PyObject *sqlite = PyImport_ImportModule("_sqlite3");
+    if (sqlite == NULL) {
+        return -1;
+    }
+    PyObject *connectionType = PyObject_GetAttrString(sqlite, "Connection");
+    Py_DECREF(sqlite);
+    if (connectionType == NULL) {
+        return -1;
+    }
+    int isConnection = PyObject_IsInstance(connection, connectionType);
+    Py_DECREF(connectionType);
+    if (isConnection <= 0) {
+        if (isConnection == 0) {
+            PyErr_Format(PyExc_TypeError,
+                         "recreate() connection must be a sqlite3.Connection, not %.200s",
+                         Py_TYPE(connection)->tp_name);
+        }
+        return -1;
+    }
+    importer->connection = connection;
+    importer->db = ((pysqlite_Connection *)connection)->db;
+    if (importer->db == NULL) {
+        PyObject *error = PyObject_GetAttrString(connection, "ProgrammingError");
+        if (error != NULL) {
+            PyErr_SetString(error, "Cannot operate on a closed database.");
+            Py_DECREF(error);
+        }
+        return -1;
+    }
+    if (prepare(importer, &importer->insertSnapshot,
+                "INSERT INTO Snapshot VALUES (?, ?, ?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertObject,
+                "INSERT INTO Object VALUES (?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertFunCall,
+                "INSERT INTO FunCall VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertCodeFile,
+                "INSERT INTO CodeFile VALUES (?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertHeapRef,
+                "INSERT INTO HeapRef VALUES (?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertVariableChange,
+                "INSERT INTO VariableChange VALUES (?, ?, ?)") < 0 ||
+        prepare(importer, &importer->insertElision,
+                "INSERT INTO Elision VALUES (?, ?, ?, ?, ?)") < 0) {
+        return -1;
+    }
+    importer->heap = PyDict_New();
+    importer->codeFiles = PyDict_New();
+    importer->moduleCalls = PyDict_New();
+    importer->chunkIds = PyDict_New();
+    if (importer->heap == NULL || importer->codeFiles == NULL ||
+        importer->moduleCalls == NULL || importer->chunkIds == NULL) {
+        return -1;
+    }
+    importer->nextSnapshotId = 1;
+    importer->nextFunCallId = 1;
+    importer->nextObjectId = 1;
+    importer->nextCodeFileId = 1;
+    importer->heapVersion = 1;
+    if (sqlite3_get_autocommit(importer->db) && execute(importer, "BEGIN") < 0) {
+        return -1;
+    }
+
+    PyObject *emptyList = PyList_New(0);
+    PyObject *emptyDict = PyDict_New();
+    PyObject *emptySet = PySet_New(NULL);
+    int result = -1;
+    if (emptyList != NULL && emptyDict != NULL && emptySet != NULL) {
+        importer->emptyListOid = insertObject(importer, importer->nextObjectId++, emptyList);
+        importer->emptyDictOid = insertObject(importer, importer->nextObjectId++, emptyDict);
+        importer->emptySetOid = insertObject(importer, importer->nextObjectId++, emptySet);
+        if (importer->emptyListOid > 0 && importer->emptyDictOid > 0 &&
+            importer->emptySetOid > 0) {
+            result = 0;
+        }
+    }
+    Py_XDECREF(emptyList);
+    Py_XDECREF(emptyDict);
+    Py_XDECREF(emptySet);
+    return result;
+}
+
+/* The ids of the calls in calls, outermost first, under thread in stacks */
+static int
+addStack(PyObject *stacks, long long thread, FunCall *calls, size_t depth)
+{
+    if (depth == 0) {
+        return 0;
+    }
+    PyObject *ids = PyList_New(depth);
+    if (ids == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < depth; i++) {
+        PyObject *id = PyLong_FromLongLong(calls[i].id);
+        if (id == NULL) {
+            Py_DECREF(ids);
+            return -1;
+        }
+        PyList_SET_ITEM(ids, i, id);
+    }
+    PyObject *key = thread != 0 ? PyLong_FromLongLong(thread) : Py_NewRef(Py_None);
+    int result = key != NULL ? PyDict_SetItem(stacks, key, ids) : -1;
+    Py_XDECREF(key);
+    Py_DECREF(ids);
+    return result;
+}
+
+/* What recreate.py's recreate_past() returns */
+static PyObject *
+importResult(Importer *importer)
+{
+    PyObject *stacks = PyDict_New();
+    if (stacks == NULL ||
+        addStack(stacks, importer->thread, importer->stack, importer->depth) < 0) {
+        Py_XDECREF(stacks);
+        return NULL;
+    }
+    for (size_t i = 0; i < importer->otherStackCount; i++) {
+        CallStack *parked = &importer->otherStacks[i];
+        if (addStack(stacks, parked->thread, parked->calls, parked->depth) < 0) {
+            Py_DECREF(stacks);
+            return NULL;
+        }
+    }
+    PyObject *result;
+    if (importer->haveStartCheckpoint) {
+        result = Py_BuildValue("{s:N,s:(LL)}", "stacks", stacks, "checkpoint",
+                               importer->startHeapVersion, importer->startFunCalls);
+    }
+    else {
+        result = Py_BuildValue("{s:N,s:O}", "stacks", stacks, "checkpoint", Py_None);
+    }
+    return result;
+}
+
+static void
+finishImport(Importer *importer)
+{
+    /* keep what was imported, even after an error */
+    if (importer->db != NULL && !sqlite3_get_autocommit(importer->db)) {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        if (execute(importer, "COMMIT") < 0) {
+            if (type != NULL) {
+                PyErr_Clear();
+            }
+            else {
+                PyErr_Fetch(&type, &value, &traceback);
+            }
+        }
+        PyErr_Restore(type, value, traceback);
+    }
+    sqlite3_finalize(importer->insertSnapshot);
+    sqlite3_finalize(importer->insertObject);
+    sqlite3_finalize(importer->insertFunCall);
+    sqlite3_finalize(importer->insertCodeFile);
+    sqlite3_finalize(importer->insertHeapRef);
+    sqlite3_finalize(importer->insertVariableChange);
+    sqlite3_finalize(importer->insertElision);
+    clearStacks(importer);
+    PyMem_Free(importer->otherStacks);
+    PyMem_Free(importer->text.data);
+    PyMem_Free(importer->entries.data);
+    PyMem_Free(importer->entryEnds);
+    PyMem_Free(importer->chunkOids);
+    Py_XDECREF(importer->chunkIds);
+    Py_XDECREF(importer->heap);
+    Py_XDECREF(importer->codeFiles);
+    Py_XDECREF(importer->moduleCalls);
+}
+
+/* Go through the events of the blocks from start on, up to the first
+   block after it that starts at or after the event with index stopEvent.
+   The checkpoint a block starts with is skipped, unless the block is
+   flagged REWIND_BLOCK_RESYNC, or it is the first block and replayFirst is
+   set. */
+static int
+importBlocks(Importer *importer, LogReader *reader, size_t start, int replayFirst,
+             unsigned long long stopEvent)
+{
+    for (size_t i = start; i < reader->blockCount; i++) {
+        Block *block = &reader->blocks[i];
+        if (i > start && block->firstEvent >= stopEvent) {
+            break;
+        }
+        if (loadBlock(reader, block) < 0) {
+            return -1;
+        }
+        int checkpoint = (replayFirst && i == start) ||
+                         (block->flags & REWIND_BLOCK_RESYNC);
+        int inCheckpoint = 0;
+        while (reader->pos < reader->dataSize) {
+            int opcode = readEvent(reader);
+            if (opcode < 0) {
+                return -1;
+            }
+            if (opcode == REWIND_LOG) {
+                continue;
+            }
+            if (opcode == REWIND_CHECKPOINT) {
+                inCheckpoint = 1;
+            }
+            int skip = inCheckpoint && !checkpoint;
+            if (opcode == REWIND_CHECKPOINT_END) {
+                inCheckpoint = 0;
+            }
+            if (skip) {
+                continue;
+            }
+
+            importer->eventNo++;
+            if (importer->eventNo % EVENTS_PER_PROGRESS == 0) {
+                PySys_WriteStdout("\rEvent %lld", importer->eventNo);
+            }
+            if (importer->eventNo % EVENTS_PER_TRANSACTION == 0 &&
+                (execute(importer, "COMMIT") < 0 || execute(importer, "BEGIN") < 0)) {
+                return -1;
+            }
+            int result = processEvent(importer, opcode, reader->args, reader->argCount);
+            if (result < 0) {
+                _PyErr_FormatFromCause(PyExc_RuntimeError,
+                                       "failed to recreate event %lld (%s)",
+                                       importer->eventNo, eventNames[opcode]);
+                return -1;
+            }
+            if (result > 0) {
+                PySys_WriteStdout("Warning: no process function for command %s on event %lld\n",
+                                  eventNames[opcode], importer->eventNo);
+            }
+        }
+    }
+    return 0;
+}
+
+/*[clinic input]
+_rewindimport.recreate
+
+    connection: object
+        An open sqlite3 connection to a database with the tables
+        recreate.py defines.
+    filename: object(converter="PyUnicode_FSDecoder")
+        The .rewind log to read.
+    start_event: object = None
+        If not None, only recreate the past from the last checkpoint at or
+        before the event with this index on.
+    stop_event: object = None
+        If not None, stop at the first block that starts at or after the
+        event with this index.
+
+Recreate the past states of the program a rewind log recorded.
+
+Returns a dict as recreate.py's recreate_past() does.
+[clinic start generated code]*/
+
+static PyObject *
+_rewindimport_recreate_impl(PyObject *module, PyObject *connection,
+                            PyObject *filename, PyObject *start_event,
+                            PyObject *stop_event)
+/*[clinic end generated code: output=fbcb5c4cd55ec537 input=77975b768def1413]*/
+{
+    LogReader reader = {0};
+    Importer importer = {0};
+    PyObject *result = NULL;
+    unsigned long long event = 0;
+    unsigned long long stop = (unsigned long long)-1;
+
+    if (start_event != Py_None) {
+        event = PyLong_AsUnsignedLongLong(start_event);
+        if (event == (unsigned long long)-1 && PyErr_Occurred()) {
+            goto done;
+        }
+    }
+    if (stop_event != Py_None) {
+        stop = PyLong_AsUnsignedLongLong(stop_event);
+        if (stop == (unsigned long long)-1 && PyErr_Occurred()) {
+            goto done;
+        }
+    }
+    if (openLog(&reader, filename) < 0 || startImport(&importer, connection) < 0) {
+        goto done;
+    }
+
+    size_t start = 0;
+    if (start_event == Py_None) {
+        while (start + 1 < reader.blockCount && reader.blocks[start + 1].firstEvent == 0) {
+            start++;
+        }
+    }
+    else {
+        for (size_t i = 0; i < reader.blockCount; i++) {
+            if (reader.blocks[i].firstEvent > event) {
+                break;
+            }
+            if (reader.blocks[i].flags & REWIND_BLOCK_CHECKPOINT) {
+                start = i;
+            }
+        }
+    }
+    importer.fromCheckpoint = start_event != Py_None;
+    if (importBlocks(&importer, &reader, start, start_event != Py_None, stop) == 0) {
+        result = importResult(&importer);
+    }
+
+done:
+    finishImport(&importer);
+    closeLog(&reader);
+    Py_DECREF(filename);
+    return result;
+}
+
+#include "clinic/_rewindimport.c.h"
+
+static PyMethodDef rewindimport_methods[] = {
+    _REWINDIMPORT_RECREATE_METHODDEF
+    {NULL, NULL}        /* sentinel */
+};
+
+static int
+rewindimport_exec(PyObject *module)
+{
+    if (PyType_Ready(&HeapRefType) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static PyModuleDef_Slot rewindimport_slots[] = {
+    {Py_mod_exec, rewindimport_exec},
+    {0, NULL}
+};
+
+PyDoc_STRVAR(rewindimport__doc__,
+"Native importer of rewind logs into the database recreate.py defines.");
+
+static struct PyModuleDef rewindimportmodule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_rewindimport",
+    .m_doc = rewindimport__doc__,
+    .m_size = 0,
+    .m_methods = rewindimport_methods,
+    .m_slots = rewindimport_slots,
+};
+
+PyMODINIT_FUNC
+PyInit__rewindimport(void)
+{
+    return PyModuleDef_Init(&rewindimportmodule);
+}
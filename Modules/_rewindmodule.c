@@ -0,0 +1,266 @@
+/* _rewind module: control over the rewind recorder from Python code */
+
+#include "Python.h"
+#include "rewind.h"
+
+/*[clinic input]
+module _rewind
+[clinic start generated code]*/
+/*[clinic end generated code: output=da39a3ee5e6b4b0d input=f84ebae7aede596d]*/
+
+#include "clinic/_rewindmodule.c.h"
+
+/* Start recording into path, a str or path-like object, with options,
+   which is None or a str as for -X rewind=options. Returns 0 on success,
+   -1 with an exception set. */
+static int
+rewind_start(PyObject *path, PyObject *options)
+{
+    PyObject *filename = NULL;
+    wchar_t *woptions = NULL;
+    int result = -1;
+    if (!PyUnicode_FSDecoder(path, &filename)) {
+        return -1;
+    }
+    if (options != Py_None) {
+        woptions = PyUnicode_AsWideCharString(options, NULL);
+        if (woptions == NULL) {
+            goto done;
+        }
+    }
+    result = Rewind_Start(filename, woptions);
+done:
+    PyMem_Free(woptions);
+    Py_DECREF(filename);
+    return result;
+}
+
+/*[clinic input]
+_rewind.start
+
+    path: object
+        The file to write the log to.
+    options: object(subclass_of="&PyUnicode_Type", c_default="Py_None") = None
+        Recording options, as given with -X rewind=options.
+
+Start recording the program into a new log.
+
+Only the calls made from then on are followed, the functions already
+running are not. Recording goes on until stop() is called or the program
+ends.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_start_impl(PyObject *module, PyObject *path, PyObject *options)
+/*[clinic end generated code: output=430a572b80b3eac7 input=b60f9d1df31bca50]*/
+{
+    if (rewind_start(path, options) < 0) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+_rewind.stop
+
+Stop recording and close the log.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_stop_impl(PyObject *module)
+/*[clinic end generated code: output=cca093a048ccb56a input=1f480744b438c947]*/
+{
+    Rewind_Deactivate();
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+_rewind.pause
+
+Stop logging events for now, until resume() is called.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_pause_impl(PyObject *module)
+/*[clinic end generated code: output=a7af36987cc9ce53 input=f776ab549ceca9fd]*/
+{
+    Rewind_Pause();
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+_rewind.resume
+
+Log events again after pause().
+
+The log goes on from a checkpoint of the state of the program.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_resume_impl(PyObject *module)
+/*[clinic end generated code: output=ec0b3a9a30f8f209 input=ac419ac211708ab6]*/
+{
+    Rewind_Resume();
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+_rewind.is_recording
+
+Return whether events are being logged.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_is_recording_impl(PyObject *module)
+/*[clinic end generated code: output=ff7e31ac7149b71c input=380ee05f032699fa]*/
+{
+    return PyBool_FromLong(Rewind_IsRecording());
+}
+
+/*[clinic input]
+_rewind.dump
+
+Write the events kept by the flight recorder out to the log.
+
+The log written by an earlier dump is replaced. Returns False when the
+recorder isn't running in flight recorder mode.
+
+SIGUSR2 dumps the log as well, unless the program sets a handler of its
+own for it with signal.signal() after the recording started.
+[clinic start generated code]*/
+
+static PyObject *
+_rewind_dump_impl(PyObject *module)
+/*[clinic end generated code: output=9e4c9de3b5e0b67b input=e5ba6cdccbd97c00]*/
+{
+    int result = Rewind_Dump();
+    if (result < 0) {
+        PyErr_SetString(PyExc_OSError, "rewind: failed to dump the flight recorder");
+        return NULL;
+    }
+    return PyBool_FromLong(result);
+}
+
+/* recording(path, options=None): context manager that records the code
+   run in its block, see _rewind.start() */
+
+typedef struct {
+    PyObject_HEAD
+    PyObject *path;
+    PyObject *options;
+} RecordingObject;
+
+static int
+recording_init(RecordingObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = {"path", "options", NULL};
+    PyObject *path;
+    PyObject *options = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:recording", kwlist,
+                                     &path, &options)) {
+        return -1;
+    }
+    if (options != Py_None && !PyUnicode_Check(options)) {
+        PyErr_Format(PyExc_TypeError,
+                     "recording() options must be str or None, not %.200s",
+                     Py_TYPE(options)->tp_name);
+        return -1;
+    }
+    Py_INCREF(path);
+    Py_XSETREF(self->path, path);
+    Py_INCREF(options);
+    Py_XSETREF(self->options, options);
+    return 0;
+}
+
+static void
+recording_dealloc(RecordingObject *self)
+{
+    Py_XDECREF(self->path);
+    Py_XDECREF(self->options);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *
+recording_enter(RecordingObject *self, PyObject *Py_UNUSED(ignored))
+{
+    if (rewind_start(self->path, self->options) < 0) {
+        return NULL;
+    }
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *
+recording_exit(RecordingObject *self, PyObject *args)
+{
+    Rewind_Deactivate();
+    Py_RETURN_FALSE;
+}
+
+static PyMethodDef recording_methods[] = {
+    {"__enter__", (PyCFunction)recording_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)recording_exit, METH_VARARGS, NULL},
+    {NULL, NULL}        /* sentinel */
+};
+
+PyDoc_STRVAR(recording__doc__,
+"recording(path, options=None)\n\
+--\n\
+\n\
+Context manager that records the code run in its block into a new log,\n\
+as start() and stop() would.");
+
+static PyTypeObject RecordingType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "_rewind.recording",
+    .tp_basicsize = sizeof(RecordingObject),
+    .tp_dealloc = (destructor)recording_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = recording__doc__,
+    .tp_methods = recording_methods,
+    .tp_init = (initproc)recording_init,
+    .tp_new = PyType_GenericNew,
+};
+
+static PyMethodDef rewind_methods[] = {
+    _REWIND_START_METHODDEF
+    _REWIND_STOP_METHODDEF
+    _REWIND_PAUSE_METHODDEF
+    _REWIND_RESUME_METHODDEF
+    _REWIND_IS_RECORDING_METHODDEF
+    _REWIND_DUMP_METHODDEF
+    {NULL, NULL}        /* sentinel */
+};
+
+static int
+rewind_exec(PyObject *module)
+{
+    return PyModule_AddType(module, &RecordingType);
+}
+
+static PyModuleDef_Slot rewind_slots[] = {
+    {Py_mod_exec, rewind_exec},
+    {0, NULL}
+};
+
+PyDoc_STRVAR(rewind__doc__,
+"Control over the rewind recorder.\n\
+\n\
+Recording is set up with -X rewind=options or the PYTHONREWIND\n\
+environment variable.");
+
+static struct PyModuleDef rewindmodule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "_rewind",
+    .m_doc = rewind__doc__,
+    .m_size = 0,
+    .m_methods = rewind_methods,
+    .m_slots = rewind_slots,
+};
+
+PyMODINIT_FUNC
+PyInit__rewind(void)
+{
+    return PyModuleDef_Init(&rewindmodule);
+}
@@ -0,0 +1,71 @@
+/*[clinic input]
+preserve
+[clinic start generated code]*/
+
+PyDoc_STRVAR(_rewindimport_recreate__doc__,
+"recreate($module, /, connection, filename, start_event=None,\n"
+"         stop_event=None)\n"
+"--\n"
+"\n"
+"Recreate the past states of the program a rewind log recorded.\n"
+"\n"
+"  connection\n"
+"    An open sqlite3 connection to a database with the tables\n"
+"    recreate.py defines.\n"
+"  filename\n"
+"    The .rewind log to read.\n"
+"  start_event\n"
+"    If not None, only recreate the past from the last checkpoint at or\n"
+"    before the event with this index on.\n"
+"  stop_event\n"
+"    If not None, stop at the first block that starts at or after the\n"
+"    event with this index.\n"
+"\n"
+"Returns a dict as recreate.py\'s recreate_past() does.");
+
+#define _REWINDIMPORT_RECREATE_METHODDEF    \
+    {"recreate", (PyCFunction)(void(*)(void))_rewindimport_recreate, METH_FASTCALL|METH_KEYWORDS, _rewindimport_recreate__doc__},
+
+static PyObject *
+_rewindimport_recreate_impl(PyObject *module, PyObject *connection,
+                            PyObject *filename, PyObject *start_event,
+                            PyObject *stop_event);
+
+static PyObject *
+_rewindimport_recreate(PyObject *module, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *return_value = NULL;
+    static const char * const _keywords[] = {"connection", "filename", "start_event", "stop_event", NULL};
+    static _PyArg_Parser _parser = {NULL, _keywords, "recreate", 0};
+    PyObject *argsbuf[4];
+    Py_ssize_t noptargs = nargs + (kwnames ? PyTuple_GET_SIZE(kwnames) : 0) - 2;
+    PyObject *connection;
+    PyObject *filename;
+    PyObject *start_event = Py_None;
+    PyObject *stop_event = Py_None;
+
+    args = _PyArg_UnpackKeywords(args, nargs, NULL, kwnames, &_parser, 2, 4, 0, argsbuf);
+    if (!args) {
+        goto exit;
+    }
+    connection = args[0];
+    if (!PyUnicode_FSDecoder(args[1], &filename)) {
+        goto exit;
+    }
+    if (!noptargs) {
+        goto skip_optional_pos;
+    }
+    if (args[2]) {
+        start_event = args[2];
+        if (!--noptargs) {
+            goto skip_optional_pos;
+        }
+    }
+    stop_event = args[3];
+skip_optional_pos:
+    return_value = _rewindimport_recreate_impl(module, connection, filename, start_event, stop_event);
+
+exit:
+    return return_value;
+}
+/*[clinic end generated code: output=e2a509eab9a6e332 input=a9049054013a1b77]*/
@@ -0,0 +1,154 @@
+/*[clinic input]
+preserve
+[clinic start generated code]*/
+
+PyDoc_STRVAR(_rewind_start__doc__,
+"start($module, /, path, options=None)\n"
+"--\n"
+"\n"
+"Start recording the program into a new log.\n"
+"\n"
+"  path\n"
+"    The file to write the log to.\n"
+"  options\n"
+"    Recording options, as given with -X rewind=options.\n"
+"\n"
+"Only the calls made from then on are followed, the functions already\n"
+"running are not. Recording goes on until stop() is called or the program\n"
+"ends.");
+
+#define _REWIND_START_METHODDEF    \
+    {"start", (PyCFunction)(void(*)(void))_rewind_start, METH_FASTCALL|METH_KEYWORDS, _rewind_start__doc__},
+
+static PyObject *
+_rewind_start_impl(PyObject *module, PyObject *path, PyObject *options);
+
+static PyObject *
+_rewind_start(PyObject *module, PyObject *const *args, Py_ssize_t nargs, PyObject *kwnames)
+{
+    PyObject *return_value = NULL;
+    static const char * const _keywords[] = {"path", "options", NULL};
+    static _PyArg_Parser _parser = {NULL, _keywords, "start", 0};
+    PyObject *argsbuf[2];
+    Py_ssize_t noptargs = nargs + (kwnames ? PyTuple_GET_SIZE(kwnames) : 0) - 1;
+    PyObject *path;
+    PyObject *options = Py_None;
+
+    args = _PyArg_UnpackKeywords(args, nargs, NULL, kwnames, &_parser, 1, 2, 0, argsbuf);
+    if (!args) {
+        goto exit;
+    }
+    path = args[0];
+    if (!noptargs) {
+        goto skip_optional_pos;
+    }
+    if (!PyUnicode_Check(args[1])) {
+        _PyArg_BadArgument("start", "argument 'options'", "str", args[1]);
+        goto exit;
+    }
+    options = args[1];
+skip_optional_pos:
+    return_value = _rewind_start_impl(module, path, options);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(_rewind_stop__doc__,
+"stop($module, /)\n"
+"--\n"
+"\n"
+"Stop recording and close the log.");
+
+#define _REWIND_STOP_METHODDEF    \
+    {"stop", (PyCFunction)_rewind_stop, METH_NOARGS, _rewind_stop__doc__},
+
+static PyObject *
+_rewind_stop_impl(PyObject *module);
+
+static PyObject *
+_rewind_stop(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return _rewind_stop_impl(module);
+}
+
+PyDoc_STRVAR(_rewind_pause__doc__,
+"pause($module, /)\n"
+"--\n"
+"\n"
+"Stop logging events for now, until resume() is called.");
+
+#define _REWIND_PAUSE_METHODDEF    \
+    {"pause", (PyCFunction)_rewind_pause, METH_NOARGS, _rewind_pause__doc__},
+
+static PyObject *
+_rewind_pause_impl(PyObject *module);
+
+static PyObject *
+_rewind_pause(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return _rewind_pause_impl(module);
+}
+
+PyDoc_STRVAR(_rewind_resume__doc__,
+"resume($module, /)\n"
+"--\n"
+"\n"
+"Log events again after pause().\n"
+"\n"
+"The log goes on from a checkpoint of the state of the program.");
+
+#define _REWIND_RESUME_METHODDEF    \
+    {"resume", (PyCFunction)_rewind_resume, METH_NOARGS, _rewind_resume__doc__},
+
+static PyObject *
+_rewind_resume_impl(PyObject *module);
+
+static PyObject *
+_rewind_resume(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return _rewind_resume_impl(module);
+}
+
+PyDoc_STRVAR(_rewind_is_recording__doc__,
+"is_recording($module, /)\n"
+"--\n"
+"\n"
+"Return whether events are being logged.");
+
+#define _REWIND_IS_RECORDING_METHODDEF    \
+    {"is_recording", (PyCFunction)_rewind_is_recording, METH_NOARGS, _rewind_is_recording__doc__},
+
+static PyObject *
+_rewind_is_recording_impl(PyObject *module);
+
+static PyObject *
+_rewind_is_recording(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return _rewind_is_recording_impl(module);
+}
+
+PyDoc_STRVAR(_rewind_dump__doc__,
+"dump($module, /)\n"
+"--\n"
+"\n"
+"Write the events kept by the flight recorder out to the log.\n"
+"\n"
+"The log written by an earlier dump is replaced. Returns False when the\n"
+"recorder isn\'t running in flight recorder mode.\n"
+"\n"
+"SIGUSR2 dumps the log as well, unless the program sets a handler of its\n"
+"own for it with signal.signal() after the recording started.");
+
+#define _REWIND_DUMP_METHODDEF    \
+    {"dump", (PyCFunction)_rewind_dump, METH_NOARGS, _rewind_dump__doc__},
+
+static PyObject *
+_rewind_dump_impl(PyObject *module);
+
+static PyObject *
+_rewind_dump(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return _rewind_dump_impl(module);
+}
+/*[clinic end generated code: output=23af0f5ef23f06fb input=a9049054013a1b77]*/
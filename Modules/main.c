@@ -6,7 +6,7 @@
 #include "pycore_pathconfig.h"    // _PyPathConfig_ComputeSysPath0()
 #include "pycore_pylifecycle.h"   // _Py_PreInitializeFromPyArgv()
 #include "pycore_pystate.h"       // _PyInterpreterState_GET()
-#include "rewind.h"
+#include "rewind.h"               // Rewind_Activate()
 
 /* Includes for exit_sigint() */
 #include <stdio.h>                // perror()
@@ -306,11 +306,35 @@ pymain_run_module(const wchar_t *modname, int set_argv0)
 }
 
 
+/* Return the recording options given with -X rewind=options or else in
+   the PYTHONREWIND environment variable, or NULL if there are none.
+   The result must be released with PyMem_RawFree(). */
+static wchar_t *
+pymain_rewind_options(const PyConfig *config)
+{
+    const PyWideStringList *xoptions = &config->xoptions;
+    for (Py_ssize_t i = xoptions->length - 1; i >= 0; i--) {
+        const wchar_t *option = xoptions->items[i];
+        if (wcsncmp(option, L"rewind=", 7) == 0) {
+            return _PyMem_RawWcsdup(option + 7);
+        }
+    }
+
+    const char *env = _Py_GetEnv(config->use_environment, "PYTHONREWIND");
+    if (env == NULL) {
+        return NULL;
+    }
+    return Py_DecodeLocale(env, NULL);
+}
+
+
 static int
 pymain_run_file(const PyConfig *config, PyCompilerFlags *cf)
 {
     const wchar_t *filename = config->run_filename;
-    Rewind_Activate(filename);
+    wchar_t *rewind_options = pymain_rewind_options(config);
+    Rewind_Activate(filename, rewind_options);
+    PyMem_RawFree(rewind_options);
     if (PySys_Audit("cpython.run_file", "u", filename) < 0) {
         return pymain_exit_err_print();
     }
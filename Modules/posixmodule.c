@@ -29,6 +29,7 @@
 #include "pycore_initconfig.h"    // _PyStatus_EXCEPTION()
 #include "pycore_pystate.h"       // _PyInterpreterState_GET()
 #include "structmember.h"         // PyMemberDef
+#include "rewind.h"               // Rewind_AfterForkChild(), Rewind_Read()
 #ifndef MS_WINDOWS
 #  include "posixmodule.h"
 #else
@@ -602,6 +603,7 @@ PyOS_AfterFork_Child(void)
     }
 
     _PySignal_AfterFork();
+    Rewind_AfterForkChild();
 
     status = _PyRuntimeState_ReInitThreads(runtime);
     if (_PyStatus_EXCEPTION(status)) {
@@ -9379,7 +9381,7 @@ os_read_impl(PyObject *module, int fd, Py_ssize_t length)
     if (buffer == NULL)
         return NULL;
 
-    n = _Py_read(fd, PyBytes_AS_STRING(buffer), length);
+    n = Rewind_Read(fd, PyBytes_AS_STRING(buffer), length);
     if (n == -1) {
         Py_DECREF(buffer);
         return NULL;
@@ -12900,11 +12902,17 @@ os_urandom_impl(PyObject *module, Py_ssize_t size)
     if (bytes == NULL)
         return NULL;
 
+    if (Rewind_ReplayData(REWIND_INPUT_URANDOM, PyBytes_AS_STRING(bytes),
+                          size) == size)
+    {
+        return bytes;
+    }
     result = _PyOS_URandom(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes));
     if (result == -1) {
         Py_DECREF(bytes);
         return NULL;
     }
+    Rewind_LogData(REWIND_INPUT_URANDOM, PyBytes_AS_STRING(bytes), size, 0);
     return bytes;
 }
 
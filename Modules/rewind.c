@@ -1,65 +1,2322 @@
 #include <string.h>
+#include <signal.h>
 #include "Python.h"
+#if defined(HAVE_FORK) && defined(HAVE_MKFIFO) && defined(HAVE_POLL_H)
+#define REWIND_FORK_CHECKPOINTS
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#endif
+#include "pycore_atomic.h"
+#include "pycore_pystate.h"
+#include "pythread.h"
 #include "frameobject.h"
+#include "opcode.h"
 #include "rewind.h"
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
+
+// Events are encoded straight into chunks, each of which becomes one block
+// of the log, see Include/rewindlog.h for the format. Full chunks are
+// passed through a ring to a writer thread, which compresses them if asked
+// to, so the interpreter thread never waits on the disk unless the writer
+// falls a whole ring behind.
+#define LOG_BLOCK_SIZE (256 * 1024)
+// leaves room for the event that ends a block without growing the chunk
+#define LOG_CHUNK_SIZE (LOG_BLOCK_SIZE + 64 * 1024)
+#define LOG_CHUNKS 16
 
 static FILE *rewindLog;
+// recording was paused by Rewind_Pause, rewindActive is off meanwhile
+static char rewindPaused = 0;
+// where the log goes, for flight recorder dumps to write it anew
+static char *logPath;
 static char rewindActive = 0;
 static int lastLine = -1;
-static PyObject *knownObjectIds;
+// The frame whose line is lastLine. Until it, or f_lasti, changes, logOp
+// only checks f_lasti against the bounds of that line the eval loop keeps.
+static PyFrameObject *lineFrame;
+// The thread lastLine is the line of. Blocks and checkpoints leave the three
+// be, so that they don't add a step to the thread that runs on past them.
+static uint64_t lineThread;
+// str => index in the log's symbol table
+static PyObject *symbols;
+// address of a code object => its index in the block, and the code objects
+// by index, which keeps their addresses from being reused within the block
+static PyObject *codeIndexes;
+static PyObject *codeObjects;
+// tupleKey() => index of the NEW_TUPLE event in the block that gave those
+// items, and the number of NEW_TUPLE events in the block
+static PyObject *tupleIndexes;
+static Py_ssize_t blockTupleCount;
+
+// REWIND_COMPRESS_* method of the log and the zlib level it uses
+static int compression;
+static int compressionLevel;
+
+typedef struct {
+    // starts with REWIND_BLOCK_HEADER_SIZE bytes for the writer thread to
+    // fill in the block header
+    unsigned char *data;
+    size_t length;
+    size_t size;
+    uint64_t firstEvent;
+    uint32_t minLine;
+    uint32_t maxLine;
+    uint32_t flags;
+} LogChunk;
+
+// Single producer, single consumer ring: the interpreter thread fills
+// logChunks[ringHead % LOG_CHUNKS] and then advances ringHead, the writer
+// thread writes out logChunks[ringTail % LOG_CHUNKS] and then advances
+// ringTail. Each side only ever stores its own index.
+static LogChunk logChunks[LOG_CHUNKS];
+static _Py_atomic_address ringHead;
+static _Py_atomic_address ringTail;
+static _Py_atomic_int writerStop;
+static _Py_atomic_int writerFailed;
+
+// Wakes up the one thread that waits on it, when it has something to do.
+// The thread only blocks on event after it said so in waiting, under
+// mutex, and event is released for it only then, so it is only ever
+// released locked.
+typedef struct {
+    PyThread_type_lock mutex;
+    // held but while the waiting thread is being woken up
+    PyThread_type_lock event;
+    int waiting;
+} Wakeup;
+
+// the writer thread waits on it for a chunk to be published, or to stop
+static Wakeup chunkPublished;
+// the interpreter thread waits on it for a chunk to be written out, when
+// the ring is full
+static Wakeup chunkWritten;
+// held for as long as the writer thread runs
+static PyThread_type_lock writerRunning;
+
+// Flight recorder mode keeps the last flightBlocks blocks in memory instead
+// of handing them to the writer thread, and writes them out only when
+// Rewind_Dump is called: on uncaught exceptions, fatal errors, SIGUSR2 or
+// from _rewind.dump(). A checkpoint is taken at least every flightBlocks / 2
+// blocks, so there is always one in the window to replay it from.
+static size_t flightBlocks;
+static LogChunk *flightChunks;
+// set by the signal handler, the dump itself waits for the next instruction
+static volatile sig_atomic_t dumpRequested;
+#ifdef SIGUSR2
+// The SIGUSR2 handler that requestDump replaced, called from it and put
+// back when the recording stops. A handler the program sets later with
+// signal.signal() replaces requestDump in turn, and SIGUSR2 no longer
+// dumps the log.
+static PyOS_sighandler_t savedDumpHandler;
+static int dumpHandlerSet;
+#endif
+
+// the chunk being filled, cached here for the encoding functions
+static unsigned char *logBuffer;
+static size_t logBufferLength;
+static size_t logBufferSize;
+// heap ids are written as the difference to one of the last two written,
+// which keeps ids short when events alternate between objects on the heap
+// and statically allocated ones such as types
+static uintptr_t lastHeapIds[2];
+static int lastVisitLine;
+// events written so far, not counting LOG events
+static uint64_t eventCount;
+// Id of the thread state the events written last came from, 0 for none.
+// Events of all threads go into the one log, in the order the GIL lets
+// them run, with a THREAD event wherever the thread changes.
+static uint64_t logThread;
+// what goes into the header of the block being filled
+static uint64_t blockFirstEvent;
+static uint32_t blockMinLine;
+static uint32_t blockMaxLine;
+static uint32_t blockFlags;
+// blocks finished so far
+static uint64_t blockCount;
+
+// Checkpoints are taken every checkpointEvents events and every
+// checkpointInterval, whichever comes first; 0 turns either off.
+static uint64_t checkpointEvents;
+static _PyTime_t checkpointInterval;
+// logOp looks no closer than this at whether a checkpoint is due
+static uint64_t nextCheckpointCheck;
+static uint64_t lastCheckpointEvent;
+static _PyTime_t lastCheckpointTime;
+static uint64_t lastCheckpointBlock;
+// the clock is read at most once every so many events
+#define CHECKPOINT_CLOCK_EVENTS 4096
+// set while a checkpoint is written, its events are not counted
+static char inCheckpoint;
+// Objects first tracked by a checkpoint. Readers that skip checkpoints
+// never see them, so they are forgotten again once it is written, and
+// whatever refers to them next writes them out anew.
+static PyObject **checkpointTracked;
+static size_t checkpointTrackedCount;
+static size_t checkpointTrackedSize;
+
+// Fork checkpoints are copies of the process, forked at checkpoints of the
+// log and frozen there, which a debugger can run forward to any later event
+// in milliseconds rather than replay the log from the start; see
+// forkCheckpoint. At most forkPoolSize of them are kept: when there is no
+// room for another, every other one goes, and from then on only every
+// forkEvery-th checkpoint is forked, so the pool spans the whole run.
+typedef struct {
+    uint64_t event;
+    char *fifo;
+} ForkCheckpoint;
+static size_t forkPoolSize;
+static ForkCheckpoint *forkPool;
+static size_t forkPoolCount;
+static uint64_t forkEvery;
+static uint64_t checkpointsTaken;
+// In a process run forward from a fork checkpoint, the event to stop at
+static uint64_t seekTarget;
+// checkpoints taken with the fork option and no interval of its own
+#define FORK_CHECKPOINT_EVENTS 1000000
+// a frozen process that isn't asked to seek for this long exits
+#define FORK_IDLE_MS (3600 * 1000)
+
+// Objects made known and waiting to be written. Tracking an object goes
+// through what it refers to with this worklist rather than recursion, and
+// writes at most TRACK_EAGER_OBJECTS objects. The rest stay unknown until
+// traced code stores, passes or changes them, which writes them as they
+// are then, so a large structure handed to traced code only costs the
+// part of it that is used.
+#define TRACK_EAGER_OBJECTS 1024
+static PyObject **trackQueue;
+static size_t trackQueueCount;
+static size_t trackQueueSize;
+static size_t trackBudget;
+
+// Lists, dicts and sets known to the log that were changed without it, see
+// Rewind_ContainerChanging, with new references to the items each held at
+// the time, which is what the log still gives it: those of a list in
+// order, the keys and values of a dict in turn, sorted by key, and those of
+// a set sorted and followed by NULL, as setItems gives them.
+typedef struct {
+    PyObject *container;    // borrowed, Rewind_Dealloc drops the entry
+    PyObject **items;
+    Py_ssize_t count;
+} ChangedContainer;
+static ChangedContainer *changedContainers;
+static size_t changedCount;
+static size_t changedSize;
+
+static void writeContainerChanges(void);
+
+// Have the log catch up with changedContainers, before an event that could
+// depend on what they hold.
+static inline void catchUpContainers(void) {
+    if (changedCount > 0) {
+        writeContainerChanges();
+    }
+}
+
+static void releaseChangedContainers(ChangedContainer *changed, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (Py_ssize_t j = 0; j < changed[i].count; j++) {
+            Py_DECREF(changed[i].items[j]);
+        }
+        PyMem_RawFree(changed[i].items);
+    }
+    PyMem_RawFree(changed);
+}
+
+// Drop obj from changedContainers, once what it held no longer matters:
+// it is being freed, and an object that takes its address is written anew,
+// or the log is given what it holds now.
+static void dropChangedContainer(PyObject *obj) {
+    for (size_t i = 0; i < changedCount; i++) {
+        if (changedContainers[i].container == obj) {
+            ChangedContainer changed = changedContainers[i];
+            // the items may be freed in turn, which looks through
+            // changedContainers again
+            changedContainers[i] = changedContainers[--changedCount];
+            for (Py_ssize_t j = 0; j < changed.count; j++) {
+                Py_DECREF(changed.items[j]);
+            }
+            PyMem_RawFree(changed.items);
+            return;
+        }
+    }
+}
+
+// Filter on which code is recorded, see parseOptions. Frames of code that
+// isn't get no PUSH_FRAME, POP_FRAME, VISIT, STORE_FAST, RETURN_VALUE or
+// YIELD_VALUE events; what they do to the heap is still logged, so that
+// recorded code sees it right. That includes the names and globals they
+// store, which readers take with no call of theirs on the stack.
+typedef struct {
+    char *pattern;      // UTF-8
+    char include;       // include or exclude
+    char byFile;        // matched against co_filename, not module.co_name
+} CodeFilter;
+
+static CodeFilter *codeFilters;
+static int codeFilterCount;
+static int codeIncludeCount;
+// Whether a code object is recorded is worked out the first time it runs
+// and kept in its co_extra slot at this index, as recordingNumber shifted
+// left by one bit, with the low bit set if it is recorded. Numbering each
+// recording keeps the filters of one from applying to the next.
+static Py_ssize_t codeExtraIndex = -1;
+static uintptr_t recordingNumber;
+// The code last asked about and whether it is recorded, which saves going
+// to co_extra on every instruction.
+static PyCodeObject *currentCode;
+static char currentCodeRecorded;
+
+// Sampling of hot code, see parseOptions. Code gets the policy of the
+// first sample option whose pattern it matches, or else of the one without
+// a pattern; code that gets none is recorded in full.
+typedef struct {
+    char *pattern;      // UTF-8, NULL for any code
+    char byFile;        // matched against co_filename, not module.co_name
+    uint64_t first;     // calls and iterations recorded in full
+    uint64_t every;     // then one in every so many, 0 for none
+} SamplePolicy;
+
+static SamplePolicy *samplePolicies;
+static int samplePolicyCount;
+
+// The policy of a code object and its calls and loop iterations so far,
+// kept in its co_extra slot at sampleExtraIndex from the first time it is
+// called in a recording, and set up anew when recordingNumber changes.
+typedef struct {
+    uintptr_t recording;
+    uint64_t first;
+    uint64_t every;
+    uint64_t calls;
+    uint64_t iterations;
+} CodeSampling;
+
+static Py_ssize_t sampleExtraIndex = -1;
+// for code whose co_extra can't be set, which is recorded in full
+static CodeSampling unsampledCode = {0, UINT64_MAX, 0, 0, 0};
+
+// Set by the inputs option: log what the program takes from outside rather
+// than what it does, see Rewind_InputMode. Nothing runs in
+// _PyEval_EvalFrameRewind then, and rewindActive stays off.
+static char inputsOption;
+// Set by the replay option: the log of inputs to feed the program.
+static PyObject *replayPath;
+int Rewind_InputMode = 0;
+
+// When replaying, what each REWIND_INPUT_* source gave, in the order it
+// gave it, and the next one to hand out. Once a source runs out, or gives
+// something the program doesn't expect, its values are dropped, and from
+// there on the program takes that input live.
+typedef struct {
+    PyObject **values;
+    size_t count;
+    size_t size;
+    size_t next;
+    char replaying;
+} InputQueue;
+
+static InputQueue replayInputs[REWIND_INPUT_SOURCES];
+
+// The frames with a PUSH_FRAME in the log and no POP_FRAME yet, innermost
+// last, with the threads running them, which is what a checkpoint gives.
+// Frames entered before recording started are left out: they run in
+// _PyEval_EvalFrameDefault, which logs nothing about them. While paused,
+// frames are still pushed and popped here, for Rewind_Resume, and after
+// recording stops, the ones still running are popped as they return, for a
+// recording that starts while they run.
+//
+// With sampling, a call left out of the log is kept here too, with elided
+// set, as are the calls made under it, which count towards its
+// elidedCalls. A frame leaving the iterations of a loop out of the log has
+// the bytecode offsets the loop spans, its variables as they were when it
+// started to, and what it has left out so far; loopEnd is -1 otherwise.
+typedef struct {
+    PyFrameObject *frame;
+    uint64_t thread;
+    char elided;
+    uint64_t elidedCalls;
+    int loopStart;
+    int loopEnd;
+    PyObject **loopLocals;
+    uint64_t loopIterations;
+    uint64_t loopCalls;
+} RecordedFrame;
+
+static RecordedFrame *recordedFrames;
+static size_t recordedFrameCount;
+static size_t recordedFramesSize;
+
+// Set of the addresses of objects that have been written to the log with a
+// NEW_* event. Rewind_Dealloc removes objects from it as they are freed, so it
+// is an open addressing table of raw pointers that never allocates on
+// lookup or removal and never calls back into the object allocator.
+#define KNOWN_OBJECTS_MIN_SIZE 1024
+#define KNOWN_EMPTY ((uintptr_t)0)
+// objects are at least pointer aligned, so no object lives at address 1
+#define KNOWN_DELETED ((uintptr_t)1)
+// and the bit above is free to mark the entry of a container that is in
+// changedContainers
+#define KNOWN_CHANGED ((uintptr_t)2)
+
+static uintptr_t *knownObjects;
+// capacity of knownObjects, always a power of 2
+static size_t knownObjectsSize;
+static size_t knownObjectsCount;
+// slots holding either an object or KNOWN_DELETED
+static size_t knownObjectsUsed;
+
+unsigned char *Rewind_TrackedFilter;
+
+static inline size_t knownObjectSlot(uintptr_t key) {
+    // the low bits of an address are mostly alignment, fold the high ones in
+    return (size_t)((key >> 4) * 0x9E3779B97F4A7C15ULL >> 16) & (knownObjectsSize - 1);
+}
+
+static void knownObjectsResize(size_t size) {
+    uintptr_t *old = knownObjects;
+    size_t oldSize = knownObjectsSize;
+    knownObjects = PyMem_RawCalloc(size, sizeof(uintptr_t));
+    if (knownObjects == NULL) {
+        Py_FatalError("rewind: out of memory for the object table");
+    }
+    knownObjectsSize = size;
+    knownObjectsUsed = knownObjectsCount;
+    for (size_t i = 0; i < oldSize; i++) {
+        uintptr_t key = old[i];
+        if (key != KNOWN_EMPTY && key != KNOWN_DELETED) {
+            // which KNOWN_CHANGED leaves alone
+            size_t slot = knownObjectSlot(key);
+            while (knownObjects[slot] != KNOWN_EMPTY) {
+                slot = (slot + 1) & (size - 1);
+            }
+            knownObjects[slot] = key;
+        }
+    }
+    PyMem_RawFree(old);
+}
+
+// Adds obj to the known objects, returns 0 if it was already there.
+static int knownObjectsAdd(PyObject *obj) {
+    uintptr_t key = (uintptr_t)obj;
+    size_t mask = knownObjectsSize - 1;
+    size_t slot = knownObjectSlot(key);
+    size_t deleted = knownObjectsSize;
+    uintptr_t current;
+    while ((current = knownObjects[slot]) != KNOWN_EMPTY) {
+        if ((current & ~KNOWN_CHANGED) == key) {
+            return 0;
+        }
+        if (current == KNOWN_DELETED && deleted == knownObjectsSize) {
+            deleted = slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    knownObjectsCount++;
+    // counters that overflow stay at the maximum, which only costs some
+    // needless lookups in Rewind_Dealloc
+    unsigned char *count = &Rewind_TrackedFilter[Rewind_TrackedFilterSlot(obj)];
+    if (*count != UCHAR_MAX) {
+        (*count)++;
+    }
+    if (deleted != knownObjectsSize) {
+        knownObjects[deleted] = key;
+        return 1;
+    }
+    knownObjects[slot] = key;
+    knownObjectsUsed++;
+    // keep the load factor, counting tombstones, under 3/4
+    if (knownObjectsUsed * 4 > knownObjectsSize * 3) {
+        size_t size = knownObjectsSize;
+        if (knownObjectsCount * 2 > size) {
+            size *= 2;
+        }
+        knownObjectsResize(size);
+    }
+    return 1;
+}
+
+// The entry of obj in knownObjects, or NULL if it isn't known.
+static uintptr_t *knownObjectEntry(PyObject *obj) {
+    uintptr_t key = (uintptr_t)obj;
+    size_t mask = knownObjectsSize - 1;
+    size_t slot = knownObjectSlot(key);
+    uintptr_t current;
+    while ((current = knownObjects[slot]) != KNOWN_EMPTY) {
+        if ((current & ~KNOWN_CHANGED) == key) {
+            return &knownObjects[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return NULL;
+}
+
+static int knownObjectsContains(PyObject *obj) {
+    return knownObjectEntry(obj) != NULL;
+}
+
+// Removes obj from the known objects, returns its entry, or 0 if it wasn't
+// there.
+static uintptr_t knownObjectsRemove(PyObject *obj) {
+    uintptr_t *entry = knownObjectEntry(obj);
+    if (entry == NULL) {
+        return 0;
+    }
+    uintptr_t removed = *entry;
+    *entry = KNOWN_DELETED;
+    knownObjectsCount--;
+    unsigned char *count = &Rewind_TrackedFilter[Rewind_TrackedFilterSlot(obj)];
+    if (*count != UCHAR_MAX) {
+        (*count)--;
+    }
+    return removed;
+}
+
+// Drop obj from changedContainers if it is there, see dropChangedContainer.
+static void forgetChangedContainer(PyObject *obj) {
+    uintptr_t *entry = knownObjectEntry(obj);
+    if (entry != NULL && (*entry & KNOWN_CHANGED)) {
+        *entry &= ~KNOWN_CHANGED;
+        dropChangedContainer(obj);
+    }
+}
+
+static inline void putUint32(unsigned char *p, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static inline void putUint64(unsigned char *p, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+static inline uint32_t getUint32(const unsigned char *p) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+static void putBlockHeader(unsigned char *p, LogChunk *chunk, size_t storedSize) {
+    putUint32(p, (uint32_t)storedSize);
+    putUint32(p + 4, (uint32_t)(chunk->length - REWIND_BLOCK_HEADER_SIZE));
+    putUint64(p + 8, chunk->firstEvent);
+    putUint32(p + 16, chunk->minLine);
+    putUint32(p + 20, chunk->maxLine);
+    putUint32(p + 24, chunk->flags);
+}
+
+#ifdef HAVE_LIBZ
+// only touched by the writer thread, or by Rewind_Dump in flight recorder
+// mode, which has none
+static unsigned char *compressBuffer;
+static size_t compressBufferSize;
+
+// Compress a chunk into compressBuffer as a whole block, header included,
+// and return its size, or 0 on failure.
+static size_t compressChunk(LogChunk *chunk) {
+    uLong dataLength = chunk->length - REWIND_BLOCK_HEADER_SIZE;
+    size_t size = REWIND_BLOCK_HEADER_SIZE + compressBound(dataLength);
+    if (size > compressBufferSize) {
+        unsigned char *buffer = PyMem_RawRealloc(compressBuffer, size);
+        if (buffer == NULL) {
+            return 0;
+        }
+        compressBuffer = buffer;
+        compressBufferSize = size;
+    }
+    uLongf storedSize = compressBufferSize - REWIND_BLOCK_HEADER_SIZE;
+    if (compress2(compressBuffer + REWIND_BLOCK_HEADER_SIZE, &storedSize,
+                  chunk->data + REWIND_BLOCK_HEADER_SIZE, dataLength,
+                  compressionLevel) != Z_OK) {
+        return 0;
+    }
+    putBlockHeader(compressBuffer, chunk, storedSize);
+    return REWIND_BLOCK_HEADER_SIZE + storedSize;
+}
+#endif
+
+static int writeChunk(LogChunk *chunk) {
+    const unsigned char *block = chunk->data;
+    size_t size = chunk->length;
+#ifdef HAVE_LIBZ
+    if (compression == REWIND_COMPRESS_ZLIB) {
+        size = compressChunk(chunk);
+        if (size == 0) {
+            fprintf(stderr, "rewind: failed to compress log\n");
+            return 0;
+        }
+        block = compressBuffer;
+    } else
+#endif
+    {
+        putBlockHeader(chunk->data, chunk, size - REWIND_BLOCK_HEADER_SIZE);
+    }
+    if (fwrite(block, 1, size, rewindLog) != size) {
+        fprintf(stderr, "rewind: failed to write log: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+static void allocateWakeup(Wakeup *wakeup) {
+    wakeup->mutex = PyThread_allocate_lock();
+    wakeup->event = PyThread_allocate_lock();
+    if (wakeup->mutex == NULL || wakeup->event == NULL) {
+        Py_FatalError("rewind: failed to allocate the log writer locks");
+    }
+    PyThread_acquire_lock(wakeup->event, WAIT_LOCK);
+    wakeup->waiting = 0;
+}
+
+static void freeWakeup(Wakeup *wakeup) {
+    PyThread_free_lock(wakeup->mutex);
+    PyThread_free_lock(wakeup->event);
+    wakeup->mutex = wakeup->event = NULL;
+}
+
+// Block until wakeUp is called, unless ready() says there is something to
+// do already. The other thread must change what ready() looks at before
+// it calls wakeUp.
+static void waitForWakeup(Wakeup *wakeup, int (*ready)(void)) {
+    PyThread_acquire_lock(wakeup->mutex, WAIT_LOCK);
+    if (ready()) {
+        PyThread_release_lock(wakeup->mutex);
+        return;
+    }
+    wakeup->waiting = 1;
+    PyThread_release_lock(wakeup->mutex);
+    PyThread_acquire_lock(wakeup->event, WAIT_LOCK);
+}
+
+static void wakeUp(Wakeup *wakeup) {
+    PyThread_acquire_lock(wakeup->mutex, WAIT_LOCK);
+    if (wakeup->waiting) {
+        wakeup->waiting = 0;
+        PyThread_release_lock(wakeup->event);
+    }
+    PyThread_release_lock(wakeup->mutex);
+}
+
+static int chunkToWrite(void) {
+    return _Py_atomic_load(&ringTail) != _Py_atomic_load(&ringHead) ||
+           _Py_atomic_load(&writerStop);
+}
+
+static int chunkToFill(void) {
+    return _Py_atomic_load(&ringHead) - _Py_atomic_load(&ringTail) < LOG_CHUNKS;
+}
+
+static void logWriter(void *unused) {
+    for (;;) {
+        uintptr_t tail = _Py_atomic_load_relaxed(&ringTail);
+        if (tail == _Py_atomic_load(&ringHead)) {
+            // ringHead is published before writerStop, so seeing the stop
+            // request and still no new chunk means there are none left
+            if (_Py_atomic_load(&writerStop) && tail == _Py_atomic_load(&ringHead)) {
+                break;
+            }
+            waitForWakeup(&chunkPublished, chunkToWrite);
+            continue;
+        }
+        LogChunk *chunk = &logChunks[tail % LOG_CHUNKS];
+        if (!_Py_atomic_load_relaxed(&writerFailed) && !writeChunk(chunk)) {
+            // keep draining so that the interpreter thread never blocks
+            _Py_atomic_store(&writerFailed, 1);
+        }
+        _Py_atomic_store(&ringTail, tail + 1);
+        wakeUp(&chunkWritten);
+    }
+#ifdef HAVE_LIBZ
+    PyMem_RawFree(compressBuffer);
+    compressBuffer = NULL;
+    compressBufferSize = 0;
+#endif
+    PyThread_release_lock(writerRunning);
+}
+
+// Everything a block needs to be decoded on its own starts afresh.
+static void startBlock(void) {
+    logBufferLength = REWIND_BLOCK_HEADER_SIZE;
+    blockFirstEvent = eventCount;
+    blockMinLine = UINT32_MAX;
+    blockMaxLine = 0;
+    blockFlags = 0;
+    lastHeapIds[0] = lastHeapIds[1] = 0;
+    lastVisitLine = 0;
+    // give the thread the block starts in, without a VISIT of the line it is
+    // on already
+    logThread = 0;
+    PyDict_Clear(symbols);
+    PyDict_Clear(codeIndexes);
+    PyList_SetSlice(codeObjects, 0, PY_SSIZE_T_MAX, NULL);
+    PyDict_Clear(tupleIndexes);
+    blockTupleCount = 0;
+}
+
+// Store the block being filled in chunk.
+static void finishChunk(LogChunk *chunk) {
+    chunk->data = logBuffer;
+    chunk->size = logBufferSize;
+    chunk->length = logBufferLength;
+    chunk->firstEvent = blockFirstEvent;
+    if (blockMinLine > blockMaxLine) {
+        chunk->minLine = chunk->maxLine = 0;
+    } else {
+        chunk->minLine = blockMinLine;
+        chunk->maxLine = blockMaxLine;
+    }
+    chunk->flags = blockFlags;
+    blockCount++;
+}
+
+// Hand the chunk being filled to the writer thread.
+static void publishChunk(void) {
+    uintptr_t head = _Py_atomic_load_relaxed(&ringHead);
+    finishChunk(&logChunks[head % LOG_CHUNKS]);
+    _Py_atomic_store(&ringHead, head + 1);
+    wakeUp(&chunkPublished);
+    if (_Py_atomic_load_relaxed(&writerFailed)) {
+        rewindActive = 0;
+    }
+}
+
+// In flight recorder mode, put the chunk being filled in place of the
+// oldest one kept, whose buffer is filled next.
+static void keepFlightChunk(void) {
+    LogChunk *chunk = &flightChunks[blockCount % flightBlocks];
+    unsigned char *data = chunk->data;
+    size_t size = chunk->size;
+    finishChunk(chunk);
+    // buffers grown by checkpoints are not kept around for good
+    if (data != NULL && size > LOG_CHUNK_SIZE) {
+        PyMem_RawFree(data);
+        data = NULL;
+    }
+    if (data == NULL) {
+        data = PyMem_RawMalloc(LOG_CHUNK_SIZE);
+        if (data == NULL) {
+            Py_FatalError("rewind: out of memory for the log buffer");
+        }
+        size = LOG_CHUNK_SIZE;
+    }
+    logBuffer = data;
+    logBufferSize = size;
+    if (blockCount - lastCheckpointBlock >= flightBlocks / 2) {
+        nextCheckpointCheck = 0;
+    }
+}
+
+// Publish the chunk being filled and start a new block in the next one,
+// waiting for the writer thread to free it if the ring is full.
+static void flushLog(void) {
+    if (flightBlocks != 0) {
+        keepFlightChunk();
+        startBlock();
+        return;
+    }
+    publishChunk();
+    uintptr_t head = _Py_atomic_load_relaxed(&ringHead);
+    while (!chunkToFill()) {
+        waitForWakeup(&chunkWritten, chunkToFill);
+    }
+    LogChunk *chunk = &logChunks[head % LOG_CHUNKS];
+    if (chunk->data == NULL) {
+        chunk->data = PyMem_RawMalloc(LOG_CHUNK_SIZE);
+        if (chunk->data == NULL) {
+            Py_FatalError("rewind: out of memory for the log buffer");
+        }
+        chunk->size = LOG_CHUNK_SIZE;
+    }
+    logBuffer = chunk->data;
+    logBufferSize = chunk->size;
+    startBlock();
+}
+
+// Publish what is left in the log and wait up to timeout microseconds
+// (-1 for no limit) for the writer thread to write it all out and exit.
+static int stopLogWriter(PY_TIMEOUT_T timeout) {
+    if (logBufferLength > REWIND_BLOCK_HEADER_SIZE) {
+        publishChunk();
+    }
+    _Py_atomic_store(&writerStop, 1);
+    wakeUp(&chunkPublished);
+    return PyThread_acquire_lock_timed(writerRunning, timeout, 0) == PY_LOCK_ACQUIRED;
+}
+
+// Set up the locks of the writer thread and an empty ring, whose first chunk
+// must be the one being filled.
+static void resetLogWriter(void) {
+    allocateWakeup(&chunkPublished);
+    allocateWakeup(&chunkWritten);
+    writerRunning = PyThread_allocate_lock();
+    if (writerRunning == NULL) {
+        Py_FatalError("rewind: failed to allocate the log writer locks");
+    }
+    _Py_atomic_store_relaxed(&ringHead, 0);
+    _Py_atomic_store_relaxed(&ringTail, 0);
+    _Py_atomic_store_relaxed(&writerStop, 0);
+    _Py_atomic_store_relaxed(&writerFailed, 0);
+}
+
+static void startLogWriter(void) {
+    PyThread_acquire_lock(writerRunning, WAIT_LOCK);
+    if (PyThread_start_new_thread(logWriter, NULL) == PYTHREAD_INVALID_THREAD_ID) {
+        Py_FatalError("rewind: failed to start the log writer thread");
+    }
+}
+
+// Make room for n more bytes in the log buffer and return where they go.
+// Events never straddle blocks, so this grows the chunk if need be.
+static unsigned char *reserveLog(size_t n) {
+    if (logBufferLength + n > logBufferSize) {
+        size_t size = Py_MAX(2 * logBufferSize, logBufferLength + n);
+        unsigned char *buffer = PyMem_RawRealloc(logBuffer, size);
+        if (buffer == NULL) {
+            Py_FatalError("rewind: out of memory for the log buffer");
+        }
+        logBuffer = buffer;
+        logBufferSize = size;
+    }
+    return logBuffer + logBufferLength;
+}
+
+static inline void writeByte(unsigned char byte) {
+    *reserveLog(1) = byte;
+    logBufferLength++;
+}
+
+// Id of the thread state running, 0 while none is (as objects of a thread
+// state being cleared are freed)
+static inline uint64_t currentThread(void) {
+    PyThreadState *tstate = _PyThreadState_GET();
+    return tstate != NULL ? tstate->id : 0;
+}
+
+static void writeThread(uint64_t thread);
+
+// Start the next block if the one being filled is full, which beginEvent
+// does first.
+static inline void cutBlock(void) {
+    if (logBufferLength >= LOG_BLOCK_SIZE && !inCheckpoint) {
+        flushLog();
+    }
+}
+
+// Every event starts with this, blocks are only ever cut between events,
+// and never inside a checkpoint, which gives the threads of its frames
+// itself.
+static inline void beginEvent(unsigned char opcode) {
+    cutBlock();
+    if (!inCheckpoint) {
+        uint64_t thread = currentThread();
+        if (thread != logThread) {
+            writeThread(thread);
+        }
+    }
+    if (opcode != REWIND_LOG && !inCheckpoint) {
+        eventCount++;
+    }
+    writeByte(opcode);
+}
+
+static inline void writeVarint(uint64_t value) {
+    unsigned char *p = reserveLog(10);
+    unsigned char *start = p;
+    while (value >= 0x80) {
+        *p++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (unsigned char)value;
+    logBufferLength += p - start;
+}
+
+static inline void writeSignedVarint(int64_t value) {
+    writeVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+// The events from here on come from thread. If another thread was on a line
+// meanwhile, its first instruction VISITs its line.
+static void writeThread(uint64_t thread) {
+    logThread = thread;
+    if (thread != lineThread) {
+        lastLine = -1;
+        lineFrame = NULL;
+    }
+    beginEvent(REWIND_THREAD);
+    writeVarint(thread);
+}
+
+static inline void writeHeapId(void *obj) {
+    uintptr_t id = (uintptr_t)obj;
+    int64_t delta0 = (int64_t)(id - lastHeapIds[0]);
+    int64_t delta1 = (int64_t)(id - lastHeapIds[1]);
+    int base = (delta1 < 0 ? -delta1 : delta1) < (delta0 < 0 ? -delta0 : delta0);
+    int64_t delta = base ? delta1 : delta0;
+    writeVarint((((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) << 1 | base);
+    lastHeapIds[base] = id;
+}
+
+static void writeBytes(const char *data, size_t length) {
+    writeVarint(length);
+    memcpy(reserveLog(length), data, length);
+    logBufferLength += length;
+}
+
+static void writeString(PyObject *str) {
+    Py_ssize_t length;
+    const char *data = PyUnicode_AsUTF8AndSize(str, &length);
+    if (data != NULL) {
+        writeBytes(data, length);
+        return;
+    }
+
+    // lone surrogates can't go through the cached UTF-8 representation
+    PyErr_Clear();
+    PyObject *bytes = PyUnicode_AsEncodedString(str, "utf-8", "surrogatepass");
+    if (bytes == NULL) {
+        PyErr_Clear();
+        writeBytes("", 0);
+        return;
+    }
+    writeBytes(PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes));
+    Py_DECREF(bytes);
+}
+
+// A symbol field is 0 followed by the text for a new symbol, or the index
+// of a known symbol plus 1.
+static void writeSymbol(PyObject *str) {
+    PyObject *index = PyDict_GetItemWithError(symbols, str);
+    if (index != NULL) {
+        writeVarint(PyLong_AsSize_t(index) + 1);
+        return;
+    }
+    index = PyLong_FromSsize_t(PyDict_GET_SIZE(symbols));
+    if (index == NULL || PyDict_SetItem(symbols, str, index) < 0) {
+        PyErr_Clear();
+    }
+    Py_XDECREF(index);
+    writeVarint(0);
+    writeString(str);
+}
+
+static int optionIs(const wchar_t *option, size_t length, const wchar_t *name) {
+    return wcslen(name) == length && wcsncmp(option, name, length) == 0;
+}
+
+// Parse the value of a name=count option, which ends at end; warns about
+// and returns 0 for anything but a positive integer.
+static uint64_t optionCount(const wchar_t *option, size_t length,
+                            const wchar_t *value, const wchar_t *end) {
+    wchar_t *parsed = NULL;
+    unsigned long long count = 0;
+    if (value != NULL && value < end) {
+        count = wcstoull(value, &parsed, 10);
+    }
+    if (count == 0 || parsed != end) {
+        fprintf(stderr, "rewind: option %.*ls needs a positive integer value\n",
+                (int)length, option);
+        return 0;
+    }
+    return count;
+}
+
+// Copy the pattern of an option, from value up to end, as UTF-8; warns
+// about and returns NULL for a missing or invalid one.
+static char *optionPattern(const wchar_t *option, size_t length,
+                           const wchar_t *value, const wchar_t *end) {
+    if (value == NULL || value == end) {
+        fprintf(stderr, "rewind: option %.*ls needs a pattern\n", (int)length, option);
+        return NULL;
+    }
+    PyObject *str = PyUnicode_FromWideChar(value, end - value);
+    Py_ssize_t size;
+    const char *utf8 = str != NULL ? PyUnicode_AsUTF8AndSize(str, &size) : NULL;
+    if (utf8 == NULL) {
+        PyErr_Clear();
+        Py_XDECREF(str);
+        fprintf(stderr, "rewind: invalid pattern for option %.*ls\n", (int)length, option);
+        return NULL;
+    }
+    char *pattern = PyMem_RawMalloc(size + 1);
+    if (pattern == NULL) {
+        Py_FatalError("rewind: out of memory for a pattern");
+    }
+    memcpy(pattern, utf8, size + 1);
+    Py_DECREF(str);
+    return pattern;
+}
+
+// Whether pattern is matched against file names, see parseOptions.
+static char patternByFile(const char *pattern) {
+    size_t size = strlen(pattern);
+    return strchr(pattern, '/') != NULL || strchr(pattern, '\\') != NULL ||
+        (size >= 3 && strcmp(pattern + size - 3, ".py") == 0);
+}
+
+static void addCodeFilter(const wchar_t *option, size_t length,
+                          const wchar_t *value, const wchar_t *end, char include) {
+    char *pattern = optionPattern(option, length, value, end);
+    if (pattern == NULL) {
+        return;
+    }
+    CodeFilter *filters = PyMem_RawRealloc(codeFilters, (codeFilterCount + 1) * sizeof(CodeFilter));
+    if (filters == NULL) {
+        Py_FatalError("rewind: out of memory for the code filters");
+    }
+    codeFilters = filters;
+    CodeFilter *filter = &codeFilters[codeFilterCount++];
+    filter->pattern = pattern;
+    filter->include = include;
+    filter->byFile = patternByFile(pattern);
+    codeIncludeCount += include;
+}
+
+// Parse the value of a sample option, [pattern=]first[/every].
+static void addSamplePolicy(const wchar_t *option, size_t length,
+                            const wchar_t *value, const wchar_t *end) {
+    if (value == NULL || value == end) {
+        fprintf(stderr, "rewind: option %.*ls needs a count\n", (int)length, option);
+        return;
+    }
+    // patterns may hold an =, counts don't
+    const wchar_t *counts = end;
+    while (counts > value && counts[-1] != L'=') {
+        counts--;
+    }
+    char *pattern = NULL;
+    if (counts > value) {
+        pattern = optionPattern(option, length, value, counts - 1);
+        if (pattern == NULL) {
+            return;
+        }
+    }
+    const wchar_t *slash = wmemchr(counts, L'/', end - counts);
+    uint64_t first = optionCount(option, length, counts, slash != NULL ? slash : end);
+    uint64_t every = slash != NULL ? optionCount(option, length, slash + 1, end) : 0;
+    if (first == 0 || (slash != NULL && every == 0)) {
+        PyMem_RawFree(pattern);
+        return;
+    }
+    SamplePolicy *policies = PyMem_RawRealloc(samplePolicies,
+                                              (samplePolicyCount + 1) * sizeof(SamplePolicy));
+    if (policies == NULL) {
+        Py_FatalError("rewind: out of memory for the sampling policies");
+    }
+    samplePolicies = policies;
+    SamplePolicy *policy = &samplePolicies[samplePolicyCount++];
+    policy->pattern = pattern;
+    policy->byFile = pattern != NULL && patternByFile(pattern);
+    policy->first = first;
+    policy->every = every;
+}
+
+// Forget the include, exclude and sample options, back to recording all
+// code in full.
+static void clearCodeOptions(void) {
+    for (int i = 0; i < codeFilterCount; i++) {
+        PyMem_RawFree(codeFilters[i].pattern);
+    }
+    PyMem_RawFree(codeFilters);
+    codeFilters = NULL;
+    codeFilterCount = 0;
+    codeIncludeCount = 0;
+    for (int i = 0; i < samplePolicyCount; i++) {
+        PyMem_RawFree(samplePolicies[i].pattern);
+    }
+    PyMem_RawFree(samplePolicies);
+    samplePolicies = NULL;
+    samplePolicyCount = 0;
+}
+
+// Options are a comma separated list of name or name=value:
+//   compress[=level]  compress the log with zlib, at the given level (1-9);
+//                     the default favours speed, higher levels barely help
+//   checkpoint=n      take a checkpoint every n events
+//   checkpoint_ms=t   take a checkpoint every t milliseconds
+//   flight[=mb]       flight recorder mode, keeping the last mb megabytes of
+//                     the log (16 by default) until Rewind_Dump writes them;
+//                     SIGUSR2 dumps them too, unless the program handles
+//                     SIGUSR2 itself with signal.signal()
+//   include=pattern   only record the code that matches one of the include
+//   exclude=pattern   patterns, if any, and none of the exclude patterns
+//   sample=[pattern=]n[/k]
+//                     record the first n calls of each code object, and
+//                     the first n iterations of its loops, then one in
+//                     every k, or none without k; the others are summed up
+//                     in ELIDED events, see Include/rewindlog.h. Code gets
+//                     the first of these options whose pattern it matches,
+//                     or else the one without a pattern, if any
+//   inputs            only log the inputs of the program: clocks, random
+//                     seeds, reads of files and sockets, argv and the
+//                     environment, at a small fraction of the cost
+//   replay=path       feed the program the inputs from the log at path,
+//                     written with the inputs option, while recording it
+//   fork[=n]          keep up to n (8 by default) fork checkpoints, taken at
+//                     checkpoints of the log, every million events unless
+//                     checkpoint says otherwise; flight and checkpoint_ms
+//                     don't go with it
+// Patterns are globs, with * for any run of characters and ? for any one.
+// Those with a slash or ending in .py are matched against the whole file
+// name of the code, such as */app/*, the others against module.function,
+// such as app.models.* or *.<module>; functions go by their plain name.
+static void parseOptions(const wchar_t *options) {
+    compression = REWIND_COMPRESS_NONE;
+    checkpointEvents = 0;
+    checkpointInterval = 0;
+    flightBlocks = 0;
+    inputsOption = 0;
+    Py_CLEAR(replayPath);
+    forkPoolSize = 0;
+    clearCodeOptions();
+    if (options == NULL) {
+        return;
+    }
+    const wchar_t *option = options;
+    while (*option) {
+        const wchar_t *end = wcschr(option, L',');
+        if (end == NULL) {
+            end = option + wcslen(option);
+        }
+        const wchar_t *value = wmemchr(option, L'=', end - option);
+        size_t length = (value != NULL ? value : end) - option;
+        if (value != NULL) {
+            value++;
+        }
+
+        if (optionIs(option, length, L"compress")) {
+#ifdef HAVE_LIBZ
+            compression = REWIND_COMPRESS_ZLIB;
+            compressionLevel = Z_BEST_SPEED;
+            if (value != NULL) {
+                compressionLevel = (int)wcstol(value, NULL, 10);
+                if (compressionLevel < 1 || compressionLevel > 9) {
+                    fprintf(stderr, "rewind: invalid compression level %ls\n", value);
+                    compressionLevel = Z_BEST_SPEED;
+                }
+            }
+#else
+            fprintf(stderr, "rewind: built without zlib, the log won't be compressed\n");
+#endif
+        } else if (optionIs(option, length, L"checkpoint")) {
+            checkpointEvents = optionCount(option, length, value, end);
+        } else if (optionIs(option, length, L"checkpoint_ms")) {
+            // _PyTime_t counts nanoseconds
+            checkpointInterval = (_PyTime_t)optionCount(option, length, value, end) * 1000 * 1000;
+        } else if (optionIs(option, length, L"flight")) {
+            uint64_t megabytes = value != NULL ? optionCount(option, length, value, end) : 16;
+            if (megabytes != 0) {
+                flightBlocks = Py_MAX(megabytes * 1024 * 1024 / LOG_BLOCK_SIZE, 2);
+            }
+        } else if (optionIs(option, length, L"include")) {
+            addCodeFilter(option, length, value, end, 1);
+        } else if (optionIs(option, length, L"exclude")) {
+            addCodeFilter(option, length, value, end, 0);
+        } else if (optionIs(option, length, L"sample")) {
+            addSamplePolicy(option, length, value, end);
+        } else if (optionIs(option, length, L"inputs")) {
+            inputsOption = 1;
+        } else if (optionIs(option, length, L"replay")) {
+            if (value == NULL || value == end) {
+                fprintf(stderr, "rewind: option replay needs the path of a log\n");
+            } else {
+                Py_XSETREF(replayPath, PyUnicode_FromWideChar(value, end - value));
+                if (replayPath == NULL) {
+                    PyErr_Clear();
+                }
+            }
+        } else if (optionIs(option, length, L"fork")) {
+#ifdef REWIND_FORK_CHECKPOINTS
+            forkPoolSize = value != NULL ? optionCount(option, length, value, end) : 8;
+            // a pool of one would keep its first checkpoint and no other
+            if (forkPoolSize == 1) {
+                forkPoolSize = 2;
+            }
+#else
+            fprintf(stderr, "rewind: fork checkpoints aren't supported on this platform\n");
+#endif
+        } else if (length > 0) {
+            fprintf(stderr, "rewind: unknown option %.*ls\n", (int)length, option);
+        }
+        option = *end ? end + 1 : end;
+    }
+}
+
+// Match text against a glob pattern, see parseOptions.
+static int globMatch(const char *pattern, const char *text) {
+    // where to pick up after the last * if the rest doesn't match
+    const char *star = NULL;
+    const char *starText = NULL;
+    while (*text) {
+        if (*pattern == '*') {
+            star = ++pattern;
+            starText = text;
+        } else if (*pattern == '?' || *pattern == *text) {
+            if (*pattern++ == '?') {
+                // one character, not one byte
+                while (((unsigned char)text[1] & 0xc0) == 0x80) {
+                    text++;
+                }
+            }
+            text++;
+        } else if (star != NULL) {
+            pattern = star;
+            text = ++starText;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') {
+        pattern++;
+    }
+    return *pattern == '\0';
+}
+
+// The module.function name patterns match code against, as a new
+// reference, or NULL.
+static PyObject *codeQualifiedName(PyCodeObject *code, PyObject *globals) {
+    PyObject *module = globals != NULL ? PyDict_GetItemString(globals, "__name__") : NULL;
+    return module != NULL && PyUnicode_Check(module) ?
+        PyUnicode_FromFormat("%U.%U", module, code->co_name) :
+        (Py_INCREF(code->co_name), code->co_name);
+}
+
+static int codeMatchesFilters(PyCodeObject *code, PyObject *globals) {
+    const char *filename = PyUnicode_AsUTF8(code->co_filename);
+    PyObject *name = codeQualifiedName(code, globals);
+    const char *qualifiedName = name != NULL ? PyUnicode_AsUTF8(name) : NULL;
+    if (filename == NULL || qualifiedName == NULL) {
+        PyErr_Clear();
+    }
+    int included = codeIncludeCount == 0;
+    int excluded = 0;
+    for (int i = 0; i < codeFilterCount && !excluded; i++) {
+        CodeFilter *filter = &codeFilters[i];
+        const char *text = filter->byFile ? filename : qualifiedName;
+        if (text == NULL || (filter->include && included) ||
+                !globMatch(filter->pattern, text)) {
+            continue;
+        }
+        if (filter->include) {
+            included = 1;
+        } else {
+            excluded = 1;
+        }
+    }
+    Py_XDECREF(name);
+    return included && !excluded;
+}
+
+// Whether the code of frame is recorded.
+static int frameRecorded(PyFrameObject *frame) {
+    PyCodeObject *code = frame->f_code;
+    if (code == currentCode) {
+        return currentCodeRecorded;
+    }
+    // keep the code alive, lest another one takes its address
+    Py_INCREF(code);
+    Py_XSETREF(currentCode, code);
+    void *extra = NULL;
+    if (_PyCode_GetExtra((PyObject *)code, codeExtraIndex, &extra) < 0) {
+        PyErr_Clear();
+    }
+    if ((uintptr_t)extra >> 1 != recordingNumber) {
+        uintptr_t recorded = codeMatchesFilters(code, frame->f_globals);
+        extra = (void *)(recordingNumber << 1 | recorded);
+        if (_PyCode_SetExtra((PyObject *)code, codeExtraIndex, extra) < 0) {
+            PyErr_Clear();
+        }
+    }
+    currentCodeRecorded = (uintptr_t)extra & 1;
+    return currentCodeRecorded;
+}
+
+static void setSamplePolicy(CodeSampling *sampling, PyCodeObject *code, PyObject *globals) {
+    const char *filename = PyUnicode_AsUTF8(code->co_filename);
+    PyObject *name = codeQualifiedName(code, globals);
+    const char *qualifiedName = name != NULL ? PyUnicode_AsUTF8(name) : NULL;
+    if (filename == NULL || qualifiedName == NULL) {
+        PyErr_Clear();
+    }
+    SamplePolicy *policy = NULL;
+    for (int i = 0; i < samplePolicyCount; i++) {
+        SamplePolicy *candidate = &samplePolicies[i];
+        if (candidate->pattern == NULL) {
+            if (policy == NULL) {
+                policy = candidate;
+            }
+            continue;
+        }
+        const char *text = candidate->byFile ? filename : qualifiedName;
+        if (text != NULL && globMatch(candidate->pattern, text)) {
+            policy = candidate;
+            break;
+        }
+    }
+    Py_XDECREF(name);
+    sampling->first = policy != NULL ? policy->first : UINT64_MAX;
+    sampling->every = policy != NULL ? policy->every : 0;
+}
+
+// The sampling of the code of frame in this recording.
+static CodeSampling *codeSampling(PyFrameObject *frame) {
+    PyCodeObject *code = frame->f_code;
+    void *extra = NULL;
+    if (_PyCode_GetExtra((PyObject *)code, sampleExtraIndex, &extra) < 0) {
+        PyErr_Clear();
+    }
+    CodeSampling *sampling = extra;
+    if (sampling == NULL) {
+        sampling = PyMem_RawMalloc(sizeof(CodeSampling));
+        if (sampling == NULL) {
+            Py_FatalError("rewind: out of memory for sampling");
+        }
+        if (_PyCode_SetExtra((PyObject *)code, sampleExtraIndex, sampling) < 0) {
+            PyErr_Clear();
+            PyMem_RawFree(sampling);
+            return &unsampledCode;
+        }
+        sampling->recording = 0;
+    }
+    if (sampling->recording != recordingNumber) {
+        sampling->recording = recordingNumber;
+        setSamplePolicy(sampling, code, frame->f_globals);
+        sampling->calls = 0;
+        sampling->iterations = 0;
+    }
+    return sampling;
+}
+
+// Whether the count-th call or loop iteration of code is recorded.
+static int sampleTaken(CodeSampling *sampling, uint64_t count) {
+    return count <= sampling->first ||
+        (sampling->every != 0 && (count - sampling->first) % sampling->every == 0);
+}
+
+static void scheduleCheckpointCheck(void) {
+    nextCheckpointCheck = UINT64_MAX;
+    if (checkpointEvents != 0) {
+        nextCheckpointCheck = lastCheckpointEvent + checkpointEvents;
+    }
+    if (checkpointInterval != 0) {
+        nextCheckpointCheck = Py_MIN(nextCheckpointCheck, eventCount + CHECKPOINT_CLOCK_EVENTS);
+    }
+    if (seekTarget != 0) {
+        nextCheckpointCheck = Py_MIN(nextCheckpointCheck, seekTarget);
+    }
+    // the signal handler sets dumpRequested before nextCheckpointCheck,
+    // don't lose the request if it came in meanwhile
+    if (dumpRequested) {
+        nextCheckpointCheck = 0;
+    }
+}
+
+static void writeCheckpoint(uint32_t flags);
+
+// Run frames in _PyEval_EvalFrameRewind, or back in the default evaluator,
+// unless some other one was installed.
+static void setEvalFrame(int recording) {
+    PyInterpreterState *interp = PyInterpreterState_Get();
+    _PyFrameEvalFunction current = _PyInterpreterState_GetEvalFrameFunc(interp);
+    if (recording && current == _PyEval_EvalFrameDefault) {
+        _PyInterpreterState_SetEvalFrameFunc(interp, _PyEval_EvalFrameRewind);
+    } else if (!recording && current == _PyEval_EvalFrameRewind) {
+        _PyInterpreterState_SetEvalFrameFunc(interp, _PyEval_EvalFrameDefault);
+    }
+}
+
+static void requestDump(int signum) {
+    dumpRequested = 1;
+    nextCheckpointCheck = 0;
+#ifdef SIGUSR2
+    // such as the one of the signal module, if the program set one
+    if (savedDumpHandler != SIG_DFL && savedDumpHandler != SIG_IGN &&
+        savedDumpHandler != SIG_ERR) {
+        savedDumpHandler(signum);
+    }
+#endif
+}
+
+// Put the SIGUSR2 handler back as it was before the recording, unless the
+// program has set one of its own since.
+static void restoreDumpHandler(void) {
+#ifdef SIGUSR2
+    if (!dumpHandlerSet) return;
+    if (PyOS_getsig(SIGUSR2) == requestDump) {
+        PyOS_setsig(SIGUSR2, savedDumpHandler);
+    }
+    dumpHandlerSet = 0;
+#endif
+}
+
+static int writeLogHeader(void) {
+    unsigned char header[] = REWIND_LOG_MAGIC "\0\0";
+    header[4] = REWIND_LOG_VERSION;
+    header[5] = compression;
+    return fwrite(header, 1, 6, rewindLog) == 6;
+}
+
+// names of the REWIND_INPUT_* sources, for messages
+static const char *const inputNames[REWIND_INPUT_SOURCES] = {
+    [REWIND_INPUT_ARGV] = "sys.argv",
+    [REWIND_INPUT_ENVIRON] = "os.environ",
+    [REWIND_INPUT_HASH_SEED] = "hash seed",
+    [REWIND_INPUT_CLOCK] = "clock",
+    [REWIND_INPUT_URANDOM] = "os.urandom",
+    [REWIND_INPUT_RANDOM_SEED] = "random seed",
+    [REWIND_INPUT_READ] = "read",
+    [REWIND_INPUT_RECV] = "recv",
+};
+
+static void clearInputQueue(InputQueue *queue) {
+    for (size_t i = queue->next; i < queue->count; i++) {
+        Py_DECREF(queue->values[i]);
+    }
+    PyMem_RawFree(queue->values);
+    queue->values = NULL;
+    queue->count = queue->size = queue->next = 0;
+    queue->replaying = 0;
+}
+
+static void clearReplayInputs(void) {
+    for (int source = 0; source < REWIND_INPUT_SOURCES; source++) {
+        clearInputQueue(&replayInputs[source]);
+    }
+}
+
+// Takes a reference to value.
+static int appendInput(int source, PyObject *value) {
+    InputQueue *queue = &replayInputs[source];
+    if (queue->count == queue->size) {
+        size_t size = Py_MAX(2 * queue->size, 64);
+        PyObject **values = PyMem_RawRealloc(queue->values, size * sizeof(PyObject *));
+        if (values == NULL) {
+            Py_DECREF(value);
+            PyErr_NoMemory();
+            return -1;
+        }
+        queue->values = values;
+        queue->size = size;
+    }
+    queue->values[queue->count++] = value;
+    return 0;
+}
+
+// The next value source gave, a new reference, or NULL if there's none to
+// replay, or it isn't of type (if given), after which source goes live.
+static PyObject *takeInput(int source, PyTypeObject *type) {
+    InputQueue *queue = &replayInputs[source];
+    if (!queue->replaying) {
+        return NULL;
+    }
+    if (queue->next == queue->count) {
+        fprintf(stderr, "rewind: replay ran out of %s inputs, the program takes them live "
+                "from here on\n", inputNames[source]);
+        clearInputQueue(queue);
+        return NULL;
+    }
+    PyObject *value = queue->values[queue->next];
+    if (type != NULL && !Py_IS_TYPE(value, type)) {
+        fprintf(stderr, "rewind: replay diverged from the log at a %s input, the program "
+                "takes them live from here on\n", inputNames[source]);
+        clearInputQueue(queue);
+        return NULL;
+    }
+    queue->next++;
+    return value;
+}
+
+static inline void beginInput(int source) {
+    beginEvent(REWIND_INPUT);
+    writeVarint(source);
+}
+
+void Rewind_ClockInput(_PyTime_t *t) {
+    if (Rewind_InputMode == REWIND_INPUTS_REPLAY) {
+        PyObject *value = takeInput(REWIND_INPUT_CLOCK, &PyLong_Type);
+        if (value != NULL) {
+            *t = PyLong_AsLongLong(value);
+            Py_DECREF(value);
+        }
+        return;
+    }
+    beginInput(REWIND_INPUT_CLOCK);
+    writeByte(REWIND_VALUE_INT);
+    writeSignedVarint(*t);
+}
+
+// When replaying, fill buf with up to count bytes of what the next input
+// of source gave, and return how many, or if it failed, return -1 with
+// errno and an OSError set. Returns -2 if there's nothing to replay, for
+// the caller to get the input for real.
+Py_ssize_t Rewind_ReplayData(int source, void *buf, size_t count) {
+    if (Rewind_InputMode != REWIND_INPUTS_REPLAY) {
+        return -2;
+    }
+    PyObject *value = takeInput(source, NULL);
+    if (value == NULL) {
+        return -2;
+    }
+    if (PyLong_CheckExact(value)) {
+        int err = _PyLong_AsInt(value);
+        Py_DECREF(value);
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        errno = err;
+        return -1;
+    }
+    if (!PyBytes_CheckExact(value)) {
+        Py_DECREF(value);
+        fprintf(stderr, "rewind: replay diverged from the log at a %s input, the program "
+                "takes them live from here on\n", inputNames[source]);
+        clearInputQueue(&replayInputs[source]);
+        return -2;
+    }
+    Py_ssize_t n = PyBytes_GET_SIZE(value);
+    if ((size_t)n > count) {
+        fprintf(stderr, "rewind: replay diverged from the log at a %s input, cutting it "
+                "short\n", inputNames[source]);
+        n = count;
+    }
+    memcpy(buf, PyBytes_AS_STRING(value), n);
+    Py_DECREF(value);
+    return n;
+}
+
+// When logging inputs, log the n bytes in buf as the next input of source,
+// or the errno err if n is -1.
+void Rewind_LogData(int source, const void *buf, Py_ssize_t n, int err) {
+    if (Rewind_InputMode != REWIND_INPUTS_RECORD) {
+        return;
+    }
+    beginInput(source);
+    if (n < 0) {
+        writeByte(REWIND_VALUE_INT);
+        writeSignedVarint(err);
+    } else {
+        writeByte(REWIND_VALUE_BYTES);
+        writeBytes(buf, n);
+    }
+}
+
+Py_ssize_t Rewind_ReadInput(int fd, void *buf, size_t count) {
+    Py_ssize_t n = Rewind_ReplayData(REWIND_INPUT_READ, buf, count);
+    if (n != -2) {
+        return n;
+    }
+    n = _Py_read(fd, buf, count);
+    int err = errno;
+    // a signal handler that raised isn't replayed
+    if (n >= 0 || err != EINTR) {
+        Rewind_LogData(REWIND_INPUT_READ, buf, n, err);
+    }
+    errno = err;
+    return n;
+}
+
+// The strs in list, each encoded with the file system encoding and
+// followed by a NUL.
+static PyObject *encodeInputList(PyObject *list) {
+    Py_ssize_t count = PyList_GET_SIZE(list);
+    PyObject *items = PyList_New(count + 1);
+    if (items == NULL) {
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyObject *item = PyUnicode_EncodeFSDefault(PyList_GET_ITEM(list, i));
+        if (item == NULL) {
+            Py_DECREF(items);
+            return NULL;
+        }
+        PyList_SET_ITEM(items, i, item);
+    }
+    // with an empty item last, the join ends in a NUL too
+    PyList_SET_ITEM(items, count, PyBytes_FromStringAndSize(NULL, 0));
+    PyObject *separator = PyBytes_FromStringAndSize("", 1);
+    PyObject *data = NULL;
+    if (PyList_GET_ITEM(items, count) != NULL && separator != NULL) {
+        data = _PyBytes_Join(separator, items);
+    }
+    Py_XDECREF(separator);
+    Py_DECREF(items);
+    return data;
+}
+
+// The reverse of encodeInputList.
+static PyObject *decodeInputList(PyObject *data) {
+    PyObject *list = PyList_New(0);
+    if (list == NULL) {
+        return NULL;
+    }
+    const char *start = PyBytes_AS_STRING(data);
+    const char *end = start + PyBytes_GET_SIZE(data);
+    while (start < end) {
+        const char *nul = memchr(start, '\0', end - start);
+        if (nul == NULL) {
+            nul = end;
+        }
+        PyObject *item = PyUnicode_DecodeFSDefaultAndSize(start, nul - start);
+        if (item == NULL || PyList_Append(list, item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(list);
+            return NULL;
+        }
+        Py_DECREF(item);
+        start = nul + 1;
+    }
+    return list;
+}
+
+static PyObject *osEnviron(void) {
+    PyObject *os = PyImport_ImportModule("os");
+    if (os == NULL) {
+        return NULL;
+    }
+    PyObject *environ = PyObject_GetAttrString(os, "environ");
+    Py_DECREF(os);
+    return environ;
+}
+
+static void logBytesInput(int source, PyObject *data) {
+    beginInput(source);
+    writeByte(REWIND_VALUE_BYTES);
+    writeBytes(PyBytes_AS_STRING(data), PyBytes_GET_SIZE(data));
+}
+
+// What the program starts from: sys.argv, os.environ and the hash seed,
+// which decides the order of sets of strings.
+static void logStartInputs(void) {
+    PyObject *argv = PySys_GetObject("argv");
+    PyObject *data = argv != NULL && PyList_Check(argv) ? encodeInputList(argv) : NULL;
+    if (data != NULL) {
+        logBytesInput(REWIND_INPUT_ARGV, data);
+        Py_DECREF(data);
+    }
+    PyErr_Clear();
+
+    PyObject *environ = osEnviron();
+    PyObject *items = environ != NULL ? PyMapping_Items(environ) : NULL;
+    PyObject *entries = items != NULL ? PyList_New(PyList_GET_SIZE(items)) : NULL;
+    if (entries != NULL) {
+        for (Py_ssize_t i = 0; i < PyList_GET_SIZE(items); i++) {
+            PyObject *item = PyList_GET_ITEM(items, i);
+            PyObject *entry = PyUnicode_FromFormat("%S=%S", PyTuple_GET_ITEM(item, 0),
+                                                   PyTuple_GET_ITEM(item, 1));
+            if (entry == NULL) {
+                Py_CLEAR(entries);
+                break;
+            }
+            PyList_SET_ITEM(entries, i, entry);
+        }
+    }
+    data = entries != NULL ? encodeInputList(entries) : NULL;
+    if (data != NULL) {
+        logBytesInput(REWIND_INPUT_ENVIRON, data);
+        Py_DECREF(data);
+    } else {
+        fprintf(stderr, "rewind: failed to log os.environ, replays will take it live\n");
+    }
+    PyErr_Clear();
+    Py_XDECREF(environ);
+    Py_XDECREF(items);
+    Py_XDECREF(entries);
+
+    const PyConfig *config = _PyInterpreterState_GetConfig(_PyInterpreterState_GET());
+    beginInput(REWIND_INPUT_HASH_SEED);
+    if (config->use_hash_seed) {
+        writeByte(REWIND_VALUE_INT);
+        writeSignedVarint(config->hash_seed);
+    } else {
+        writeByte(REWIND_VALUE_NONE);
+    }
+}
+
+// Put sys.argv and os.environ back as the program started from them when
+// its inputs were logged. Returns 0, or -1 with an exception set.
+static int replayStartInputs(void) {
+    PyObject *data = takeInput(REWIND_INPUT_ARGV, &PyBytes_Type);
+    if (data != NULL) {
+        PyObject *argv = PySys_GetObject("argv");
+        PyObject *list = decodeInputList(data);
+        Py_DECREF(data);
+        if (list == NULL) {
+            return -1;
+        }
+        int result = argv != NULL && PyList_Check(argv) ?
+            PyList_SetSlice(argv, 0, PY_SSIZE_T_MAX, list) : PySys_SetObject("argv", list);
+        Py_DECREF(list);
+        if (result < 0) {
+            return -1;
+        }
+    }
+
+    data = takeInput(REWIND_INPUT_ENVIRON, &PyBytes_Type);
+    if (data != NULL) {
+        PyObject *entries = decodeInputList(data);
+        Py_DECREF(data);
+        PyObject *environ = entries != NULL ? osEnviron() : NULL;
+        PyObject *result = environ != NULL ? PyObject_CallMethod(environ, "clear", NULL) : NULL;
+        for (Py_ssize_t i = 0; result != NULL && i < PyList_GET_SIZE(entries); i++) {
+            PyObject *entry = PyList_GET_ITEM(entries, i);
+            // names only start with = on Windows, for the current directory
+            // of each drive
+            Py_ssize_t length = PyUnicode_GET_LENGTH(entry);
+            Py_ssize_t equals = PyUnicode_FindChar(entry, '=', 1, length, 1);
+            if (equals < 0) {
+                continue;
+            }
+            PyObject *name = PyUnicode_Substring(entry, 0, equals);
+            PyObject *value = PyUnicode_Substring(entry, equals + 1, length);
+            if (name == NULL || value == NULL || PyObject_SetItem(environ, name, value) < 0) {
+                Py_CLEAR(result);
+            }
+            Py_XDECREF(name);
+            Py_XDECREF(value);
+        }
+        Py_XDECREF(entries);
+        Py_XDECREF(environ);
+        if (result == NULL) {
+            return -1;
+        }
+        Py_DECREF(result);
+    }
+
+    PyObject *seed = takeInput(REWIND_INPUT_HASH_SEED, NULL);
+    if (seed != NULL) {
+        const PyConfig *config = _PyInterpreterState_GetConfig(_PyInterpreterState_GET());
+        if (seed == Py_None) {
+            fprintf(stderr, "rewind: the inputs were logged with a random hash seed, sets may "
+                    "come out in another order; log them with PYTHONHASHSEED set\n");
+        } else if (!config->use_hash_seed ||
+                   config->hash_seed != PyLong_AsUnsignedLong(seed)) {
+            fprintf(stderr, "rewind: the inputs were logged with PYTHONHASHSEED=%lu, replay "
+                    "with the same for sets to come out in the same order\n",
+                    PyLong_AsUnsignedLong(seed));
+        }
+        Py_DECREF(seed);
+    }
+    return 0;
+}
+
+static int readLogVarint(const unsigned char **p, const unsigned char *end, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; *p < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*p)++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Read the INPUT events in the data of a block into replayInputs.
+static int readInputEvents(const unsigned char *p, const unsigned char *end) {
+    while (p < end) {
+        unsigned char opcode = *p++;
+        uint64_t number;
+        if (opcode != REWIND_THREAD && opcode != REWIND_INPUT) {
+            PyErr_Format(PyExc_ValueError, "rewind: %R is not a log of inputs", replayPath);
+            return -1;
+        }
+        if (readLogVarint(&p, end, &number) < 0) {
+            goto truncated;
+        }
+        if (opcode == REWIND_THREAD) {
+            continue;
+        }
+        int source = (int)number;
+        if (number >= REWIND_INPUT_SOURCES || p == end) {
+            goto truncated;
+        }
+        PyObject *value;
+        unsigned char tag = *p++;
+        if (tag == REWIND_VALUE_NONE) {
+            value = Py_None;
+            Py_INCREF(value);
+        } else if (tag == REWIND_VALUE_INT) {
+            if (readLogVarint(&p, end, &number) < 0) {
+                goto truncated;
+            }
+            value = PyLong_FromLongLong((long long)((number >> 1) ^ -(number & 1)));
+        } else if (tag == REWIND_VALUE_BYTES) {
+            if (readLogVarint(&p, end, &number) < 0 || number > (uint64_t)(end - p)) {
+                goto truncated;
+            }
+            value = PyBytes_FromStringAndSize((const char *)p, (Py_ssize_t)number);
+            p += number;
+        } else {
+            goto truncated;
+        }
+        if (value == NULL || appendInput(source, value) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+truncated:
+    PyErr_Format(PyExc_ValueError, "rewind: corrupt log of inputs %R", replayPath);
+    return -1;
+}
+
+// Read the log of inputs at replayPath into replayInputs. Returns 0, or -1
+// with an exception set.
+static int loadReplayInputs(void) {
+    FILE *file = _Py_fopen_obj(replayPath, "rb");
+    if (file == NULL) {
+        return -1;
+    }
+    unsigned char *log = NULL;
+    size_t size = 0;
+    size_t capacity = 0;
+    int result = -1;
+    for (;;) {
+        if (size == capacity) {
+            capacity = Py_MAX(2 * capacity, LOG_CHUNK_SIZE);
+            unsigned char *grown = PyMem_RawRealloc(log, capacity);
+            if (grown == NULL) {
+                PyErr_NoMemory();
+                goto done;
+            }
+            log = grown;
+        }
+        size_t n = fread(log + size, 1, capacity - size, file);
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    if (ferror(file)) {
+        PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, replayPath);
+        goto done;
+    }
+    if (size < 6 || memcmp(log, REWIND_LOG_MAGIC, 4) != 0 || log[4] != REWIND_LOG_VERSION) {
+        PyErr_Format(PyExc_ValueError, "rewind: %R is not a log of this version", replayPath);
+        goto done;
+    }
+    int compressed = log[5] == REWIND_COMPRESS_ZLIB;
+    for (int source = 0; source < REWIND_INPUT_SOURCES; source++) {
+        replayInputs[source].replaying = 1;
+    }
+    // a last block cut short, as left by a crash, is ignored
+    size_t offset = 6;
+    while (offset + REWIND_BLOCK_HEADER_SIZE <= size) {
+        const unsigned char *header = log + offset;
+        size_t storedSize = getUint32(header);
+        size_t dataSize = getUint32(header + 4);
+        offset += REWIND_BLOCK_HEADER_SIZE;
+        if (storedSize > size - offset) {
+            break;
+        }
+        const unsigned char *data = log + offset;
+        offset += storedSize;
+        if (!compressed) {
+            if (readInputEvents(data, data + storedSize) < 0) {
+                goto done;
+            }
+            continue;
+        }
+#ifdef HAVE_LIBZ
+        unsigned char *block = PyMem_RawMalloc(Py_MAX(dataSize, 1));
+        uLongf length = (uLongf)dataSize;
+        if (block == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        if (uncompress(block, &length, data, (uLong)storedSize) != Z_OK) {
+            PyMem_RawFree(block);
+            PyErr_Format(PyExc_ValueError, "rewind: corrupt log of inputs %R", replayPath);
+            goto done;
+        }
+        int read = readInputEvents(block, block + length);
+        PyMem_RawFree(block);
+        if (read < 0) {
+            goto done;
+        }
+#else
+        PyErr_SetString(PyExc_ValueError, "rewind: built without zlib, can't read compressed logs");
+        goto done;
+#endif
+    }
+    result = 0;
+done:
+    if (result < 0) {
+        clearReplayInputs();
+    }
+    PyMem_RawFree(log);
+    fclose(file);
+    return result;
+}
 
-inline int equalstr(PyObject *obj, char *string) {
-    return PyObject_RichCompareBool(obj, PyUnicode_FromString(string), Py_EQ);
+// Whether options has the option name, which has no value.
+static int hasOption(const wchar_t *options, const wchar_t *name) {
+    for (const wchar_t *option = options; option != NULL && *option; ) {
+        const wchar_t *end = wcschr(option, L',');
+        if (end == NULL) {
+            end = option + wcslen(option);
+        }
+        if (optionIs(option, end - option, name)) {
+            return 1;
+        }
+        option = *end ? end + 1 : end;
+    }
+    return 0;
 }
 
-void Rewind_Activate(const wchar_t *filename) {
-    // Calculate the name of the rewind log file.
-    // Given something.py, will look like something.rewind.
+// Record the program running the script filename into a log named after
+// it: given something.py, something.rewind, or something.inputs.rewind for
+// a log of its inputs. With the options "off", leave recording to
+// _rewind.start() instead.
+void Rewind_Activate(const wchar_t *filename, const wchar_t *options) {
+    if (options != NULL && wcscmp(options, L"off") == 0) return;
+
     PyObject *filename_obj = PyUnicode_FromWideChar(filename, -1);
+    if (filename_obj == NULL) {
+        PyErr_Clear();
+        return;
+    }
     Py_ssize_t len = PyUnicode_GetLength(filename_obj);
-    PyObject *dot = PyUnicode_FromString(".");
-    Py_ssize_t idx = PyUnicode_Find(filename_obj, dot, 0, len, 0);
-    PyObject *prefix = PySequence_GetSlice(filename_obj, 0, idx);
-    PyObject *logFileName = PyUnicode_Concat(prefix, PyUnicode_FromString(".rewind"));
-    const char * logFileNameUTF8 = PyUnicode_AsUTF8(logFileName);
-    rewindLog = fopen(logFileNameUTF8, "w");
-    knownObjectIds = PySet_New(NULL);
+    Py_ssize_t idx = PyUnicode_FindChar(filename_obj, '.', 0, len, 1);
+    PyObject *prefix = PyUnicode_Substring(filename_obj, 0, idx >= 0 ? idx : len);
+    PyObject *logFileName = NULL;
+    if (prefix != NULL) {
+        logFileName = PyUnicode_FromFormat(hasOption(options, L"inputs") ? "%U.inputs.rewind"
+                                                                          : "%U.rewind", prefix);
+    }
+    if (logFileName == NULL || Rewind_Start(logFileName, options) < 0) {
+        // the program runs anyway, unrecorded
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch(&type, &value, &traceback);
+        PySys_FormatStderr("rewind: not recording: %S\n", value != NULL ? value : Py_None);
+        Py_XDECREF(type);
+        Py_XDECREF(value);
+        Py_XDECREF(traceback);
+    }
+    Py_DECREF(filename_obj);
+    Py_XDECREF(prefix);
+    Py_XDECREF(logFileName);
+}
+
+static void releaseForkPool(void);
+static void clearElidedLoop(RecordedFrame *recorded);
+
+// Undo what Rewind_Start did before it failed, down to the options it
+// parsed, so that none of them outlive it.
+static void abandonStart(void) {
+    clearReplayInputs();
+    Py_CLEAR(replayPath);
+    releaseForkPool();
+    clearCodeOptions();
+}
+
+// Start recording into the log file at path, see parseOptions for the
+// options. Returns 0 on success, or -1 with an exception set.
+int Rewind_Start(PyObject *path, const wchar_t *options) {
+    if (rewindLog != NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "rewind: already recording");
+        return -1;
+    }
+    // kept for the dump and the fork checkpoints, which open files after it
+    PyObject *pathBytes = PyUnicode_EncodeFSDefault(path);
+    if (pathBytes == NULL) {
+        return -1;
+    }
+    parseOptions(options);
+    if (inputsOption) {
+        if (replayPath != NULL) {
+            fprintf(stderr, "rewind: options inputs and replay don't go together, "
+                    "replaying\n");
+            inputsOption = 0;
+        } else if (flightBlocks != 0 || checkpointEvents != 0 || checkpointInterval != 0 ||
+                   codeFilterCount != 0 || samplePolicyCount != 0 || forkPoolSize != 0) {
+            // a replay needs all the inputs from the start
+            fprintf(stderr, "rewind: logging only inputs, options flight, checkpoint, "
+                    "include, exclude, sample and fork don't apply\n");
+            flightBlocks = 0;
+            checkpointEvents = 0;
+            checkpointInterval = 0;
+            forkPoolSize = 0;
+            clearCodeOptions();
+        }
+    }
+    // a recording starts a pool of its own
+    releaseForkPool();
+    if (forkPoolSize != 0) {
+        // A seek must number events as the log does, and each checkpoint
+        // logs the changes to containers made meanwhile there and then, so
+        // seeks take the checkpoints the recording took; by event count,
+        // as only that comes out the same when the program runs again.
+        if (flightBlocks != 0 || checkpointInterval != 0) {
+            fprintf(stderr, "rewind: with fork checkpoints, options flight and "
+                    "checkpoint_ms don't apply\n");
+            flightBlocks = 0;
+            checkpointInterval = 0;
+        }
+        if (checkpointEvents == 0) {
+            checkpointEvents = FORK_CHECKPOINT_EVENTS;
+        }
+        forkPool = PyMem_RawCalloc(forkPoolSize, sizeof(ForkCheckpoint));
+        if (forkPool == NULL) {
+            Py_FatalError("rewind: out of memory for the fork checkpoints");
+        }
+        forkEvery = 1;
+    }
+    // the log to replay may be the one about to be written
+    if (replayPath != NULL && (loadReplayInputs() < 0 || replayStartInputs() < 0)) {
+        abandonStart();
+        Py_DECREF(pathBytes);
+        return -1;
+    }
+    rewindLog = _Py_fopen_obj(path, "wb");
+    if (rewindLog == NULL) {
+        abandonStart();
+        Py_DECREF(pathBytes);
+        return -1;
+    }
+    // whole blocks are written at once, stdio buffering would only add a copy
+    setvbuf(rewindLog, NULL, _IONBF, 0);
+    writeLogHeader();
+    logPath = _PyMem_RawStrdup(PyBytes_AS_STRING(pathBytes));
+    Py_DECREF(pathBytes);
+    if (logPath == NULL) {
+        Py_FatalError("rewind: out of memory for the log file name");
+    }
+
+    resetLogWriter();
+
+    knownObjectsCount = 0;
+    knownObjectsResize(KNOWN_OBJECTS_MIN_SIZE);
+    Rewind_TrackedFilter = PyMem_RawCalloc(REWIND_TRACKED_FILTER_SIZE, 1);
+    if (Rewind_TrackedFilter == NULL) {
+        Py_FatalError("rewind: out of memory for the object table");
+    }
+    symbols = PyDict_New();
+    codeIndexes = PyDict_New();
+    codeObjects = PyList_New(0);
+    tupleIndexes = PyDict_New();
+
+    logBuffer = PyMem_RawMalloc(LOG_CHUNK_SIZE);
+    if (logBuffer == NULL) {
+        Py_FatalError("rewind: out of memory for the log buffer");
+    }
+    logBufferSize = LOG_CHUNK_SIZE;
+    if (flightBlocks == 0) {
+        logChunks[0].data = logBuffer;
+        logChunks[0].size = logBufferSize;
+    } else {
+        flightChunks = PyMem_RawCalloc(flightBlocks, sizeof(LogChunk));
+        if (flightChunks == NULL) {
+            Py_FatalError("rewind: out of memory for the flight recorder");
+        }
+    }
+    eventCount = 0;
+    blockCount = 0;
+    startBlock();
+    lastLine = -1;
+    lineFrame = NULL;
+    lineThread = 0;
+    lastCheckpointEvent = 0;
+    checkpointsTaken = 0;
+    lastCheckpointTime = _PyTime_GetMonotonicClock();
+    lastCheckpointBlock = 0;
+    dumpRequested = 0;
+    scheduleCheckpointCheck();
+    recordingNumber++;
+    if (codeFilterCount > 0 && codeExtraIndex < 0) {
+        codeExtraIndex = _PyEval_RequestCodeExtraIndex(NULL);
+        if (codeExtraIndex < 0) {
+            fprintf(stderr, "rewind: no code object extra slot left, recording all code\n");
+            codeFilterCount = 0;
+        }
+    }
+    if (samplePolicyCount > 0 && sampleExtraIndex < 0) {
+        sampleExtraIndex = _PyEval_RequestCodeExtraIndex(PyMem_RawFree);
+        if (sampleExtraIndex < 0) {
+            fprintf(stderr, "rewind: no code object extra slot left, recording all calls\n");
+            samplePolicyCount = 0;
+        }
+    }
+
+    if (flightBlocks == 0) {
+        startLogWriter();
+    } else {
+#ifdef SIGUSR2
+        savedDumpHandler = PyOS_setsig(SIGUSR2, requestDump);
+        dumpHandlerSet = 1;
+#endif
+    }
+    if (inputsOption) {
+        // what the program does follows from its inputs, the eval loop and
+        // the objects need not be followed at all
+        Rewind_InputMode = REWIND_INPUTS_RECORD;
+        logStartInputs();
+        return 0;
+    }
+    if (replayPath != NULL) {
+        Rewind_InputMode = REWIND_INPUTS_REPLAY;
+    }
     rewindActive = 1;
+    // frames still running from an earlier recording are followed again,
+    // in full
+    for (size_t i = 0; i < recordedFrameCount; i++) {
+        recordedFrames[i].elided = 0;
+        clearElidedLoop(&recordedFrames[i]);
+    }
+    // Started from running code, the log takes up the program in the
+    // middle, and readers take it up from the checkpoint.
+    if (recordedFrameCount > 0 || PyEval_GetFrame() != NULL) {
+        writeCheckpoint(REWIND_BLOCK_RESYNC);
+    }
+    setEvalFrame(1);
+    return 0;
+}
+
+// Free what a recording holds besides its log file and writer thread.
+static void freeRecording(void) {
+    if (flightBlocks == 0) {
+        for (int i = 0; i < LOG_CHUNKS; i++) {
+            PyMem_RawFree(logChunks[i].data);
+            logChunks[i].data = NULL;
+        }
+    } else {
+        for (size_t i = 0; i < flightBlocks; i++) {
+            PyMem_RawFree(flightChunks[i].data);
+        }
+        PyMem_RawFree(flightChunks);
+        flightChunks = NULL;
+        PyMem_RawFree(logBuffer);
+#ifdef HAVE_LIBZ
+        PyMem_RawFree(compressBuffer);
+        compressBuffer = NULL;
+        compressBufferSize = 0;
+#endif
+    }
+    restoreDumpHandler();
+    rewindLog = NULL;
+    PyMem_RawFree(logPath);
+    logPath = NULL;
+    logBuffer = NULL;
+    logBufferSize = 0;
+    unsigned char *filter = Rewind_TrackedFilter;
+    Rewind_TrackedFilter = NULL;
+    PyMem_RawFree(filter);
+    PyMem_RawFree(knownObjects);
+    knownObjects = NULL;
+    knownObjectsSize = 0;
+    knownObjectsCount = 0;
+    PyMem_RawFree(checkpointTracked);
+    checkpointTracked = NULL;
+    checkpointTrackedSize = 0;
+    PyMem_RawFree(trackQueue);
+    trackQueue = NULL;
+    trackQueueSize = 0;
+    releaseChangedContainers(changedContainers, changedCount);
+    changedContainers = NULL;
+    changedCount = changedSize = 0;
+    Py_CLEAR(symbols);
+    Py_CLEAR(codeIndexes);
+    Py_CLEAR(codeObjects);
+    Py_CLEAR(tupleIndexes);
+    Py_CLEAR(currentCode);
+    clearCodeOptions();
 }
 
 void Rewind_Deactivate() {
+    // recording may have stopped early on a write error, check the log
+    // itself so that the writer thread is still shut down
+    if (rewindLog == NULL) return;
+
+    if (rewindActive) {
+        catchUpContainers();
+    }
+    rewindActive = 0;
+    rewindPaused = 0;
+    Rewind_InputMode = 0;
+    clearReplayInputs();
+    setEvalFrame(0);
+    if (flightBlocks == 0) {
+        stopLogWriter(-1);
+    }
+    fclose(rewindLog);
+    freeWakeup(&chunkPublished);
+    freeWakeup(&chunkWritten);
+    PyThread_free_lock(writerRunning);
+    freeRecording();
+}
+
+// Called on fatal errors: get as much of the log to disk as possible, but
+// don't hang on a writer thread that may be stuck in the failing I/O.
+void Rewind_FatalError(void) {
+    if (rewindLog == NULL) return;
+
+    Rewind_InputMode = 0;
+    if (flightBlocks != 0) {
+        Rewind_Dump();
+        rewindActive = 0;
+        return;
+    }
     rewindActive = 0;
+    stopLogWriter(1000 * 1000);
+}
+
+// In flight recorder mode, write the blocks kept in memory out to the log,
+// replacing what an earlier dump wrote there. The log then starts from the
+// oldest block kept that has a checkpoint, or from the start of recording.
+// Returns 1 if the log was written, 0 if not recording in flight recorder
+// mode and -1 if writing failed.
+int Rewind_Dump(void) {
+    dumpRequested = 0;
+    if (rewindLog == NULL || flightBlocks == 0) return 0;
+
+    if (logBufferLength > REWIND_BLOCK_HEADER_SIZE && !inCheckpoint) {
+        flushLog();
+    }
+    uint64_t start = blockCount > flightBlocks ? blockCount - flightBlocks : 0;
+    while (start != 0 && start < blockCount &&
+           !(flightChunks[start % flightBlocks].flags & REWIND_BLOCK_CHECKPOINT)) {
+        start++;
+    }
+    if (start == blockCount && start != 0) {
+        fprintf(stderr, "rewind: no checkpoint in the flight recorder, nothing to dump\n");
+        return -1;
+    }
+    FILE *file = fopen(logPath, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "rewind: failed to open %s: %s\n", logPath, strerror(errno));
+        return -1;
+    }
     fclose(rewindLog);
+    rewindLog = file;
+    setvbuf(rewindLog, NULL, _IONBF, 0);
+    if (!writeLogHeader()) {
+        fprintf(stderr, "rewind: failed to write log: %s\n", strerror(errno));
+        return -1;
+    }
+    for (uint64_t i = start; i < blockCount; i++) {
+        LogChunk chunk = flightChunks[i % flightBlocks];
+        if (i == start && start != 0) {
+            // the blocks before aren't there, readers take the state of
+            // the program from the checkpoint instead
+            chunk.flags |= REWIND_BLOCK_RESYNC;
+        }
+        if (!writeChunk(&chunk)) {
+            return -1;
+        }
+    }
+    return 1;
+}
+
+// Stop logging events for now, keeping the log open. Objects that were
+// written to the log before are still followed, for Rewind_Resume to write
+// out where they stand then.
+void Rewind_Pause(void) {
+    if (!rewindActive) return;
+
+    catchUpContainers();
+    rewindActive = 0;
+    rewindPaused = 1;
+}
+
+// Log events again after Rewind_Pause, from a checkpoint giving the state of
+// the program, which readers replay as if it had been logged all along.
+void Rewind_Resume(void) {
+    if (!rewindPaused) return;
+
+    rewindPaused = 0;
+    rewindActive = 1;
+    writeCheckpoint(REWIND_BLOCK_RESYNC);
+    lastCheckpointEvent = eventCount;
+    lastCheckpointTime = _PyTime_GetMonotonicClock();
+    scheduleCheckpointCheck();
+}
+
+// Whether events, or the inputs of the program, are being logged.
+int Rewind_IsRecording(void) {
+    return rewindActive || Rewind_InputMode == REWIND_INPUTS_RECORD;
+}
+
+// In a forked child, drop the recording of the parent, leaving its log
+// file and writer thread alone, so that the child can start one of its own.
+// The frames recorded are kept, a recording of the child resyncs from them.
+static void forgetRecording(void) {
+    if (rewindLog == NULL) return;
+
+    rewindActive = 0;
+    rewindPaused = 0;
+    setEvalFrame(0);
+    // the writer thread, which didn't come along, may have held the locks
+    // and been using the log file
+    chunkPublished.mutex = chunkPublished.event = NULL;
+    chunkWritten.mutex = chunkWritten.event = NULL;
+    writerRunning = NULL;
+    freeRecording();
+}
+
+static void forgetForkPool(void);
+
+// The writer thread does not survive fork(), and the log belongs to the
+// parent anyway, so the child just stops recording.
+void Rewind_AfterForkChild(void) {
+    Rewind_InputMode = 0;
+    forgetForkPool();
+    forgetRecording();
 }
 
-void Rewind_PrintStringTuple(FILE *file, PyObject *stringTuple) {
+void Rewind_PrintStringTuple(PyObject *stringTuple) {
     Py_ssize_t length = PyTuple_GET_SIZE(stringTuple);
-    fprintf(file, ", %lu", length);
+    writeVarint(length);
     for (int i = 0; i < length; i++) {
-        PyObject *item = PyTuple_GET_ITEM(stringTuple, i);
-        fprintf(file, ", ");
-        PyObject_Print(item, file, 0);
+        writeSymbol(PyTuple_GET_ITEM(stringTuple, i));
+    }
+}
+
+// A code field is 0 followed by the names of a code object new in the
+// block, or the index of a known code object plus 1.
+static void writeCode(PyCodeObject *code) {
+    PyObject *key = PyLong_FromVoidPtr(code);
+    if (key == NULL) {
+        Py_FatalError("rewind: out of memory for the code table");
     }
+    PyObject *index = PyDict_GetItemWithError(codeIndexes, key);
+    if (index != NULL) {
+        Py_DECREF(key);
+        writeVarint(PyLong_AsSize_t(index) + 1);
+        return;
+    }
+    index = PyLong_FromSsize_t(PyList_GET_SIZE(codeObjects));
+    if (index == NULL || PyDict_SetItem(codeIndexes, key, index) < 0 ||
+        PyList_Append(codeObjects, (PyObject *)code) < 0) {
+        Py_FatalError("rewind: out of memory for the code table");
+    }
+    Py_DECREF(index);
+    Py_DECREF(key);
+    writeVarint(0);
+    writeSymbol(code->co_filename);
+    writeSymbol(code->co_name);
+    Rewind_PrintStringTuple(code->co_varnames);
+    Rewind_PrintStringTuple(code->co_cellvars);
+    Rewind_PrintStringTuple(code->co_freevars);
 }
 
 /*
 PUSH_FRAME(
-    filename, func_name, 
-    globals, 
-    num_local_vars, *local_varnames, 
-    num_cell_vars, *cell_varnames,
-    num_free_vars, *free_varnames,
+    code,
+    globals,
+    locals,
     *local_vars,
     *cell_vars,
     *free_vars
 )
 */
-void Rewind_PushFrame(PyFrameObject *frame) {
-    if (!rewindActive) return;
-
+static void writePushFrame(PyFrameObject *frame) {
     PyCodeObject *code = frame->f_code;
     // when constructor (__init__) is invoked, track the object being built
-    if (equalstr(code->co_name, "__init__")) {
+    if (_PyUnicode_EqualToASCIIString(code->co_name, "__init__")) {
         Rewind_TrackObject(*frame->f_localsplus);
     }
     PyObject **valuestack = frame->f_valuestack;
@@ -72,38 +2329,237 @@ void Rewind_PushFrame(PyFrameObject *frame) {
     }
 
     lastLine = -1;
-    fprintf(rewindLog, "PUSH_FRAME(");
-    PyObject_Print(code->co_filename, rewindLog, 0);
-    fprintf(rewindLog, ", ");
-    PyObject_Print(code->co_name, rewindLog, 0);
-    fprintf(rewindLog, ", %lu", (unsigned long)frame->f_globals);
-    fprintf(rewindLog, ", %lu", (unsigned long)frame->f_localsplus);
-    
-    Rewind_PrintStringTuple(rewindLog, code->co_varnames);
-    Rewind_PrintStringTuple(rewindLog, frame->f_code->co_cellvars);
-    Rewind_PrintStringTuple(rewindLog, frame->f_code->co_freevars);
-    
+    lineFrame = NULL;
+    beginEvent(REWIND_PUSH_FRAME);
+    writeCode(code);
+    writeHeapId(frame->f_globals);
+    writeHeapId(frame->f_localsplus);
+
     // serialize all arguments, cellvars, and freevars
+    writeVarint(valuestack - frame->f_localsplus);
     PyObject **p = frame->f_localsplus;
     while (p < valuestack) {
-        fprintf(rewindLog, ", ");
         PyObject *obj = *p;
-        Rewind_serializeObject(rewindLog, obj);
+        Rewind_serializeObject(obj);
         p++;
     }
-    fprintf(rewindLog, ")");
-    fprintf(rewindLog, "\n");
+}
+
+// The innermost frame of thread in recordedFrames, or NULL.
+static RecordedFrame *innermostFrame(uint64_t thread) {
+    for (size_t i = recordedFrameCount; i > 0; i--) {
+        if (recordedFrames[i - 1].thread == thread) {
+            return &recordedFrames[i - 1];
+        }
+    }
+    return NULL;
+}
+
+static void writeElided(PyCodeObject *code, uint64_t calls, uint64_t iterations) {
+    beginEvent(REWIND_ELIDED);
+    writeCode(code);
+    writeVarint(calls);
+    writeVarint(iterations);
+}
+
+// The offset of the last jump back to start in code, where the loop that
+// starts there ends.
+static int loopEnd(PyCodeObject *code, int start) {
+    const _Py_CODEUNIT *instructions = (const _Py_CODEUNIT *)PyBytes_AS_STRING(code->co_code);
+    Py_ssize_t count = PyBytes_GET_SIZE(code->co_code) / sizeof(_Py_CODEUNIT);
+    int end = start;
+    unsigned int oparg = 0;
+    for (Py_ssize_t i = start / sizeof(_Py_CODEUNIT); i < count; i++) {
+        int opcode = _Py_OPCODE(instructions[i]);
+        oparg |= _Py_OPARG(instructions[i]);
+        if (opcode == EXTENDED_ARG) {
+            oparg <<= 8;
+            continue;
+        }
+        if (oparg == (unsigned int)start &&
+                (opcode == JUMP_ABSOLUTE || opcode == POP_JUMP_IF_FALSE ||
+                 opcode == POP_JUMP_IF_TRUE || opcode == JUMP_IF_FALSE_OR_POP ||
+                 opcode == JUMP_IF_TRUE_OR_POP || opcode == JUMP_IF_NOT_EXC_MATCH)) {
+            end = (int)(i * sizeof(_Py_CODEUNIT));
+        }
+        oparg = 0;
+    }
+    return end;
+}
+
+// Start leaving the iterations of the loop that starts at start out of the
+// log, from the one its frame is about to run.
+static void startElidedLoop(RecordedFrame *recorded, int start) {
+    PyFrameObject *frame = recorded->frame;
+    int count = frame->f_code->co_nlocals;
+    recorded->loopLocals = PyMem_RawMalloc(Py_MAX(count, 1) * sizeof(PyObject *));
+    if (recorded->loopLocals == NULL) {
+        Py_FatalError("rewind: out of memory for sampling");
+    }
+    for (int i = 0; i < count; i++) {
+        recorded->loopLocals[i] = frame->f_localsplus[i];
+        Py_XINCREF(recorded->loopLocals[i]);
+    }
+    recorded->loopStart = start;
+    recorded->loopEnd = Py_MAX(loopEnd(frame->f_code, start), frame->f_lasti);
+    recorded->loopIterations = 1;
+    recorded->loopCalls = 0;
+}
+
+static void clearElidedLoop(RecordedFrame *recorded) {
+    if (recorded->loopEnd < 0) {
+        return;
+    }
+    int count = recorded->frame->f_code->co_nlocals;
+    for (int i = 0; i < count; i++) {
+        Py_XDECREF(recorded->loopLocals[i]);
+    }
+    PyMem_RawFree(recorded->loopLocals);
+    recorded->loopLocals = NULL;
+    recorded->loopEnd = -1;
+}
+
+// Stop leaving iterations out of the log: the variables they changed are
+// stored again, unless the frame is about to be popped, and the next
+// instruction VISITs its line.
+static void endElidedLoop(RecordedFrame *recorded, int popping) {
+    PyFrameObject *frame = recorded->frame;
+    int count = frame->f_code->co_nlocals;
+    for (int i = 0; i < count && !popping; i++) {
+        PyObject *value = frame->f_localsplus[i];
+        if (value != recorded->loopLocals[i]) {
+            Rewind_TrackObject(value);
+            beginEvent(REWIND_STORE_FAST);
+            writeVarint(i);
+            Rewind_serializeObject(value);
+        }
+    }
+    writeElided(frame->f_code, recorded->loopCalls, recorded->loopIterations);
+    clearElidedLoop(recorded);
+    lastLine = -1;
+    lineFrame = NULL;
+}
+
+// With sampling, the entry of frame in recordedFrames if it is the
+// innermost frame of its thread there and wasn't left out of the log, or
+// NULL.
+static RecordedFrame *sampledFrame(PyFrameObject *frame) {
+    RecordedFrame *recorded = innermostFrame(currentThread());
+    if (recorded == NULL || recorded->frame != frame || recorded->elided) {
+        return NULL;
+    }
+    return recorded;
+}
+
+// With sampling, whether the events of frame at f_lasti are logged. Past
+// the loop whose iterations it leaves out, or when it is leaving, that
+// comes to an end.
+static int frameLogged(PyFrameObject *frame, int leaving) {
+    RecordedFrame *recorded = sampledFrame(frame);
+    if (recorded == NULL) {
+        return 0;
+    }
+    if (recorded->loopEnd >= 0) {
+        if (!leaving && frame->f_lasti >= recorded->loopStart &&
+                frame->f_lasti <= recorded->loopEnd) {
+            return 0;
+        }
+        endElidedLoop(recorded, 0);
+    }
+    return 1;
+}
+
+// With sampling, whether the call that pushes frame is left out of the
+// log: when its caller's is, or the caller is leaving out the iteration it
+// runs, or it isn't one of the calls of its code that are recorded.
+static int callElided(PyFrameObject *frame, uint64_t thread) {
+    RecordedFrame *caller = innermostFrame(thread);
+    if (caller != NULL && caller->elided) {
+        return 1;
+    }
+    if (caller != NULL && caller->loopEnd >= 0) {
+        int lasti = caller->frame->f_lasti;
+        if (lasti >= caller->loopStart && lasti <= caller->loopEnd) {
+            return 1;
+        }
+        endElidedLoop(caller, 0);
+    }
+    CodeSampling *sampling = codeSampling(frame);
+    return !sampleTaken(sampling, ++sampling->calls);
+}
+
+void Rewind_PushFrame(PyFrameObject *frame) {
+    if (!rewindActive && !rewindPaused) return;
+    catchUpContainers();
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+
+    uint64_t thread = currentThread();
+    char elided = rewindActive && samplePolicyCount > 0 && callElided(frame, thread);
+    if (recordedFrameCount == recordedFramesSize) {
+        size_t size = Py_MAX(2 * recordedFramesSize, 64);
+        RecordedFrame *frames = PyMem_RawRealloc(recordedFrames, size * sizeof(RecordedFrame));
+        if (frames == NULL) {
+            Py_FatalError("rewind: out of memory for the frame stack");
+        }
+        recordedFrames = frames;
+        recordedFramesSize = size;
+    }
+    RecordedFrame *recorded = &recordedFrames[recordedFrameCount++];
+    recorded->frame = frame;
+    recorded->thread = thread;
+    recorded->elided = elided;
+    recorded->elidedCalls = 0;
+    recorded->loopEnd = -1;
+    recorded->loopLocals = NULL;
+    if (rewindActive && !elided) {
+        writePushFrame(frame);
+    }
+}
+
+// Take frame off recordedFrames into popped, returns 0 if it isn't there.
+static int popRecordedFrame(PyFrameObject *frame, RecordedFrame *popped) {
+    // it is the innermost one unless other threads ran code in between
+    for (size_t i = recordedFrameCount; i > 0; i--) {
+        if (recordedFrames[i - 1].frame == frame) {
+            *popped = recordedFrames[i - 1];
+            memmove(&recordedFrames[i - 1], &recordedFrames[i],
+                    (recordedFrameCount - i) * sizeof(RecordedFrame));
+            recordedFrameCount--;
+            return 1;
+        }
+    }
+    return 0;
 }
 
 void Rewind_PopFrame(PyFrameObject *frame) {
-    if (!rewindActive) return;
+    catchUpContainers();
+    RecordedFrame popped;
+    if (recordedFrameCount == 0 || !popRecordedFrame(frame, &popped)) return;
+    if (!rewindActive) {
+        clearElidedLoop(&popped);
+        return;
+    }
 
     PyCodeObject *code = frame->f_code;
-    fprintf(rewindLog, "POP_FRAME(");
-    PyObject_Print(code->co_filename, rewindLog, 0);
-    fprintf(rewindLog, ", ");
-    PyObject_Print(code->co_name, rewindLog, 0);
-    fprintf(rewindLog, ")\n");
+    if (popped.elided) {
+        // the calls left out are summed up where a logged frame made them
+        uint64_t calls = popped.elidedCalls + 1;
+        RecordedFrame *caller = innermostFrame(popped.thread);
+        if (caller != NULL && caller->elided) {
+            caller->elidedCalls += calls;
+        } else if (caller != NULL && caller->loopEnd >= 0) {
+            caller->loopCalls += calls;
+        } else {
+            writeElided(code, calls, 0);
+        }
+        return;
+    }
+    if (popped.loopEnd >= 0) {
+        endElidedLoop(&popped, 1);
+    }
+    beginEvent(REWIND_POP_FRAME);
+    writeSymbol(code->co_filename);
+    writeSymbol(code->co_name);
 }
 
 void Rewind_StoreDeref(PyObject *cell, PyObject *value) {
@@ -111,258 +2567,694 @@ void Rewind_StoreDeref(PyObject *cell, PyObject *value) {
 
     Rewind_TrackObject(cell);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "STORE_DEREF(%lu, ", (unsigned long)cell);
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_STORE_DEREF);
+    writeHeapId(cell);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_ListAppend(PyListObject *list, PyObject *value) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "LIST_APPEND(%lu, ", (unsigned long)list);
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_LIST_APPEND);
+    writeHeapId(list);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_ListInsert(PyListObject *list, Py_ssize_t index, PyObject *value) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "LIST_INSERT(%lu, %lu", (unsigned long)list, index);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_LIST_INSERT);
+    writeHeapId(list);
+    writeSignedVarint(index);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_ListExtend(PyListObject *list, PyObject *iterable) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     Rewind_TrackObject(iterable);
-    fprintf(rewindLog, "LIST_EXTEND(%lu, ", (unsigned long)list);
-    Rewind_serializeObject(rewindLog, iterable);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_LIST_EXTEND);
+    writeHeapId(list);
+    Rewind_serializeObject(iterable);
 }
 
 void Rewind_ListRemove(PyListObject *list, PyObject *item) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     Rewind_TrackObject(item);
-    fprintf(rewindLog, "LIST_REMOVE(%lu, ", (unsigned long)list);
-    Rewind_serializeObject(rewindLog, item);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_LIST_REMOVE);
+    writeHeapId(list);
+    Rewind_serializeObject(item);
 }
 
 void Rewind_ListPop(PyListObject *list, Py_ssize_t index) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
-    fprintf(rewindLog, "LIST_POP(%lu, %lu)\n", (unsigned long)list, index);
+    beginEvent(REWIND_LIST_POP);
+    writeHeapId(list);
+    writeSignedVarint(index);
 }
 
 void Rewind_ListClear(PyListObject *list) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
-    fprintf(rewindLog, "LIST_CLEAR(%lu)\n", (unsigned long)list);
+    beginEvent(REWIND_LIST_CLEAR);
+    writeHeapId(list);
 }
 
 void Rewind_ListReverse(PyListObject *list) {
     if (!rewindActive) return;
+    catchUpContainers();
+
+    Rewind_TrackObject((PyObject *)list);
+    beginEvent(REWIND_LIST_REVERSE);
+    writeHeapId(list);
+}
+
+// The items of a list about to be sorted, for Rewind_ListSort to log where
+// they went, or NULL if there is no need to.
+PyObject **Rewind_ListSortBegin(PyListObject *list) {
+    catchUpContainers();
+    Py_ssize_t n = Py_SIZE(list);
+    if (!rewindActive || n < 2 || !knownObjectsContains((PyObject *)list)) {
+        return NULL;
+    }
+    PyObject **items = PyMem_RawMalloc(n * sizeof(PyObject *));
+    if (items == NULL) {
+        Py_FatalError("rewind: out of memory for a sort");
+    }
+    memcpy(items, list->ob_item, n * sizeof(PyObject *));
+    return items;
+}
+
+static void writeListSort(PyListObject *list) {
+    for (int i = 0; i < Py_SIZE(list); ++i) {
+        Rewind_TrackObject(list->ob_item[i]);
+    }
+    beginEvent(REWIND_LIST_SORT);
+    writeHeapId(list);
+    writeVarint(Py_SIZE(list));
+    for (int i = 0; i < Py_SIZE(list); ++i) {
+        PyObject *item = list->ob_item[i];
+        Rewind_serializeObject(item);
+    }
+}
+
+typedef struct {
+    uintptr_t item;
+    Py_ssize_t index;
+} ItemIndex;
+
+static int compareItemIndexes(const void *a, const void *b) {
+    const ItemIndex *x = a, *y = b;
+    if (x->item != y->item) {
+        return x->item < y->item ? -1 : 1;
+    }
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+/*
+LIST_PERMUTE(list, *runs): the sorted list as runs of items that were next
+to each other before, each given as the index its first item had and its
+length; nothing is written if the sort left the list as it was
+*/
+static void writeListPermutation(PyListObject *list, PyObject **before) {
+    Py_ssize_t n = Py_SIZE(list);
+    ItemIndex *order = PyMem_RawMalloc(n * sizeof(ItemIndex));
+    // how many of the indexes of each item have been handed out, kept in
+    // the entry of its first index in order
+    Py_ssize_t *taken = PyMem_RawCalloc(n, sizeof(Py_ssize_t));
+    Py_ssize_t *from = PyMem_RawMalloc(n * sizeof(Py_ssize_t));
+    if (order == NULL || taken == NULL || from == NULL) {
+        Py_FatalError("rewind: out of memory for a sort");
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        order[i].item = (uintptr_t)before[i];
+        order[i].index = i;
+    }
+    qsort(order, n, sizeof(ItemIndex), compareItemIndexes);
+
+    Py_ssize_t runs = 0;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        uintptr_t item = (uintptr_t)list->ob_item[i];
+        Py_ssize_t low = 0, high = n;
+        while (low < high) {
+            Py_ssize_t middle = low + (high - low) / 2;
+            if (order[middle].item < item) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        // the same object can be in the list more than once, its indexes
+        // are handed out in order
+        Py_ssize_t entry = low < n ? low + taken[low]++ : n;
+        if (entry >= n || order[entry].item != item) {
+            // can't happen unless the items changed under the sort
+            writeListSort(list);
+            goto done;
+        }
+        from[i] = order[entry].index;
+        if (i == 0 || from[i] != from[i - 1] + 1) {
+            runs++;
+        }
+    }
 
-    Rewind_TrackObject((PyObject *)list);
-    fprintf(rewindLog, "LIST_REVERSE(%lu)\n", (unsigned long)list);
+    if (runs > 1) {
+        beginEvent(REWIND_LIST_PERMUTE);
+        writeHeapId(list);
+        writeVarint(2 * runs);
+        Py_ssize_t start = 0;
+        for (Py_ssize_t i = 1; i <= n; i++) {
+            if (i == n || from[i] != from[i - 1] + 1) {
+                writeVarint(from[start]);
+                writeVarint(i - start);
+                start = i;
+            }
+        }
+    }
+done:
+    PyMem_RawFree(order);
+    PyMem_RawFree(taken);
+    PyMem_RawFree(from);
 }
 
-void Rewind_ListSort(PyListObject *list) {
-    if (!rewindActive) return;
+// Log the effect of a sort as a permutation of the items the list had
+// before, which Rewind_ListSortBegin returned, or as its new contents if
+// the sort had to undo changes made to the list while it ran.
+void Rewind_ListSort(PyListObject *list, PyObject **before, int modified) {
+    if (!rewindActive) {
+        PyMem_RawFree(before);
+        return;
+    }
 
-    Rewind_TrackObject((PyObject *)list);
-    fprintf(rewindLog, "LIST_SORT(%lu", (unsigned long)list);
-    for (int i = 0; i < Py_SIZE(list); ++i) {
-        PyObject *item = list->ob_item[i];
-        fprintf(rewindLog, ", ");
-        Rewind_serializeObject(rewindLog, item);
+    if (!knownObjectsContains((PyObject *)list)) {
+        // NEW_LIST gives the sorted list
+        Rewind_TrackObject((PyObject *)list);
+    } else if (modified) {
+        writeListSort(list);
+    } else if (before != NULL) {
+        writeListPermutation(list, before);
     }
-    fprintf(rewindLog, ")\n");
+    PyMem_RawFree(before);
 }
 
 void Rewind_ListStoreSubscript(PyListObject *list, PyObject* key, PyObject* value) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     Rewind_TrackObject(value);
     if (Py_IS_TYPE(key, &PySlice_Type)) {
         PySliceObject *slice = (PySliceObject *)key;
-        fprintf(rewindLog, "LIST_STORE_SUBSCRIPT_SLICE(%lu, ", (unsigned long)list);
-        PyObject_Print(slice->start, rewindLog, 0);
-        fprintf(rewindLog, ", ");
-        PyObject_Print(slice->stop, rewindLog, 0);
-        fprintf(rewindLog, ", ");
-        PyObject_Print(slice->step, rewindLog, 0);
-        fprintf(rewindLog, ", ");
-        Rewind_serializeObject(rewindLog, value);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_LIST_STORE_SUBSCRIPT_SLICE);
+        writeHeapId(list);
+        Rewind_serializeObject(slice->start);
+        Rewind_serializeObject(slice->stop);
+        Rewind_serializeObject(slice->step);
+        Rewind_serializeObject(value);
     } else {
-        fprintf(rewindLog, "LIST_STORE_SUBSCRIPT(%lu, ", (unsigned long)list);
-        Rewind_serializeObject(rewindLog, key);
-        fprintf(rewindLog, ", ");
-        Rewind_serializeObject(rewindLog, value);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_LIST_STORE_SUBSCRIPT);
+        writeHeapId(list);
+        Rewind_serializeObject(key);
+        Rewind_serializeObject(value);
     }
 }
 
 void Rewind_ListDeleteSubscript(PyListObject *list, PyObject *key) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)list);
     if (Py_IS_TYPE(key, &PySlice_Type)) {
         PySliceObject *slice = (PySliceObject *)key;
-        fprintf(rewindLog, "LIST_DELETE_SUBSCRIPT_SLICE(%lu, ", (unsigned long)list);
-        PyObject_Print(slice->start, rewindLog, 0);
-        fprintf(rewindLog, ", ");
-        PyObject_Print(slice->stop, rewindLog, 0);
-        fprintf(rewindLog, ", ");
-        PyObject_Print(slice->step, rewindLog, 0);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_LIST_DELETE_SUBSCRIPT_SLICE);
+        writeHeapId(list);
+        Rewind_serializeObject(slice->start);
+        Rewind_serializeObject(slice->stop);
+        Rewind_serializeObject(slice->step);
     } else {
-        fprintf(rewindLog, "LIST_DELETE_SUBSCRIPT(%lu, ", (unsigned long)list);
-        Rewind_serializeObject(rewindLog, key);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_LIST_DELETE_SUBSCRIPT);
+        writeHeapId(list);
+        Rewind_serializeObject(key);
     }
 }
 
 void Rewind_DictStoreSubscript(PyDictObject *dict, PyObject *key, PyObject *value) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(key);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "DICT_STORE_SUBSCRIPT(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, key);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_STORE_SUBSCRIPT);
+    writeHeapId(dict);
+    Rewind_serializeObject(key);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_DictDeleteSubscript(PyDictObject *dict, PyObject *item) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(item);
-    fprintf(rewindLog, "DICT_DELETE_SUBSCRIPT(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, item);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_DELETE_SUBSCRIPT);
+    writeHeapId(dict);
+    Rewind_serializeObject(item);
 }
 
 void Rewind_DictUpdate(PyDictObject *dict, PyObject *otherDict) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(otherDict);
-    fprintf(rewindLog, "DICT_UPDATE(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, otherDict);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_UPDATE);
+    writeHeapId(dict);
+    Rewind_serializeObject(otherDict);
 }
 
 void Rewind_DictClear(PyDictObject *dict) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
-    fprintf(rewindLog, "DICT_CLEAR(%lu)\n", (unsigned long)dict);
+    beginEvent(REWIND_DICT_CLEAR);
+    writeHeapId(dict);
 }
 
 void Rewind_DictPop(PyDictObject *dict, PyObject *key) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(key);
-    fprintf(rewindLog, "DICT_POP(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, key);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_POP);
+    writeHeapId(dict);
+    Rewind_serializeObject(key);
 }
 
 void Rewind_DictPopItem(PyDictObject *dict, PyObject *key) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(key);
-    fprintf(rewindLog, "DICT_POP_ITEM(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, key);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_POP_ITEM);
+    writeHeapId(dict);
+    Rewind_serializeObject(key);
 }
 
 void Rewind_DictSetDefault(PyDictObject *dict, PyObject *key, PyObject *value) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)dict);
     Rewind_TrackObject(key);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "DICT_SET_DEFAULT(%lu, ", (unsigned long)dict);
-    Rewind_serializeObject(rewindLog, key);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DICT_SET_DEFAULT);
+    writeHeapId(dict);
+    Rewind_serializeObject(key);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_SetAdd(PySetObject *set, PyObject *newItem) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)set);
     Rewind_TrackObject(newItem);
-    fprintf(rewindLog, "SET_ADD(%lu, ", (unsigned long)set);
-    Rewind_serializeObject(rewindLog, newItem);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_SET_ADD);
+    writeHeapId(set);
+    Rewind_serializeObject(newItem);
 }
 
 void Rewind_SetDiscard(PySetObject *set, PyObject *item) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)set);
     Rewind_TrackObject(item);
-    fprintf(rewindLog, "SET_DISCARD(%lu, ", (unsigned long)set);
-    Rewind_serializeObject(rewindLog, item);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_SET_DISCARD);
+    writeHeapId(set);
+    Rewind_serializeObject(item);
 }
 
 void Rewind_SetClear(PySetObject *set) {
     if (!rewindActive) return;
+    catchUpContainers();
 
     Rewind_TrackObject((PyObject *)set);
-    fprintf(rewindLog, "SET_CLEAR(%lu)\n", (unsigned long)set);
+    beginEvent(REWIND_SET_CLEAR);
+    writeHeapId(set);
 }
 
 void Rewind_SetPrintItems(PySetObject *set) {
     Py_ssize_t pos;
     PyObject *key;
     Py_hash_t hash;
+    writeVarint(PySet_GET_SIZE(set));
     pos = 0;
     while (_PySet_NextEntry((PyObject *)set, &pos, &key, &hash)) {
-        fprintf(rewindLog, ", ");
-        Rewind_serializeObject(rewindLog, key);
+        Rewind_serializeObject(key);
+    }
+}
+
+static int comparePointers(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(PyObject *const *)a;
+    uintptr_t y = (uintptr_t)*(PyObject *const *)b;
+    return (x > y) - (x < y);
+}
+
+// New references to the items of a set, sorted by address and followed by
+// NULL.
+static PyObject **setItems(PySetObject *set) {
+    PyObject **items = PyMem_RawMalloc((PySet_GET_SIZE(set) + 1) * sizeof(PyObject *));
+    if (items == NULL) {
+        Py_FatalError("rewind: out of memory for a set update");
+    }
+    Py_ssize_t pos = 0, n = 0;
+    PyObject *key;
+    Py_hash_t hash;
+    while (_PySet_NextEntry((PyObject *)set, &pos, &key, &hash)) {
+        Py_INCREF(key);
+        items[n++] = key;
+    }
+    items[n] = NULL;
+    qsort(items, n, sizeof(PyObject *), comparePointers);
+    return items;
+}
+
+static void releaseSetItems(PyObject **items) {
+    for (PyObject **p = items; *p != NULL; p++) {
+        Py_DECREF(*p);
+    }
+    PyMem_RawFree(items);
+}
+
+// Call visit, if given, on each of the setItems() items that isn't one of
+// the others, and return how many there are.
+static Py_ssize_t setItemsNotIn(PyObject **items, PyObject **others,
+                                void (*visit)(PyObject *)) {
+    Py_ssize_t count = 0;
+    for (; *items != NULL; items++) {
+        while (*others != NULL && (uintptr_t)*others < (uintptr_t)*items) {
+            others++;
+        }
+        if (*others != *items) {
+            if (visit != NULL) {
+                visit(*items);
+            }
+            count++;
+        }
+    }
+    return count;
+}
+
+// The items of a set about to be updated, for Rewind_SetUpdate to log what
+// changed, or NULL if there is no need to.
+PyObject **Rewind_SetUpdateBegin(PySetObject *set) {
+    catchUpContainers();
+    if (!rewindActive || !knownObjectsContains((PyObject *)set)) {
+        return NULL;
+    }
+    return setItems(set);
+}
+
+/*
+SET_UPDATE(set, num_added, *added, num_removed, *removed), between the
+setItems() before and after; nothing is written if there are none
+*/
+static void writeSetUpdate(PySetObject *set, PyObject **before, PyObject **after) {
+    // items stay alive in before until written, even the removed ones
+    Py_ssize_t added = setItemsNotIn(after, before, Rewind_TrackObject);
+    Py_ssize_t removed = setItemsNotIn(before, after, NULL);
+    if (added != 0 || removed != 0) {
+        beginEvent(REWIND_SET_UPDATE);
+        writeHeapId(set);
+        writeVarint(added);
+        setItemsNotIn(after, before, Rewind_serializeObject);
+        writeVarint(removed);
+        setItemsNotIn(before, after, Rewind_serializeObject);
+    }
+}
+
+// Log what an update changed, relative to the items Rewind_SetUpdateBegin
+// returned.
+void Rewind_SetUpdate(PySetObject *set, PyObject **before) {
+    if (!rewindActive) {
+        if (before != NULL) {
+            releaseSetItems(before);
+        }
+        return;
+    }
+    if (before == NULL) {
+        // NEW_SET gives the updated set
+        Rewind_TrackObject((PyObject *)set);
+        return;
+    }
+
+    PyObject **after = setItems(set);
+    writeSetUpdate(set, before, after);
+    releaseSetItems(before);
+    releaseSetItems(after);
+    // which takes in what the set_*() functions noted along the way
+    if (changedCount > 0) {
+        forgetChangedContainer((PyObject *)set);
+    }
+}
+
+// New references to the keys and values of a dict in turn, sorted by key.
+static PyObject **dictItems(PyObject *dict, Py_ssize_t *count) {
+    *count = 2 * PyDict_GET_SIZE(dict);
+    PyObject **items = PyMem_RawMalloc(Py_MAX(*count, 1) * sizeof(PyObject *));
+    if (items == NULL) {
+        Py_FatalError("rewind: out of memory for a changed dict");
+    }
+    Py_ssize_t pos = 0, n = 0;
+    PyObject *key, *value;
+    while (PyDict_Next(dict, &pos, &key, &value)) {
+        Py_INCREF(key);
+        Py_INCREF(value);
+        items[n++] = key;
+        items[n++] = value;
     }
+    qsort(items, n / 2, 2 * sizeof(PyObject *), comparePointers);
+    return items;
 }
 
-void Rewind_SetUpdate(PySetObject *set) {
+// Where key is in the dictItems() items, or -1.
+static Py_ssize_t findDictKey(PyObject **items, Py_ssize_t count, PyObject *key) {
+    Py_ssize_t low = 0, high = count / 2;
+    while (low < high) {
+        Py_ssize_t middle = low + (high - low) / 2;
+        if ((uintptr_t)items[2 * middle] < (uintptr_t)key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low < count / 2 && items[2 * low] == key ? 2 * low : -1;
+}
+
+// Called before each change to a list, dict or set that isn't logged and
+// that Rewind_TrackedFilter doesn't rule out, see Include/rewind.h. On the
+// first since the log last caught up with a container it knows, keep what
+// the container holds now, which is what the log gives, for
+// writeContainerChanges to compare with what it holds then; KNOWN_CHANGED
+// in its entry turns the changes after that away. Subclasses of list and
+// set are written as NEW_OBJECT, without their items, so there is nothing
+// to keep up with for them.
+void Rewind_ContainerChanging(PyObject *op) {
     if (!rewindActive) return;
+    uintptr_t *entry = knownObjectEntry(op);
+    if (entry == NULL || (*entry & KNOWN_CHANGED)) return;
 
-    Rewind_TrackObject((PyObject *)set);
-    fprintf(rewindLog, "SET_UPDATE(%lu", (unsigned long)set);
-    Rewind_SetPrintItems(set);
-    fprintf(rewindLog, ")\n");
+    PyObject **items;
+    Py_ssize_t count;
+    if (Py_IS_TYPE(op, &PyList_Type)) {
+        count = Py_SIZE(op);
+        items = PyMem_RawMalloc(Py_MAX(count, 1) * sizeof(PyObject *));
+        if (items == NULL) {
+            Py_FatalError("rewind: out of memory for a changed list");
+        }
+        for (Py_ssize_t i = 0; i < count; i++) {
+            items[i] = PyList_GET_ITEM(op, i);
+            Py_INCREF(items[i]);
+        }
+    } else if (PyDict_Check(op)) {
+        items = dictItems(op, &count);
+    } else if (Py_IS_TYPE(op, &PySet_Type)) {
+        items = setItems((PySetObject *)op);
+        count = PySet_GET_SIZE(op);
+    } else {
+        return;
+    }
+    if (changedCount == changedSize) {
+        size_t size = Py_MAX(2 * changedSize, 16);
+        ChangedContainer *changed = PyMem_RawRealloc(changedContainers, size * sizeof(ChangedContainer));
+        if (changed == NULL) {
+            Py_FatalError("rewind: out of memory for the changed containers");
+        }
+        changedContainers = changed;
+        changedSize = size;
+    }
+    ChangedContainer *changed = &changedContainers[changedCount++];
+    changed->container = op;
+    changed->items = items;
+    changed->count = count;
+    *entry |= KNOWN_CHANGED;
+}
+
+/*
+LIST_SPLICE(list, start, stop, *items): the items the list had from start up
+to stop are replaced by those it has now from start up to end
+*/
+static void writeListSplice(PyListObject *list, Py_ssize_t start, Py_ssize_t stop,
+                            Py_ssize_t end) {
+    for (Py_ssize_t i = start; i < end; i++) {
+        Rewind_TrackObject(list->ob_item[i]);
+    }
+    beginEvent(REWIND_LIST_SPLICE);
+    writeHeapId(list);
+    writeVarint(start);
+    writeVarint(stop);
+    writeVarint(end - start);
+    for (Py_ssize_t i = start; i < end; i++) {
+        Rewind_serializeObject(list->ob_item[i]);
+    }
+}
+
+// Log how a list got from the items before to what it holds now: the part
+// of it that changed as a LIST_SPLICE, or, if fewer items are written that
+// way, as a LIST_STORE_SUBSCRIPT for each item of it that changed in place
+// and a LIST_SPLICE for the rest, like what heapq leaves.
+static void writeListChanges(PyListObject *list, PyObject **before, Py_ssize_t count) {
+    PyObject **after = list->ob_item;
+    Py_ssize_t n = Py_SIZE(list);
+    Py_ssize_t start = 0;
+    while (start < count && start < n && before[start] == after[start]) {
+        start++;
+    }
+    Py_ssize_t end = 0;
+    while (end < count - start && end < n - start &&
+           before[count - 1 - end] == after[n - 1 - end]) {
+        end++;
+    }
+    Py_ssize_t removed = count - end - start, added = n - end - start;
+    if (removed == 0 && added == 0) {
+        return;
+    }
+    Py_ssize_t common = Py_MIN(removed, added);
+    Py_ssize_t stores = 0;
+    for (Py_ssize_t i = start; i < start + common; i++) {
+        stores += before[i] != after[i];
+    }
+    // a store takes an index as well as the item
+    if (2 * stores >= common) {
+        writeListSplice(list, start, count - end, n - end);
+        return;
+    }
+    for (Py_ssize_t i = start; i < start + common; i++) {
+        if (before[i] == after[i]) {
+            continue;
+        }
+        Rewind_TrackObject(after[i]);
+        beginEvent(REWIND_LIST_STORE_SUBSCRIPT);
+        writeHeapId(list);
+        writeByte(REWIND_VALUE_INT);
+        writeSignedVarint(i);
+        Rewind_serializeObject(after[i]);
+    }
+    if (removed != added) {
+        writeListSplice(list, start + common, count - end, n - end);
+    }
+}
+
+// Log how a dict got from the dictItems() before to what it holds now, as
+// a DICT_DELETE_SUBSCRIPT for each key it lost and then, in the order of
+// the dict, a DICT_STORE_SUBSCRIPT for each key that is new or has another
+// value. Keys are told apart by identity, as readers do.
+static void writeDictChanges(PyDictObject *dict, PyObject **before, Py_ssize_t count) {
+    Py_ssize_t afterCount;
+    PyObject **after = dictItems((PyObject *)dict, &afterCount);
+    for (Py_ssize_t i = 0; i < count; i += 2) {
+        if (findDictKey(after, afterCount, before[i]) < 0) {
+            beginEvent(REWIND_DICT_DELETE_SUBSCRIPT);
+            writeHeapId(dict);
+            Rewind_serializeObject(before[i]);
+        }
+    }
+    Py_ssize_t pos = 0;
+    PyObject *key, *value;
+    while (PyDict_Next((PyObject *)dict, &pos, &key, &value)) {
+        Py_ssize_t i = findDictKey(before, count, key);
+        if (i >= 0 && before[i + 1] == value) {
+            continue;
+        }
+        Rewind_TrackObject(key);
+        Rewind_TrackObject(value);
+        beginEvent(REWIND_DICT_STORE_SUBSCRIPT);
+        writeHeapId(dict);
+        Rewind_serializeObject(key);
+        Rewind_serializeObject(value);
+    }
+    for (Py_ssize_t i = 0; i < afterCount; i++) {
+        Py_DECREF(after[i]);
+    }
+    PyMem_RawFree(after);
+}
+
+// Log what changed in changedContainers and forget them. Nothing here runs
+// code of the program, which could change them further, until the items
+// kept are released.
+static void writeContainerChanges(void) {
+    ChangedContainer *changed = changedContainers;
+    size_t count = changedCount;
+    changedContainers = NULL;
+    changedCount = changedSize = 0;
+    for (size_t i = 0; i < count; i++) {
+        PyObject *op = changed[i].container;
+        uintptr_t *entry = knownObjectEntry(op);
+        if (entry != NULL) {
+            *entry &= ~KNOWN_CHANGED;
+        }
+        if (PyList_Check(op)) {
+            writeListChanges((PyListObject *)op, changed[i].items, changed[i].count);
+        } else if (PyDict_Check(op)) {
+            writeDictChanges((PyDictObject *)op, changed[i].items, changed[i].count);
+        } else {
+            PyObject **after = setItems((PySetObject *)op);
+            writeSetUpdate((PySetObject *)op, changed[i].items, after);
+            releaseSetItems(after);
+        }
+    }
+    releaseChangedContainers(changed, count);
 }
 
-void Rewind_YieldValue(PyObject *retval) {
+void Rewind_YieldValue(PyFrameObject *frame, PyObject *retval) {
     if (!rewindActive) return;
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+    if (samplePolicyCount > 0 && !frameLogged(frame, 1)) return;
 
     Rewind_TrackObject(retval);
-    fprintf(rewindLog, "YIELD_VALUE(");
-    Rewind_serializeObject(rewindLog, retval);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_YIELD_VALUE);
+    Rewind_serializeObject(retval);
 }
 
 void Rewind_StoreName(PyObject *ns, PyObject *name, PyObject *value) {
@@ -371,20 +3263,21 @@ void Rewind_StoreName(PyObject *ns, PyObject *name, PyObject *value) {
     Rewind_TrackObject(ns);
     Rewind_TrackObject(value);
     Rewind_TrackObject(name);
-    fprintf(rewindLog, "STORE_NAME(%lu, ", (unsigned long)ns);
-    Rewind_serializeObject(rewindLog, name);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_STORE_NAME);
+    writeHeapId(ns);
+    Rewind_serializeObject(name);
+    Rewind_serializeObject(value);
 }
 
-void Rewind_StoreFast(int index, PyObject *value) {
+void Rewind_StoreFast(PyFrameObject *frame, int index, PyObject *value) {
     if (!rewindActive) return;
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+    if (samplePolicyCount > 0 && !frameLogged(frame, 0)) return;
 
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "STORE_FAST(%d, ", index);
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_STORE_FAST);
+    writeVarint(index);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_StoreGlobal(PyObject *ns, PyObject *name, PyObject *value) {
@@ -393,28 +3286,54 @@ void Rewind_StoreGlobal(PyObject *ns, PyObject *name, PyObject *value) {
     Rewind_TrackObject(ns);
     Rewind_TrackObject(value);
     Rewind_TrackObject(name);
-    fprintf(rewindLog, "STORE_GLOBAL(%lu, ", (unsigned long)ns);
-    Rewind_serializeObject(rewindLog, name);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_STORE_GLOBAL);
+    writeHeapId(ns);
+    Rewind_serializeObject(name);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_DeleteGlobal(PyObject *ns, PyObject *name) {
     if (!rewindActive) return;
 
-    fprintf(rewindLog, "DELETE_GLOBAL(%lu, ", (unsigned long)ns);
-    PyObject_Print(name, rewindLog, 0);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_DELETE_GLOBAL);
+    writeHeapId(ns);
+    writeSymbol(name);
 }
 
-void Rewind_ReturnValue(PyObject *retval) {
+void Rewind_ReturnValue(PyFrameObject *frame, PyObject *retval) {
     if (!rewindActive) return;
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+    if (samplePolicyCount > 0 && !frameLogged(frame, 1)) return;
 
     Rewind_TrackObject(retval);
-    fprintf(rewindLog, "RETURN_VALUE(");
-    Rewind_serializeObject(rewindLog, retval);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_RETURN_VALUE);
+    Rewind_serializeObject(retval);
+}
+
+// A jump back to target ends an iteration of the loop that starts there,
+// which with sampling may start or end leaving iterations out of the log.
+void Rewind_JumpAbsolute(PyFrameObject *frame, int target) {
+    if (!rewindActive || samplePolicyCount == 0 || target > frame->f_lasti) return;
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+    RecordedFrame *recorded = sampledFrame(frame);
+    if (recorded == NULL) return;
+
+    if (recorded->loopEnd >= 0 &&
+            (frame->f_lasti < recorded->loopStart || frame->f_lasti > recorded->loopEnd)) {
+        endElidedLoop(recorded, 0);
+    }
+    // loops within the one left out are left out with it
+    if (recorded->loopEnd >= 0 && target != recorded->loopStart) return;
+    CodeSampling *sampling = codeSampling(frame);
+    if (sampleTaken(sampling, ++sampling->iterations)) {
+        if (recorded->loopEnd >= 0) {
+            endElidedLoop(recorded, 0);
+        }
+    } else if (recorded->loopEnd >= 0) {
+        recorded->loopIterations++;
+    } else {
+        startElidedLoop(recorded, target);
+    }
 }
 
 void Rewind_SetAttr(PyObject *obj, PyObject *attr, PyObject *value) {
@@ -423,11 +3342,10 @@ void Rewind_SetAttr(PyObject *obj, PyObject *attr, PyObject *value) {
     Rewind_TrackObject(obj);
     Rewind_TrackObject(attr);
     Rewind_TrackObject(value);
-    fprintf(rewindLog, "STORE_ATTR(%lu, ", (unsigned long)obj);
-    Rewind_serializeObject(rewindLog, attr);
-    fprintf(rewindLog, ", ");
-    Rewind_serializeObject(rewindLog, value);
-    fprintf(rewindLog, ")\n");
+    beginEvent(REWIND_STORE_ATTR);
+    writeHeapId(obj);
+    Rewind_serializeObject(attr);
+    Rewind_serializeObject(value);
 }
 
 void Rewind_StringInPlaceAdd(PyObject *left, PyObject *right, PyObject *result) {
@@ -435,179 +3353,742 @@ void Rewind_StringInPlaceAdd(PyObject *left, PyObject *right, PyObject *result)
 
     if (left == result || right == result) {
         Rewind_TrackObject(result);
-        fprintf(rewindLog, "STRING_INPLACE_ADD_RESULT(%lu, ", (unsigned long)result);
-        PyObject_Print(result, rewindLog, 0);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_STRING_INPLACE_ADD_RESULT);
+        writeHeapId(result);
+        writeString(result);
     }
 }
 
-void Rewind_TrackObject(PyObject *obj) {
-    if (obj == NULL) {
+// Remember obj, known now, for writeCheckpoint to forget again.
+static void noteCheckpointTracked(PyObject *obj) {
+    if (checkpointTrackedCount == checkpointTrackedSize) {
+        size_t size = Py_MAX(2 * checkpointTrackedSize, 256);
+        PyObject **tracked = PyMem_RawRealloc(checkpointTracked, size * sizeof(PyObject *));
+        if (tracked == NULL) {
+            Py_FatalError("rewind: out of memory for a checkpoint");
+        }
+        checkpointTracked = tracked;
+        checkpointTrackedSize = size;
+    }
+    Py_INCREF(obj);
+    checkpointTracked[checkpointTrackedCount++] = obj;
+}
+
+// Make obj known and queue it to be written, unless it is known already
+// or the objects written for the current one are used up.
+static void queueObject(PyObject *obj) {
+    if (obj == NULL || trackBudget == 0 || Rewind_isSimpleType(obj)) {
         return;
     }
-    //Rewind_FlushDeallocatedIds();
-    if (Rewind_isSimpleType(obj)) {
+    if (!knownObjectsAdd(obj)) {
         return;
     }
+    trackBudget--;
+    if (inCheckpoint) {
+        noteCheckpointTracked(obj);
+    }
+    if (trackQueueCount == trackQueueSize) {
+        size_t size = Py_MAX(2 * trackQueueSize, 256);
+        PyObject **queue = PyMem_RawRealloc(trackQueue, size * sizeof(PyObject *));
+        if (queue == NULL) {
+            Py_FatalError("rewind: out of memory for the object queue");
+        }
+        trackQueue = queue;
+        trackQueueSize = size;
+    }
+    // borrowed: whatever refers to it is alive and runs no code until the
+    // queue is written
+    trackQueue[trackQueueCount++] = obj;
+}
 
-    PyObject *id = (PyObject *)PyLong_FromLong((long)obj);
-    if (PySet_Contains(knownObjectIds, id)) {
-        Py_DECREF(id);
+// In a checkpoint, the state of objects that NEW_OBJECT leaves out, as the
+// events that would have put it there: the contents of cells, the items of
+// instances of dict subclasses and the attributes of objects other than
+// builtin types (replayers model all of these objects as a single dict).
+static void writeObjectState(PyObject *obj) {
+    if (PyCell_Check(obj)) {
+        PyObject *value = PyCell_GET(obj);
+        queueObject(value);
+        beginEvent(REWIND_STORE_DEREF);
+        writeHeapId(obj);
+        Rewind_serializeObject(value);
+        return;
+    }
+    if (PyType_Check(obj) && !PyType_HasFeature((PyTypeObject *)obj, Py_TPFLAGS_HEAPTYPE)) {
+        return;
+    }
+    if (PyDict_Check(obj)) {
+        Py_ssize_t pos = 0;
+        PyObject *key, *value;
+        while (PyDict_Next(obj, &pos, &key, &value)) {
+            queueObject(key);
+            queueObject(value);
+            beginEvent(REWIND_DICT_STORE_SUBSCRIPT);
+            writeHeapId(obj);
+            Rewind_serializeObject(key);
+            Rewind_serializeObject(value);
+        }
+    }
+    PyObject **dictPtr = _PyObject_GetDictPtr(obj);
+    if (dictPtr == NULL || *dictPtr == NULL) {
         return;
     }
+    Py_ssize_t pos = 0;
+    PyObject *name, *value;
+    while (PyDict_Next(*dictPtr, &pos, &name, &value)) {
+        queueObject(name);
+        queueObject(value);
+        beginEvent(REWIND_STORE_ATTR);
+        writeHeapId(obj);
+        Rewind_serializeObject(name);
+        Rewind_serializeObject(value);
+    }
+}
+
+// What a NEW_TUPLE event gives for tuple, as bytes that are the same for
+// tuples it gives the same items for: a REWIND_VALUE_* tag and 8 bytes for
+// each item, the address of an object given by reference. NULL if an item
+// is given by its digits.
+static PyObject *tupleKey(PyObject *tuple) {
+    Py_ssize_t n = PyTuple_GET_SIZE(tuple);
+    PyObject *key = PyBytes_FromStringAndSize(NULL, 9 * n);
+    if (key == NULL) {
+        Py_FatalError("rewind: out of memory for the tuple table");
+    }
+    unsigned char *p = (unsigned char *)PyBytes_AS_STRING(key);
+    for (Py_ssize_t i = 0; i < n; i++, p += 9) {
+        PyObject *item = PyTuple_GET_ITEM(tuple, i);
+        uint64_t bits = 0;
+        if (item == NULL || item == Py_None) {
+            p[0] = REWIND_VALUE_NONE;
+        } else if (Py_IS_TYPE(item, &PyBool_Type)) {
+            p[0] = item == Py_True ? REWIND_VALUE_TRUE : REWIND_VALUE_FALSE;
+        } else if (Py_IS_TYPE(item, &PyLong_Type)) {
+            int overflow;
+            long long value = PyLong_AsLongLongAndOverflow(item, &overflow);
+            if (overflow != 0) {
+                Py_DECREF(key);
+                return NULL;
+            }
+            p[0] = REWIND_VALUE_INT;
+            bits = (uint64_t)value;
+        } else if (Py_IS_TYPE(item, &PyFloat_Type)) {
+            double value = PyFloat_AS_DOUBLE(item);
+            p[0] = REWIND_VALUE_FLOAT;
+            memcpy(&bits, &value, sizeof(bits));
+        } else {
+            p[0] = REWIND_VALUE_REF;
+            bits = (uintptr_t)item;
+        }
+        memcpy(p + 1, &bits, sizeof(bits));
+    }
+    return key;
+}
+
+/*
+NEW_TUPLE_COPY(tuple, index): tuple has the items the NEW_TUPLE event with
+that index in the block gave, which holds for references too: readers take
+them to be to whatever has the address then, as for any NEW_TUPLE.
+Returns 0 if there is no such event and a NEW_TUPLE must be written, which
+then gets the next index.
+*/
+static int writeTupleCopy(PyObject *tuple) {
+    PyObject *key = tupleKey(tuple);
+    if (key == NULL) {
+        return 0;
+    }
+    // the index is into the block the event goes in
+    cutBlock();
+    PyObject *index = PyDict_GetItemWithError(tupleIndexes, key);
+    if (index != NULL) {
+        Py_DECREF(key);
+        beginEvent(REWIND_NEW_TUPLE_COPY);
+        writeHeapId(tuple);
+        writeVarint(PyLong_AsSize_t(index));
+        return 1;
+    }
+    index = PyLong_FromSsize_t(blockTupleCount);
+    if (index == NULL || PyDict_SetItem(tupleIndexes, key, index) < 0) {
+        Py_FatalError("rewind: out of memory for the tuple table");
+    }
+    Py_DECREF(index);
+    Py_DECREF(key);
+    return 0;
+}
 
+// Write the NEW_* event that gives the current contents of obj, queueing
+// what it refers to.
+static void writeNewObject(PyObject *obj) {
+    // the log has the container as it is now, not as it was copied
+    if (changedCount > 0 && (PyList_Check(obj) || PyDict_Check(obj) || PyAnySet_Check(obj))) {
+        forgetChangedContainer(obj);
+    }
     if (Py_IS_TYPE(obj, &PyList_Type)) {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
-    
         PyListObject *list = (PyListObject *)obj;
         for (int i = 0; i < Py_SIZE(list); ++i) {
             PyObject *item = list->ob_item[i];
-            Rewind_TrackObject(item);
+            queueObject(item);
         }
-        fprintf(rewindLog, "NEW_LIST(%lu", (unsigned long)obj);
+        beginEvent(REWIND_NEW_LIST);
+        writeHeapId(obj);
+        writeVarint(Py_SIZE(list));
         for (int i = 0; i < Py_SIZE(list); ++i) {
             PyObject *item = list->ob_item[i];
-            fprintf(rewindLog, ", ");
-            Rewind_serializeObject(rewindLog, item);
+            Rewind_serializeObject(item);
         }
-        fprintf(rewindLog, ")\n");
     } else if (Py_IS_TYPE(obj, &PyUnicode_Type)) {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
-
-        fprintf(rewindLog, "NEW_STRING(%lu, ", (unsigned long)obj);
-        Py_INCREF(obj);
-        PyObject_Print(obj, rewindLog, 0);
-        fprintf(rewindLog, ")\n");
-        Py_DECREF(obj);
+        // strings of the same text share a symbol in the block
+        beginEvent(REWIND_NEW_STRING);
+        writeHeapId(obj);
+        writeSymbol(obj);
     } else if (Py_IS_TYPE(obj, &PyDict_Type)) {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
-
-        PyObject *items = PyDict_Items(obj);
-
-        PyObject *iterator = PySequence_Fast(items, "argument must be iterable");
-        Py_ssize_t n = PySequence_Fast_GET_SIZE(iterator);
-        PyObject **iteratorItems = PySequence_Fast_ITEMS(iterator);
-        for (int i = 0; i < n; i++) {
-            PyObject *item = iteratorItems[i];
-            PyObject *key = PyObject_GetItem(item, PyLong_FromLong(0));
-            Rewind_TrackObject(key);
-            PyObject *value = PyObject_GetItem(item, PyLong_FromLong(1));
-            Rewind_TrackObject(value);
+        Py_ssize_t pos = 0;
+        PyObject *key, *value;
+        while (PyDict_Next(obj, &pos, &key, &value)) {
+            queueObject(key);
+            queueObject(value);
         }
-        Py_DECREF(iterator);
 
-        fprintf(rewindLog, "NEW_DICT(%lu", (unsigned long)obj);
-        iterator = PySequence_Fast(items, "argument must be iterable");
-        n = PySequence_Fast_GET_SIZE(iterator);
-        iteratorItems = PySequence_Fast_ITEMS(iterator);
-        for (int i = 0; i < n; i++) {
-            fprintf(rewindLog, ", ");
-            PyObject *item = iteratorItems[i];
-            PyObject *key = PyObject_GetItem(item, PyLong_FromLong(0));
-            PyObject *value = PyObject_GetItem(item, PyLong_FromLong(1));
-            Rewind_serializeObject(rewindLog, key);
-            fprintf(rewindLog, ", ");
-            Rewind_serializeObject(rewindLog, value);
-        }
-        Py_DECREF(iterator);
-        Py_DECREF(items);
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_NEW_DICT);
+        writeHeapId(obj);
+        writeVarint(2 * PyDict_GET_SIZE(obj));
+        pos = 0;
+        while (PyDict_Next(obj, &pos, &key, &value)) {
+            Rewind_serializeObject(key);
+            Rewind_serializeObject(value);
+        }
     } else if (Py_IS_TYPE(obj, &PySet_Type)) {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
         Py_ssize_t pos;
         PyObject *key;
         Py_hash_t hash;
         pos = 0;
 
         while (_PySet_NextEntry(obj, &pos, &key, &hash)) {
-            Rewind_TrackObject(key);
+            queueObject(key);
         }
 
-        fprintf(rewindLog, "NEW_SET(%lu", (unsigned long)obj);
-        
-        pos = 0;
-        while (_PySet_NextEntry(obj, &pos, &key, &hash)) {
-            fprintf(rewindLog, ", ");
-            Rewind_serializeObject(rewindLog, key);
-        }
-        fprintf(rewindLog, ")\n");
+        beginEvent(REWIND_NEW_SET);
+        writeHeapId(obj);
+        Rewind_SetPrintItems((PySetObject *)obj);
     } else if (Py_IS_TYPE(obj, &PyTuple_Type)) {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
-        PyObject *iterator = PySequence_Fast(obj, "argument must be iterable");
-        Py_ssize_t n = PySequence_Fast_GET_SIZE(iterator);
-        PyObject **iteratorItems = PySequence_Fast_ITEMS(iterator);
+        Py_ssize_t n = PyTuple_GET_SIZE(obj);
         for (int i = 0; i < n; i++) {
-            PyObject *item = iteratorItems[i];
-            Rewind_TrackObject(item);
+            PyObject *item = PyTuple_GET_ITEM(obj, i);
+            queueObject(item);
         }
-        Py_DECREF(iterator);
 
-        fprintf(rewindLog, "NEW_TUPLE(%lu", (unsigned long)obj);
-        iterator = PySequence_Fast(obj, "argument must be iterable");
-        n = PySequence_Fast_GET_SIZE(iterator);
-        iteratorItems = PySequence_Fast_ITEMS(iterator);
+        if (n > 0 && writeTupleCopy(obj)) {
+            return;
+        }
+        beginEvent(REWIND_NEW_TUPLE);
+        blockTupleCount++;
+        writeHeapId(obj);
+        writeVarint(n);
         for (int i = 0; i < n; i++) {
-            fprintf(rewindLog, ", ");
-            PyObject *item = iteratorItems[i];
-            Rewind_serializeObject(rewindLog, item);
+            PyObject *item = PyTuple_GET_ITEM(obj, i);
+            Rewind_serializeObject(item);
         }
-        fprintf(rewindLog, ")\n");
     } else {
-        PySet_Add(knownObjectIds, id);
-        Py_DECREF(id);
+        PyObject *type = (PyObject *)Py_TYPE(obj);
+        beginEvent(REWIND_NEW_OBJECT);
+        writeHeapId(obj);
+        Rewind_serializeObject(type);
+        if (inCheckpoint) {
+            writeObjectState(obj);
+        }
+    }
+}
 
-        fprintf(rewindLog, "NEW_OBJECT(%lu, ", (unsigned long)obj);
-        PyObject *type = PyObject_Type(obj);
-        //PyObject *typeName = PyObject_GetAttr(type, PyUnicode_FromString("__qualname__"));
-        //PyObject_Print(typeName, rewindLog, 0);
-        //fprintf(rewindLog, ", ");
-        Rewind_serializeObject(rewindLog, type);
-        fprintf(rewindLog, ")\n");
+static void writeQueuedObjects(void) {
+    while (trackQueueCount > 0) {
+        writeNewObject(trackQueue[--trackQueueCount]);
     }
 }
 
-inline int Rewind_isSimpleType(PyObject *obj) {
-    return (Py_IS_TYPE(obj, &_PyNone_Type) ||
-        Py_IS_TYPE(obj, &PyLong_Type) || 
-        Py_IS_TYPE(obj, &PyBool_Type) ||
-        Py_IS_TYPE(obj, &PyFloat_Type));
+// Write obj, known already, and what it refers to that isn't, as far as
+// TRACK_EAGER_OBJECTS goes.
+static void writeObjectGraph(PyObject *obj) {
+    trackBudget = TRACK_EAGER_OBJECTS;
+    writeNewObject(obj);
+    writeQueuedObjects();
 }
 
-void Rewind_serializeObject(FILE *file, PyObject *obj) {
+void Rewind_TrackObject(PyObject *obj) {
     if (obj == NULL) {
-        fprintf(file, "None");
         return;
     }
+    //Rewind_FlushDeallocatedIds();
     if (Rewind_isSimpleType(obj)) {
-        PyObject_Print(obj, file, 0);
+        return;
+    }
+
+    if (!knownObjectsAdd(obj)) {
+        return;
+    }
+    if (inCheckpoint) {
+        noteCheckpointTracked(obj);
+    }
+    writeObjectGraph(obj);
+}
+
+// Take a checkpoint at the start of a new block, see Include/rewindlog.h,
+// with the given REWIND_BLOCK_* flags besides REWIND_BLOCK_CHECKPOINT.
+static void writeCheckpoint(uint32_t flags) {
+    // the checkpoint gives what containers hold now, but readers that skip
+    // it need the changes that got them there
+    catchUpContainers();
+    if (logBufferLength > REWIND_BLOCK_HEADER_SIZE) {
+        flushLog();
+    }
+    blockFlags |= REWIND_BLOCK_CHECKPOINT | flags;
+    lastCheckpointBlock = blockCount;
+    inCheckpoint = 1;
+    beginEvent(REWIND_CHECKPOINT);
+    writeVarint(eventCount);
+
+    // Writing objects tracks the ones they refer to that aren't known yet,
+    // which adds to knownObjects, so take the objects out of it first. They
+    // are kept alive until written, whatever runs meanwhile.
+    PyObject **objects = PyMem_RawMalloc((knownObjectsCount + 1) * sizeof(PyObject *));
+    if (objects == NULL) {
+        Py_FatalError("rewind: out of memory for a checkpoint");
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < knownObjectsSize; i++) {
+        uintptr_t key = knownObjects[i];
+        if (key != KNOWN_EMPTY && key != KNOWN_DELETED) {
+            objects[count] = (PyObject *)key;
+            Py_INCREF(objects[count]);
+            count++;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        writeObjectGraph(objects[i]);
+    }
+
+    // Frames left from an earlier recording may not pass the filters of
+    // this one; they are not followed any further.
+    size_t depth = 0;
+    for (size_t i = 0; i < recordedFrameCount; i++) {
+        if (codeFilterCount == 0 || frameRecorded(recordedFrames[i].frame)) {
+            recordedFrames[depth++] = recordedFrames[i];
+        }
+    }
+    recordedFrameCount = depth;
+    // The frames of each thread are pushed outermost first, after a THREAD
+    // event for it, the threads in the order of their outermost frames.
+    // Pushing them forgets the line the program is on, which is put back
+    // after: a checkpoint isn't a step, unless it resyncs, where readers
+    // take up the stack it gives and the next instruction VISITs its line.
+    int savedLine = lastLine;
+    PyFrameObject *savedLineFrame = lineFrame;
+    uint64_t savedLineThread = lineThread;
+    for (size_t i = 0; i < recordedFrameCount; i++) {
+        uint64_t thread = recordedFrames[i].thread;
+        size_t j = 0;
+        while (recordedFrames[j].thread != thread) {
+            j++;
+        }
+        if (j < i) {
+            continue;
+        }
+        writeThread(thread);
+        for (; j < recordedFrameCount; j++) {
+            if (recordedFrames[j].thread == thread && !recordedFrames[j].elided) {
+                writePushFrame(recordedFrames[j].frame);
+            }
+        }
+    }
+
+    if (flags & REWIND_BLOCK_RESYNC) {
+        lastLine = -1;
+        lineFrame = NULL;
+    } else {
+        lastLine = savedLine;
+        lineFrame = savedLineFrame;
+        lineThread = savedLineThread;
+        // for readers that replay the checkpoint, which isn't a step either
+        if (lastLine >= 0) {
+            beginEvent(REWIND_VISIT);
+            writeSignedVarint(lastLine - lastVisitLine);
+            lastVisitLine = lastLine;
+        }
+    }
+
+    beginEvent(REWIND_CHECKPOINT_END);
+    inCheckpoint = 0;
+    // readers that skip the checkpoint are told the thread again
+    logThread = 0;
+    // Readers don't skip a checkpoint that resyncs, it defines them for
+    // good. A seek goes on to log events as the recording it was forked
+    // from did after its checkpoint, so it forgets them all the same.
+    if (!(flags & REWIND_BLOCK_RESYNC) || seekTarget != 0) {
+        for (size_t i = 0; i < checkpointTrackedCount; i++) {
+            knownObjectsRemove(checkpointTracked[i]);
+        }
+    }
+    for (size_t i = 0; i < checkpointTrackedCount; i++) {
+        Py_DECREF(checkpointTracked[i]);
+    }
+    checkpointTrackedCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        Py_DECREF(objects[i]);
+    }
+    PyMem_RawFree(objects);
+}
+
+#ifdef REWIND_FORK_CHECKPOINTS
+// Have the frozen process of a fork checkpoint exit, and take its FIFO away.
+static void releaseForkCheckpoint(ForkCheckpoint *checkpoint) {
+    int fd = open(checkpoint->fifo, O_WRONLY | O_NONBLOCK);
+    unlink(checkpoint->fifo);
+    if (fd >= 0) {
+        _Py_write_noraise(fd, "quit\n", 5);
+        close(fd);
+    }
+    PyMem_RawFree(checkpoint->fifo);
+    checkpoint->fifo = NULL;
+}
+
+static void releaseForkPool(void) {
+    for (size_t i = 0; i < forkPoolCount; i++) {
+        releaseForkCheckpoint(&forkPool[i]);
+    }
+    forgetForkPool();
+}
+
+// In a forked child, the frozen processes are the parent's to release.
+static void forgetForkPool(void) {
+    for (size_t i = 0; i < forkPoolCount; i++) {
+        PyMem_RawFree(forkPool[i].fifo);
+    }
+    PyMem_RawFree(forkPool);
+    forkPool = NULL;
+    forkPoolCount = 0;
+}
+
+// Whether fifo is still the file that fd reads, rather than one made in its
+// place for a later checkpoint.
+static int isOwnFifo(int fd, const char *fifo) {
+    struct stat opened, named;
+    return fstat(fd, &opened) == 0 && stat(fifo, &named) == 0 &&
+           opened.st_dev == named.st_dev && opened.st_ino == named.st_ino;
+}
+
+// The exit status of process pid, its signal number negated if it was killed.
+static int waitForProcess(pid_t pid) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status);
+}
+
+// Run in the frozen process of a fork checkpoint: wait for requests on the
+// FIFO that fd reads, one per line, which are
+//   seek <event> <reply FIFO> <log path>
+//   quit
+// A seek forks a process that runs the program forward, see runForward,
+// and once it exits, writes its exit status and a newline to the reply
+// FIFO, which the debugger has opened for reading. Returns the log path in
+// that process. Exits after a quit, or after FORK_IDLE_MS without requests.
+static PyObject *serveSeeks(int fd, const char *fifo) {
+    char requests[4096];
+    size_t length = 0;
+    for (;;) {
+        char *newline = memchr(requests, '\n', length);
+        if (newline == NULL) {
+            if (length == sizeof(requests)) {
+                length = 0;
+            }
+            struct pollfd ready = {fd, POLLIN, 0};
+            int polled = poll(&ready, 1, FORK_IDLE_MS);
+            if (polled == 0 || (polled < 0 && errno != EINTR)) {
+                break;
+            }
+            ssize_t n = polled > 0 ? read(fd, requests + length, sizeof(requests) - length) : 0;
+            if (n > 0) {
+                length += n;
+            }
+            continue;
+        }
+        *newline = '\0';
+        if (strcmp(requests, "quit") == 0) {
+            break;
+        }
+        char *reply = NULL, *path = NULL;
+        unsigned long long event = 0;
+        if (strncmp(requests, "seek ", 5) == 0) {
+            event = strtoull(requests + 5, &reply, 10);
+            if (*reply == ' ' && (path = strchr(reply + 1, ' ')) != NULL) {
+                reply++;
+                *path++ = '\0';
+            }
+        }
+        if (path != NULL && *path != '\0' && event != 0) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fd);
+                seekTarget = event;
+                PyObject *logFileName = PyUnicode_DecodeFSDefault(path);
+                if (logFileName == NULL) {
+                    _exit(1);
+                }
+                return logFileName;
+            }
+            int status = pid < 0 ? -1 : waitForProcess(pid);
+            int replyFd = open(reply, O_WRONLY | O_NONBLOCK);
+            if (replyFd >= 0) {
+                char text[16];
+                int textLength = snprintf(text, sizeof(text), "%d\n", status);
+                _Py_write_noraise(replyFd, text, textLength);
+                close(replyFd);
+            }
+        }
+        length -= newline + 1 - requests;
+        memmove(requests, newline + 1, length);
+    }
+    if (isOwnFifo(fd, fifo)) {
+        unlink(fifo);
+    }
+    _exit(0);
+}
+
+// In a process forked from a frozen one, record the program from the fork
+// checkpoint on into a new log at path, stopping at seekTarget. What is
+// known to the log is kept as the recording left it, and checkpoints are
+// taken as they were, so that events are numbered as they were there; the
+// log resyncs from a checkpoint of it.
+static void runForward(PyObject *path) {
+    PyObject *pathBytes = PyUnicode_EncodeFSDefault(path);
+    rewindLog = pathBytes != NULL ? _Py_fopen_obj(path, "wb") : NULL;
+    if (rewindLog == NULL) {
+        _exit(1);
+    }
+    setvbuf(rewindLog, NULL, _IONBF, 0);
+    writeLogHeader();
+    logPath = _PyMem_RawStrdup(PyBytes_AS_STRING(pathBytes));
+    Py_DECREF(pathBytes);
+    if (logPath == NULL) {
+        Py_FatalError("rewind: out of memory for the log file name");
+    }
+    // what was buffered belongs to the recording, only the chunk being
+    // filled is needed, as the first of the ring
+    LogChunk *current = &logChunks[_Py_atomic_load_relaxed(&ringHead) % LOG_CHUNKS];
+    current->data = logChunks[0].data;
+    current->size = logChunks[0].size;
+    logChunks[0].data = logBuffer;
+    logChunks[0].size = logBufferSize;
+#ifdef HAVE_LIBZ
+    // the writer thread may have been growing it
+    compressBuffer = NULL;
+    compressBufferSize = 0;
+#endif
+    resetLogWriter();
+    startLogWriter();
+    blockCount = 0;
+    startBlock();
+    rewindActive = 1;
+    writeCheckpoint(REWIND_BLOCK_RESYNC);
+    scheduleCheckpointCheck();
+}
+
+// Fork a copy of the process, frozen at the checkpoint just taken, into the
+// pool; see serveSeeks for what a debugger can ask of it. It waits for
+// requests on a FIFO next to the log, named after it and the index of the
+// next event, such as prog.rewind.1000000.fork, and is made a child of init
+// rather than of the program, which never sees it.
+static void forkCheckpoint(void) {
+    checkpointsTaken++;
+    // Only the thread that forks comes along, a program running others
+    // can't be run forward without them.
+    PyInterpreterState *interp = PyInterpreterState_Get();
+    if (PyThreadState_Next(PyInterpreterState_ThreadHead(interp)) != NULL ||
+        PyInterpreterState_Next(PyInterpreterState_Head()) != NULL) {
+        return;
+    }
+    if ((checkpointsTaken - 1) % forkEvery != 0) return;
+    if (forkPoolCount == forkPoolSize) {
+        size_t kept = 0;
+        for (size_t i = 0; i < forkPoolCount; i++) {
+            if (i % 2 == 0) {
+                forkPool[kept++] = forkPool[i];
+            } else {
+                releaseForkCheckpoint(&forkPool[i]);
+            }
+        }
+        forkPoolCount = kept;
+        forkEvery *= 2;
+        if ((checkpointsTaken - 1) % forkEvery != 0) return;
+    }
+
+    size_t fifoSize = strlen(logPath) + 32;
+    char *fifo = PyMem_RawMalloc(fifoSize);
+    if (fifo == NULL) {
+        Py_FatalError("rewind: out of memory for a fork checkpoint");
+    }
+    snprintf(fifo, fifoSize, "%s.%" PRIu64 ".fork", logPath, eventCount);
+    // Left by a recording that is gone. Opened for writing as well as
+    // reading, the FIFO never reads end of file, and requests wait in it
+    // from the moment it is there.
+    unlink(fifo);
+    int fd = -1, writeFd = -1;
+    if (mkfifo(fifo, 0600) == 0) {
+        fd = open(fifo, O_RDONLY | O_NONBLOCK);
+        writeFd = fd >= 0 ? open(fifo, O_WRONLY | O_NONBLOCK) : -1;
+    }
+    if (writeFd < 0) {
+        fprintf(stderr, "rewind: failed to make %s: %s\n", fifo, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(fifo);
+        }
+        PyMem_RawFree(fifo);
+        forkPoolSize = 0;
+        return;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        pid_t frozen = fork();
+        if (frozen != 0) {
+            _exit(frozen < 0);
+        }
+        // signals meant for the terminal of the program don't reach it, nor
+        // does what the program runs forward to read or write there
+        setsid();
+        int null = open("/dev/null", O_RDWR);
+        if (null >= 0) {
+            dup2(null, 0);
+            dup2(null, 1);
+            close(null);
+        }
+        rewindActive = 0;
+        forgetForkPool();
+        forkPoolSize = 0;
+        PyObject *path = serveSeeks(fd, fifo);
+        close(writeFd);
+        PyMem_RawFree(fifo);
+        runForward(path);
+        Py_DECREF(path);
+        return;
+    }
+    close(fd);
+    close(writeFd);
+    if (pid < 0 || waitForProcess(pid) != 0) {
+        fprintf(stderr, "rewind: failed to fork a checkpoint\n");
+        unlink(fifo);
+        PyMem_RawFree(fifo);
+        return;
+    }
+    forkPool[forkPoolCount].event = eventCount;
+    forkPool[forkPoolCount].fifo = fifo;
+    forkPoolCount++;
+}
+#else
+static void forkCheckpoint(void) {}
+static void releaseForkPool(void) {}
+static void forgetForkPool(void) {}
+#endif
+
+static void checkpointIfDue(void) {
+    int due = checkpointEvents != 0 &&
+        eventCount - lastCheckpointEvent >= checkpointEvents;
+    if (flightBlocks != 0 && blockCount - lastCheckpointBlock >= flightBlocks / 2) {
+        due = 1;
+    }
+    if (checkpointInterval != 0) {
+        _PyTime_t now = _PyTime_GetMonotonicClock();
+        if (now - lastCheckpointTime >= checkpointInterval) {
+            due = 1;
+        }
+    }
+    if (due) {
+        writeCheckpoint(0);
+        lastCheckpointEvent = eventCount;
+        lastCheckpointTime = _PyTime_GetMonotonicClock();
+        if (forkPoolSize != 0) {
+            forkCheckpoint();
+        }
+    }
+    if (seekTarget != 0 && eventCount >= seekTarget) {
+        // the state the seek is after, for readers to take from the end of
+        // the log
+        writeCheckpoint(0);
+        Rewind_Deactivate();
+        _exit(0);
+    }
+    if (dumpRequested) {
+        Rewind_Dump();
+    }
+    scheduleCheckpointCheck();
+}
+
+inline int Rewind_isSimpleType(PyObject *obj) {
+    return (Py_IS_TYPE(obj, &_PyNone_Type) ||
+        Py_IS_TYPE(obj, &PyLong_Type) ||
+        Py_IS_TYPE(obj, &PyBool_Type) ||
+        Py_IS_TYPE(obj, &PyFloat_Type));
+}
+
+void Rewind_serializeObject(PyObject *obj) {
+    if (obj == NULL || obj == Py_None) {
+        writeByte(REWIND_VALUE_NONE);
+    } else if (Py_IS_TYPE(obj, &PyBool_Type)) {
+        writeByte(obj == Py_True ? REWIND_VALUE_TRUE : REWIND_VALUE_FALSE);
+    } else if (Py_IS_TYPE(obj, &PyLong_Type)) {
+        int overflow;
+        long long value = PyLong_AsLongLongAndOverflow(obj, &overflow);
+        if (overflow == 0) {
+            writeByte(REWIND_VALUE_INT);
+            writeSignedVarint(value);
+        } else {
+            PyObject *digits = PyObject_Str(obj);
+            if (digits == NULL) {
+                PyErr_Clear();
+                writeByte(REWIND_VALUE_NONE);
+                return;
+            }
+            writeByte(REWIND_VALUE_BIGINT);
+            writeString(digits);
+            Py_DECREF(digits);
+        }
+    } else if (Py_IS_TYPE(obj, &PyFloat_Type)) {
+        unsigned char *p = reserveLog(9);
+        p[0] = REWIND_VALUE_FLOAT;
+        _PyFloat_Pack8(PyFloat_AS_DOUBLE(obj), p + 1, 1);
+        logBufferLength += 9;
     } else {
-        fprintf(file, "*%lu", (unsigned long)obj);
+        writeByte(REWIND_VALUE_REF);
+        writeHeapId(obj);
     }
 }
 
 void Rewind_Dealloc(PyObject *obj) {
-    if (!rewindActive) return;
+    // freed objects are forgotten while paused too, lest their address be
+    // taken for one of the objects known to the log
+    if (knownObjects == NULL) return;
 
-    PyObject *id = PyLong_FromLong((long)obj);
-    PySet_Discard(knownObjectIds, id);
+    if (knownObjectsRemove(obj) & KNOWN_CHANGED) {
+        dropChangedContainer(obj);
+    }
 }
 
 void Rewind_Log(char *message) {
     if (!rewindActive) return;
 
-    fprintf(rewindLog, "-- %s", message);
+    beginEvent(REWIND_LOG);
+    writeBytes(message, strlen(message));
 }
 
 void printObject(FILE *file, PyObject *obj) {
     PyObject *type = PyObject_Type(obj);
-    if (type == (PyObject *)&PyUnicode_Type || 
+    if (type == (PyObject *)&PyUnicode_Type ||
         type == (PyObject *)&_PyNone_Type ||
-        type == (PyObject *)&PyLong_Type || 
+        type == (PyObject *)&PyLong_Type ||
         type == (PyObject *)&PyBool_Type) {
         PyObject_Print(obj, file, 0);
     } else {
@@ -644,16 +4125,40 @@ void printStack(FILE *file, PyObject **stack_pointer, int level) {
     fprintf(file, "]\n");
 }
 
-void logOp(char *label, PyObject **stack_pointer, int level, PyFrameObject *frame, int oparg) {
+void logOp(char *label, PyObject **stack_pointer, int level, PyFrameObject *frame, int oparg,
+           PyCodeAddressRange *bounds) {
     if (!rewindActive) return;
 
-    int lineNo = PyFrame_GetLineNumber(frame);
-    if (rewindLog) {
-        if (lastLine != lineNo) {
-            fprintf(rewindLog, "VISIT(%d)\n", lineNo);
+    // instruction boundaries are where the stack is whole
+    if (eventCount >= nextCheckpointCheck) {
+        checkpointIfDue();
+    }
+    if (codeFilterCount > 0 && !frameRecorded(frame)) return;
+
+    int lasti = frame->f_lasti;
+    if (frame == lineFrame && lasti >= bounds->ar_start && lasti < bounds->ar_end) {
+        return;
+    }
+    if (samplePolicyCount > 0 && !frameLogged(frame, 0)) return;
+    // moves bounds to the line of lasti, a step or two from where it was
+    int lineNo = _PyCode_CheckLineNumber(lasti, bounds);
+    lineFrame = frame;
+    // another thread was on a line meanwhile, this one goes after its THREAD
+    // event
+    uint64_t thread = currentThread();
+    if (lastLine != lineNo || thread != lineThread) {
+        beginEvent(REWIND_VISIT);
+        writeSignedVarint(lineNo - lastVisitLine);
+        lastVisitLine = lineNo;
+        if ((uint32_t)lineNo < blockMinLine) {
+            blockMinLine = lineNo;
+        }
+        if ((uint32_t)lineNo > blockMaxLine) {
+            blockMaxLine = lineNo;
         }
-        lastLine = lineNo;
     }
-    // printStack(rewindLog, stack_pointer, level);
-    // fprintf(rewindLog, "-- %s(%d) on #%d\n", label, oparg, lineNo);
+    lastLine = lineNo;
+    lineThread = thread;
+    // printStack(stderr, stack_pointer, level);
+    // fprintf(stderr, "-- %s(%d) on #%d\n", label, oparg, lineNo);
 }
@@ -102,6 +102,7 @@ Local naming conventions:
 #define PY_SSIZE_T_CLEAN
 #include "Python.h"
 #include "structmember.h"         // PyMemberDef
+#include "rewind.h"               // Rewind_ReplayData()
 
 #ifdef _Py_MEMORY_SANITIZER
 # include <sanitizer/msan_interface.h>
@@ -3479,12 +3480,20 @@ sock_recv_guts(PySocketSockObject *s, char* cbuf, Py_ssize_t len, int flags)
         return 0;
     }
 
+    /* what arrives is an input of the program for rewind to log or
+       replay */
+    Py_ssize_t n = Rewind_ReplayData(REWIND_INPUT_RECV, cbuf, len);
+    if (n != -2) {
+        return n;
+    }
+
     ctx.cbuf = cbuf;
     ctx.len = len;
     ctx.flags = flags;
     if (sock_call(s, 0, sock_recv_impl, &ctx) < 0)
         return -1;
 
+    Rewind_LogData(REWIND_INPUT_RECV, cbuf, ctx.result, 0);
     return ctx.result;
 }
 
@@ -1,6 +1,7 @@
 /* Time module */
 
 #include "Python.h"
+#include "rewind.h"               // Rewind_Clock()
 
 #include <ctype.h>
 
@@ -78,7 +79,21 @@ static int
 get_system_time(_PyTime_t *t)
 {
     // Avoid _PyTime_GetSystemClock() which silently ignores errors.
-    return _PyTime_GetSystemClockWithInfo(t, NULL);
+    if (_PyTime_GetSystemClockWithInfo(t, NULL) < 0) {
+        return -1;
+    }
+    Rewind_Clock(t);
+    return 0;
+}
+
+
+/* time(NULL), for the functions that default to the current time */
+static time_t
+current_time_t(void)
+{
+    _PyTime_t t = (_PyTime_t)time(NULL) * SEC_TO_NS;
+    Rewind_Clock(&t);
+    return (time_t)(t / SEC_TO_NS);
 }
 
 
@@ -463,7 +478,7 @@ parse_time_t_args(PyObject *args, const char *format, time_t *pwhen)
     if (!PyArg_ParseTuple(args, format, &ot))
         return 0;
     if (ot == NULL || ot == Py_None) {
-        whent = time(NULL);
+        whent = current_time_t();
     }
     else {
         if (_PyTime_ObjectToTime_t(ot, &whent, _PyTime_ROUND_FLOOR) == -1)
@@ -748,7 +763,7 @@ time_strftime(PyObject *self, PyObject *args)
         return NULL;
 
     if (tup == NULL) {
-        time_t tt = time(NULL);
+        time_t tt = current_time_t();
         if (_PyTime_localtime(tt, &buf) != 0)
             return NULL;
     }
@@ -943,7 +958,7 @@ time_asctime(PyObject *self, PyObject *args)
     if (!PyArg_UnpackTuple(args, "asctime", 0, 1, &tup))
         return NULL;
     if (tup == NULL) {
-        time_t tt = time(NULL);
+        time_t tt = current_time_t();
         if (_PyTime_localtime(tt, &buf) != 0)
             return NULL;
     }
@@ -1106,7 +1121,11 @@ static int
 get_monotonic(_PyTime_t *t)
 {
     // Avoid _PyTime_GetMonotonicClock() which silently ignores errors.
-    return _PyTime_GetMonotonicClockWithInfo(t, NULL);
+    if (_PyTime_GetMonotonicClockWithInfo(t, NULL) < 0) {
+        return -1;
+    }
+    Rewind_Clock(t);
+    return 0;
 }
 
 
@@ -1145,7 +1164,11 @@ static int
 get_perf_counter(_PyTime_t *t)
 {
     // Avoid _PyTime_GetPerfCounter() which silently ignores errors.
-    return _PyTime_GetPerfCounterWithInfo(t, NULL);
+    if (_PyTime_GetPerfCounterWithInfo(t, NULL) < 0) {
+        return -1;
+    }
+    Rewind_Clock(t);
+    return 0;
 }
 
 
@@ -1347,6 +1370,7 @@ time_process_time(PyObject *self, PyObject *unused)
     if (_PyTime_GetProcessTimeWithInfo(&t, NULL) < 0) {
         return NULL;
     }
+    Rewind_Clock(&t);
     return _PyFloat_FromPyTime(t);
 }
 
@@ -1362,6 +1386,7 @@ time_process_time_ns(PyObject *self, PyObject *unused)
     if (_PyTime_GetProcessTimeWithInfo(&t, NULL) < 0) {
         return NULL;
     }
+    Rewind_Clock(&t);
     return _PyTime_AsNanosecondsObject(t);
 }
 
@@ -1512,6 +1537,7 @@ time_thread_time(PyObject *self, PyObject *unused)
     if (_PyTime_GetThreadTimeWithInfo(&t, NULL) < 0) {
         return NULL;
     }
+    Rewind_Clock(&t);
     return _PyFloat_FromPyTime(t);
 }
 
@@ -1527,6 +1553,7 @@ time_thread_time_ns(PyObject *self, PyObject *unused)
     if (_PyTime_GetThreadTimeWithInfo(&t, NULL) < 0) {
         return NULL;
     }
+    Rewind_Clock(&t);
     return _PyTime_AsNanosecondsObject(t);
 }
 
@@ -2062,7 +2089,9 @@ pysleep(_PyTime_t secs)
     HANDLE hInterruptEvent;
 #endif
 
-    if (get_monotonic(&monotonic) < 0) {
+    // not get_monotonic(): the clock sleep goes by is no input of the
+    // program for rewind to log
+    if (_PyTime_GetMonotonicClockWithInfo(&monotonic, NULL) < 0) {
         return -1;
     }
     deadline = monotonic + secs;
@@ -2117,7 +2146,7 @@ pysleep(_PyTime_t secs)
         if (PyErr_CheckSignals())
             return -1;
 
-        if (get_monotonic(&monotonic) < 0) {
+        if (_PyTime_GetMonotonicClockWithInfo(&monotonic, NULL) < 0) {
             return -1;
         }
         secs = deadline - monotonic;
@@ -1108,6 +1108,9 @@ _insertdict(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject *value, ch
     if (ix == DKIX_EMPTY) {
         /* Insert into new slot. */
         assert(old_value == NULL);
+        if (rewindLog == 0) {
+            Rewind_DictChanging(mp);
+        }
         if (mp->ma_keys->dk_usable <= 0) {
             /* Need to resize. */
             if (insertion_resize(mp) < 0)
@@ -1131,13 +1134,16 @@ _insertdict(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject *value, ch
         mp->ma_keys->dk_nentries++;
         assert(mp->ma_keys->dk_usable >= 0);
         ASSERT_CONSISTENT(mp);
-        if (rewindLog) {
+        if (rewindLog == 1) {
             Rewind_DictStoreSubscript(mp, key, value);
         }
         return 0;
     }
 
     if (old_value != value) {
+        if (rewindLog == 0) {
+            Rewind_DictChanging(mp);
+        }
         if (_PyDict_HasSplitTable(mp)) {
             mp->ma_values[ix] = value;
             if (old_value == NULL) {
@@ -1151,7 +1157,7 @@ _insertdict(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject *value, ch
             DK_ENTRIES(mp->ma_keys)[ix].me_value = value;
         }
         mp->ma_version_tag = DICT_NEXT_VERSION();
-        if (rewindLog) {
+        if (rewindLog == 1) {
             PyDictKeyEntry entry = DK_ENTRIES(mp->ma_keys)[ix];
             PyObject *existingKey = entry.me_key;
             Rewind_DictStoreSubscript(mp, existingKey, value);
@@ -1664,7 +1670,12 @@ _PyDict_SetItem(PyObject *op, PyObject *key, PyObject *value, char rewindLog)
     }
 
     if (mp->ma_keys == Py_EMPTY_KEYS) {
-        Rewind_DictStoreSubscript(mp, key, value);
+        if (rewindLog == 1) {
+            Rewind_DictStoreSubscript(mp, key, value);
+        }
+        else if (rewindLog == 0) {
+            Rewind_DictChanging(mp);
+        }
         return insert_to_emptydict(mp, key, hash, value);
     }
     /* insertdict() handles any resizing that might be necessary */
@@ -1692,6 +1703,7 @@ _PyDict_SetItem_KnownHash(PyObject *op, PyObject *key, PyObject *value,
     mp = (PyDictObject *)op;
 
     if (mp->ma_keys == Py_EMPTY_KEYS) {
+        Rewind_DictChanging(mp);
         return insert_to_emptydict(mp, key, hash, value);
     }
     /* insertdict() handles any resizing that might be necessary */
@@ -1745,11 +1757,14 @@ __PyDict_DelItem_KnownHash(PyObject *op, PyObject *key, Py_hash_t hash, char rew
         return -1;
     }
 
-    if (rewindLog) {
+    if (rewindLog == 1) {
         PyDictKeyEntry entry = DK_ENTRIES(mp->ma_keys)[ix];
         PyObject *existingKey = entry.me_key;
         Rewind_DictDeleteSubscript(mp, existingKey);
     }
+    else if (rewindLog == 0) {
+        Rewind_DictChanging(mp);
+    }
 
     // Split table doesn't allow deletion.  Combine it.
     if (_PyDict_HasSplitTable(mp)) {
@@ -1835,24 +1850,21 @@ _PyDict_DelItemIf(PyObject *op, PyObject *key,
     hashpos = lookdict_index(mp->ma_keys, hash, ix);
     assert(hashpos >= 0);
 
-    if (res > 0)
+    if (res > 0) {
+        Rewind_DictChanging(mp);
         return delitem_common(mp, hashpos, ix, old_value);
+    }
     else
         return 0;
 }
 
-
-void
-PyDict_Clear(PyObject *op)
+static void
+dict_clear_internal(PyDictObject *mp)
 {
-    PyDictObject *mp;
     PyDictKeysObject *oldkeys;
     PyObject **oldvalues;
     Py_ssize_t i, n;
 
-    if (!PyDict_Check(op))
-        return;
-    mp = ((PyDictObject *)op);
     oldkeys = mp->ma_keys;
     oldvalues = mp->ma_values;
     if (oldvalues == empty_values)
@@ -1878,6 +1890,15 @@ PyDict_Clear(PyObject *op)
     ASSERT_CONSISTENT(mp);
 }
 
+void
+PyDict_Clear(PyObject *op)
+{
+    if (!PyDict_Check(op))
+        return;
+    Rewind_DictChanging((PyDictObject *)op);
+    dict_clear_internal((PyDictObject *)op);
+}
+
 /* Internal version of PyDict_Next that returns a hash value in addition
  * to the key and value.
  * Return 1 on success, return 0 when the reached the end of the dictionary
@@ -1988,6 +2009,9 @@ __PyDict_Pop_KnownHash(PyObject *dict, PyObject *key, Py_hash_t hash, PyObject *
         PyObject *existingKey = entry.me_key;
         Rewind_DictPop(mp, existingKey);
     }
+    else {
+        Rewind_DictChanging(mp);
+    }
 
     // Split table doesn't allow deletion.  Combine it.
     if (_PyDict_HasSplitTable(mp)) {
@@ -2686,6 +2710,8 @@ _dict_merge(PyObject *a, PyObject *b, int override, char rewindLog)
                 if (keys == NULL) {
                     return -1;
                 }
+                /* not logged item by item, even if rewindLog is set */
+                Rewind_DictChanging(mp);
 
                 dictkeys_decref(mp->ma_keys);
                 mp->ma_keys = keys;
@@ -3150,6 +3176,9 @@ _PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj, char rewind
             return NULL;
     }
     if (mp->ma_keys == Py_EMPTY_KEYS) {
+        if (!rewindLog) {
+            Rewind_DictChanging(mp);
+        }
         if (insert_to_emptydict(mp, key, hash, defaultobj) < 0) {
             return NULL;
         }
@@ -3180,6 +3209,9 @@ _PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj, char rewind
     if (ix == DKIX_EMPTY) {
         PyDictKeyEntry *ep, *ep0;
         value = defaultobj;
+        if (!rewindLog) {
+            Rewind_DictChanging(mp);
+        }
         if (mp->ma_keys->dk_usable <= 0) {
             if (insertion_resize(mp) < 0) {
                 return NULL;
@@ -3214,6 +3246,9 @@ _PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj, char rewind
         value = defaultobj;
         assert(_PyDict_HasSplitTable(mp));
         assert(ix == mp->ma_used);
+        if (!rewindLog) {
+            Rewind_DictChanging(mp);
+        }
         Py_INCREF(value);
         MAINTAIN_TRACKING(mp, key, value);
         mp->ma_values[ix] = value;
@@ -3261,7 +3296,7 @@ static PyObject *
 dict_clear(PyDictObject *mp, PyObject *Py_UNUSED(ignored))
 {
     Rewind_DictClear(mp);
-    PyDict_Clear((PyObject *)mp);
+    dict_clear_internal(mp);
     Py_RETURN_NONE;
 }
 
@@ -3393,7 +3428,8 @@ dict_traverse(PyObject *op, visitproc visit, void *arg)
 static int
 dict_tp_clear(PyObject *op)
 {
-    PyDict_Clear(op);
+    /* garbage, which nothing sees again */
+    dict_clear_internal((PyDictObject *)op);
     return 0;
 }
 
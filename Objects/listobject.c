@@ -257,6 +257,7 @@ PyList_SetItem(PyObject *op, Py_ssize_t i,
                         "list assignment index out of range");
         return -1;
     }
+    Rewind_ListChanging((PyListObject *)op);
     p = ((PyListObject *)op) -> ob_item + i;
     Py_XSETREF(*p, newitem);
     return 0;
@@ -298,6 +299,7 @@ PyList_Insert(PyObject *op, Py_ssize_t where, PyObject *newitem)
         PyErr_BadInternalCall();
         return -1;
     }
+    Rewind_ListChanging((PyListObject *)op);
     return ins1((PyListObject *)op, where, newitem);
 }
 
@@ -319,8 +321,10 @@ app1(PyListObject *self, PyObject *v)
 int
 PyList_Append(PyObject *op, PyObject *newitem)
 {
-    if (PyList_Check(op) && (newitem != NULL))
+    if (PyList_Check(op) && (newitem != NULL)) {
+        Rewind_ListChanging((PyListObject *)op);
         return app1((PyListObject *)op, newitem);
+    }
     PyErr_BadInternalCall();
     return -1;
 }
@@ -720,6 +724,7 @@ PyList_SetSlice(PyObject *a, Py_ssize_t ilow, Py_ssize_t ihigh, PyObject *v)
         PyErr_BadInternalCall();
         return -1;
     }
+    Rewind_ListChanging((PyListObject *)a);
     return list_ass_slice((PyListObject *)a, ilow, ihigh, v);
 }
 
@@ -735,6 +740,7 @@ list_inplace_repeat(PyListObject *self, Py_ssize_t n)
         Py_INCREF(self);
         return (PyObject *)self;
     }
+    Rewind_ListChanging(self);
 
     if (n < 1) {
         (void)_list_clear(self);
@@ -777,6 +783,15 @@ list_ass_item(PyListObject *a, Py_ssize_t i, PyObject *v)
     return 0;
 }
 
+/* list_ass_item() for PySequence_SetItem() and PySequence_DelItem(), which
+   no rewind hook logs, unlike list[i] = v */
+static int
+list_sq_ass_item(PyListObject *a, Py_ssize_t i, PyObject *v)
+{
+    Rewind_ListChanging(a);
+    return list_ass_item(a, i, v);
+}
+
 /*[clinic input]
 list.insert
 
@@ -2211,12 +2226,16 @@ list_sort_impl(PyListObject *self, PyObject *keyfunc, int reverse)
     PyObject *result = NULL;            /* guilty until proved innocent */
     Py_ssize_t i;
     PyObject **keys;
+    PyObject **rewindBefore;
+    int rewindModified;
 
     assert(self != NULL);
     assert(PyList_Check(self));
     if (keyfunc == Py_None)
         keyfunc = NULL;
 
+    rewindBefore = Rewind_ListSortBegin(self);
+
     /* The list is temporarily made empty, so that mutations performed
      * by comparison functions can't affect the slice of memory we're
      * sorting (allowing mutations during sorting is a core-dump
@@ -2440,6 +2459,8 @@ list_sort_impl(PyListObject *self, PyObject *keyfunc, int reverse)
     merge_freemem(&ms);
 
 keyfunc_fail:
+    /* Whatever was done to the list during the sort is about to be undone */
+    rewindModified = self->allocated != -1;
     final_ob_item = self->ob_item;
     i = Py_SIZE(self);
     Py_SET_SIZE(self, saved_ob_size);
@@ -2455,7 +2476,7 @@ list_sort_impl(PyListObject *self, PyObject *keyfunc, int reverse)
     }
     Py_XINCREF(result);
 
-    Rewind_ListSort(self);
+    Rewind_ListSort(self, rewindBefore, rewindModified);
 
     return result;
 }
@@ -2501,8 +2522,10 @@ PyList_Reverse(PyObject *v)
         PyErr_BadInternalCall();
         return -1;
     }
-    if (Py_SIZE(self) > 1)
+    if (Py_SIZE(self) > 1) {
+        Rewind_ListChanging(self);
         reverse_slice(self->ob_item, self->ob_item + Py_SIZE(self));
+    }
     return 0;
 }
 
@@ -2717,8 +2740,9 @@ list___init___impl(PyListObject *self, PyObject *iterable)
     assert(self->ob_item != NULL ||
            self->allocated == 0 || self->allocated == -1);
 
-    /* Empty previous contents */
+    /* Empty previous contents; what list_extend() adds is logged */
     if (self->ob_item != NULL) {
+        Rewind_ListChanging(self);
         (void)_list_clear(self);
     }
     if (iterable != NULL) {
@@ -2814,7 +2838,7 @@ static PySequenceMethods list_as_sequence = {
     (ssizeargfunc)list_repeat,                  /* sq_repeat */
     (ssizeargfunc)list_item,                    /* sq_item */
     0,                                          /* sq_slice */
-    (ssizeobjargproc)list_ass_item,             /* sq_ass_item */
+    (ssizeobjargproc)list_sq_ass_item,          /* sq_ass_item */
     0,                                          /* sq_ass_slice */
     (objobjproc)list_contains,                  /* sq_contains */
     (binaryfunc)list_inplace_concat,            /* sq_inplace_concat */
@@ -2203,7 +2203,9 @@ _PyObject_AssertFailed(PyObject *obj, const char *expr, const char *msg,
 void
 _Py_Dealloc(PyObject *op)
 {
-    Rewind_Dealloc(op);
+    if (Rewind_MaybeTracked(op)) {
+        Rewind_Dealloc(op);
+    }
     destructor dealloc = Py_TYPE(op)->tp_dealloc;
 #ifdef Py_TRACE_REFS
     _Py_ForgetReference(op);
@@ -159,6 +159,9 @@ _set_add_entry(PySetObject *so, PyObject *key, Py_hash_t hash, char rewindLog)
     if (rewindLog) {
         Rewind_SetAdd(so, key);
     }
+    else {
+        Rewind_SetChanging(so);
+    }
     so->fill++;
     so->used++;
     entry->key = key;
@@ -333,6 +336,9 @@ _set_discard_entry(PySetObject *so, PyObject *key, Py_hash_t hash, char rewindLo
     if (rewindLog) {
         Rewind_SetDiscard(so, old_key);
     }
+    else {
+        Rewind_SetChanging(so);
+    }
     entry->key = dummy;
     entry->hash = -1;
     so->used--;
@@ -585,6 +591,10 @@ set_merge(PySetObject *so, PyObject *otherset)
     if (other == so || other->used == 0)
         /* a.update(a) or a.update(set()); nothing to do */
         return 0;
+    if (so->fill == 0) {
+        /* the fast paths below don't go through set_add_entry() */
+        Rewind_SetChanging(so);
+    }
     /* Do one big resize at the start, rather than
      * incrementally resizing as we insert new keys.  Expect
      * that there will be no (or few) overlapping keys.
@@ -653,6 +663,8 @@ set_pop(PySetObject *so, PyObject *Py_UNUSED(ignored))
         PyErr_SetString(PyExc_KeyError, "pop from an empty set");
         return NULL;
     }
+    /* set.pop() isn't logged either */
+    Rewind_SetChanging(so);
     while (entry->key == NULL || entry->key==dummy) {
         entry++;
         if (entry > limit)
@@ -894,17 +906,12 @@ set_iter(PySetObject *so)
 }
 
 static int
-_set_update_internal(PySetObject *so, PyObject *other, char rewindLog)
+set_update_internal(PySetObject *so, PyObject *other)
 {
     PyObject *key, *it;
 
-    if (PyAnySet_Check(other)) {
-        int result = set_merge(so, other);
-        if (rewindLog) {
-            Rewind_SetUpdate(so);
-        }
-        return result;
-    }
+    if (PyAnySet_Check(other))
+        return set_merge(so, other);
 
     if (PyDict_CheckExact(other)) {
         PyObject *value;
@@ -926,9 +933,6 @@ _set_update_internal(PySetObject *so, PyObject *other, char rewindLog)
             if (set_add_entry(so, key, hash))
                 return -1;
         }
-        if (rewindLog) {
-            Rewind_SetUpdate(so);
-        }
         return 0;
     }
 
@@ -948,17 +952,18 @@ _set_update_internal(PySetObject *so, PyObject *other, char rewindLog)
     Py_DECREF(it);
     if (PyErr_Occurred())
         return -1;
-
-    if (rewindLog) {
-        Rewind_SetUpdate(so);
-    }
-
     return 0;
 }
 
 static int
-set_update_internal(PySetObject *so, PyObject *other) {
-    return _set_update_internal(so, other, 0);
+_set_update_internal(PySetObject *so, PyObject *other, char rewindLog)
+{
+    PyObject **rewindBefore = rewindLog ? Rewind_SetUpdateBegin(so) : NULL;
+    int result = set_update_internal(so, other);
+    if (rewindLog) {
+        Rewind_SetUpdate(so, rewindBefore);
+    }
+    return result;
 }
 
 static PyObject *
@@ -1205,10 +1210,8 @@ set_ior(PySetObject *so, PyObject *other)
     if (!PyAnySet_Check(other))
         Py_RETURN_NOTIMPLEMENTED;
 
-    if (set_update_internal(so, other))
+    if (_set_update_internal(so, other, 1))
         return NULL;
-    
-    Rewind_SetUpdate(so);
 
     Py_INCREF(so);
     return (PyObject *)so;
@@ -1335,11 +1338,14 @@ set_intersection_update_multi(PySetObject *so, PyObject *args)
 {
     PyObject *tmp;
 
+    PyObject **rewindBefore;
+
     tmp = set_intersection_multi(so, args);
     if (tmp == NULL)
         return NULL;
+    rewindBefore = Rewind_SetUpdateBegin(so);
     set_swap_bodies(so, (PySetObject *)tmp);
-    Rewind_SetUpdate(so);
+    Rewind_SetUpdate(so, rewindBefore);
     Py_DECREF(tmp);
     Py_RETURN_NONE;
 }
@@ -1359,14 +1365,15 @@ static PyObject *
 set_iand(PySetObject *so, PyObject *other)
 {
     PyObject *result;
+    PyObject **rewindBefore;
 
     if (!PyAnySet_Check(other))
         Py_RETURN_NOTIMPLEMENTED;
+    rewindBefore = Rewind_SetUpdateBegin(so);
     result = set_intersection_update(so, other);
+    Rewind_SetUpdate(so, rewindBefore);
     if (result == NULL)
         return NULL;
-    
-    Rewind_SetUpdate(so);
 
     Py_DECREF(result);
     Py_INCREF(so);
@@ -1494,13 +1501,16 @@ static PyObject *
 set_difference_update(PySetObject *so, PyObject *args)
 {
     Py_ssize_t i;
+    PyObject **rewindBefore = Rewind_SetUpdateBegin(so);
 
     for (i=0 ; i<PyTuple_GET_SIZE(args) ; i++) {
         PyObject *other = PyTuple_GET_ITEM(args, i);
-        if (set_difference_update_internal(so, other))
+        if (set_difference_update_internal(so, other)) {
+            Rewind_SetUpdate(so, rewindBefore);
             return NULL;
+        }
     }
-    Rewind_SetUpdate(so);
+    Rewind_SetUpdate(so, rewindBefore);
     Py_RETURN_NONE;
 }
 
@@ -1628,17 +1638,22 @@ set_sub(PySetObject *so, PyObject *other)
 static PyObject *
 set_isub(PySetObject *so, PyObject *other)
 {
+    PyObject **rewindBefore;
+    int result;
+
     if (!PyAnySet_Check(other))
         Py_RETURN_NOTIMPLEMENTED;
-    if (set_difference_update_internal(so, other))
+    rewindBefore = Rewind_SetUpdateBegin(so);
+    result = set_difference_update_internal(so, other);
+    Rewind_SetUpdate(so, rewindBefore);
+    if (result)
         return NULL;
-    Rewind_SetUpdate(so);
     Py_INCREF(so);
     return (PyObject *)so;
 }
 
 static PyObject *
-_set_symmetric_difference_update(PySetObject *so, PyObject *other, char rewindLog)
+set_symmetric_difference_update_internal(PySetObject *so, PyObject *other)
 {
     PySetObject *otherset;
     PyObject *key;
@@ -1695,14 +1710,27 @@ _set_symmetric_difference_update(PySetObject *so, PyObject *other, char rewindLo
         }
     }
 
-    if (rewindLog) {
-        Rewind_SetUpdate(so);
-    }
-
     Py_DECREF(otherset);
     Py_RETURN_NONE;
 }
 
+static PyObject *
+_set_symmetric_difference_update(PySetObject *so, PyObject *other, char rewindLog)
+{
+    PyObject **rewindBefore;
+    PyObject *result;
+
+    if ((PyObject *)so == other)
+        return set_clear(so, NULL);
+
+    rewindBefore = rewindLog ? Rewind_SetUpdateBegin(so) : NULL;
+    result = set_symmetric_difference_update_internal(so, other);
+    if (rewindLog) {
+        Rewind_SetUpdate(so, rewindBefore);
+    }
+    return result;
+}
+
 static PyObject *
 set_symmetric_difference_update(PySetObject *so, PyObject *other) {
     return _set_symmetric_difference_update(so, other, 1);
@@ -2003,8 +2031,10 @@ set_init(PySetObject *self, PyObject *args, PyObject *kwds)
         return -1;
     if (!PyArg_UnpackTuple(args, Py_TYPE(self)->tp_name, 0, 1, &iterable))
         return -1;
-    if (self->fill)
+    if (self->fill) {
+        Rewind_SetChanging(self);
         set_clear_internal(self);
+    }
     self->hash = -1;
     if (iterable == NULL)
         return 0;
@@ -2317,6 +2347,7 @@ PySet_Clear(PyObject *set)
         PyErr_BadInternalCall();
         return -1;
     }
+    Rewind_SetChanging((PySetObject *)set);
     return set_clear_internal((PySetObject *)set);
 }
 
@@ -3,6 +3,7 @@
 #include "pycore_pystate.h"
 #include "rewind.h"
 
+// Record the script given as the first argument, two_sum.py by default.
 int
 main(int argc, char **argv)
 {
@@ -12,11 +13,20 @@ main(int argc, char **argv)
     PyConfig_InitPythonConfig(&config);
     Py_InitializeFromConfig(&config);
     
-    Rewind_Activate();
+    char *filename = argc > 1 ? argv[1] : "two_sum.py";
+    wchar_t *wfilename = Py_DecodeLocale(filename, NULL);
+    if (wfilename == NULL) {
+        fprintf(stderr, "play: cannot decode %s\n", filename);
+        return 1;
+    }
+    Rewind_Activate(wfilename, NULL);
+    PyMem_RawFree(wfilename);
     
-    //PyRun_SimpleStringFlags("print('hello world')", NULL);
-    char filename[] = "two_sum.py";
     FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "play: cannot open %s\n", filename);
+        return 1;
+    }
     PyRun_SimpleFileExFlags(file, filename, 0, NULL);
     fclose(file);
     Rewind_Deactivate();
@@ -8,6 +8,7 @@
 #include "pycore_pyerrors.h"      // _PyErr_NoMemory()
 #include "pycore_pystate.h"       // _PyThreadState_GET()
 #include "pycore_tuple.h"         // _PyTuple_FromArray()
+#include "rewind.h"               // Rewind_InputMode
 
 _Py_IDENTIFIER(__builtins__);
 _Py_IDENTIFIER(__dict__);
@@ -1997,6 +1998,12 @@ builtin_input_impl(PyObject *module, PyObject *prompt)
         }
     }
 
+    /* Lines read by readline aren't reads for rewind to log or replay as
+       inputs of the program, read them from sys.stdin instead */
+    if (Rewind_InputMode != 0) {
+        tty = 0;
+    }
+
     /* If we're interactive, use (GNU) readline */
     if (tty) {
         PyObject *po = NULL;
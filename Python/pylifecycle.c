@@ -3,6 +3,7 @@
 #include "Python.h"
 
 #include "Python-ast.h"
+#include "rewind.h"               // Rewind_Deactivate(), Rewind_FatalError()
 #undef Yield   /* undefine macro conflicting with <winbase.h> */
 
 #include "pycore_ceval.h"         // _PyEval_FiniGIL()
@@ -1639,6 +1640,11 @@ Py_FinalizeEx(void)
     /* Get current thread state and interpreter pointer */
     PyThreadState *tstate = _PyRuntimeState_GetThreadState(runtime);
 
+    /* A program that exits through SystemExit never gets back to where
+       pymain_run_python() stops recording; write out the rest of the log
+       before the interpreter goes. */
+    Rewind_Deactivate();
+
     // Wrap up existing "threading"-module-created, non-daemon threads.
     wait_for_thread_shutdown(tstate);
 
@@ -2554,6 +2560,9 @@ fatal_error(FILE *stream, int header, const char *prefix, const char *msg,
        on abort(). */
     _PyFaulthandler_Fini();
 
+    /* Write out what has been recorded so far */
+    Rewind_FatalError();
+
     /* Check if the current Python thread hold the GIL */
     if (has_tstate_and_gil) {
         /* Flush sys.stdout and sys.stderr */
@@ -27,6 +27,7 @@
 #include "marshal.h"              // PyMarshal_ReadLongFromFile()
 
 #include "parser_interface.h"      // PyParser_ASTFrom*
+#include "rewind.h"               // Rewind_Dump()
 
 #ifdef MS_WINDOWS
 #  include "malloc.h"             // alloca()
@@ -756,6 +757,8 @@ _PyErr_PrintEx(PyThreadState *tstate, int set_sys_last_vars)
     }
 
     /* Now we know v != NULL too */
+    /* Keep what led up to the exception if the flight recorder is on */
+    Rewind_Dump();
     if (set_sys_last_vars) {
         if (_PySys_SetObjectId(&PyId_last_type, exception) < 0) {
             _PyErr_Clear(tstate);
@@ -0,0 +1,351 @@
+"""Benchmark the cost of recording the programs in tests/.
+
+Each program is run with recording off, with recording on and, to import its
+log into a database, through recreate.py, in a scratch copy of tests/ so that
+the logs written there are left alone. For each of these the best wall and
+CPU time out of a few runs and the peak RSS are measured, along with the
+number of events the log holds and its size.
+
+The programs run for a few milliseconds, far less than it takes to start the
+interpreter. So each run runs a program over and over in one process, which
+is recorded as a whole, as many times as it takes for about --time seconds
+of CPU time with recording off (or --loops times), and an empty program is
+run the same number of times, whose CPU times are taken off those of the
+program: overheads and events per second are worked out from what is left,
+the time the program itself takes.
+
+Results can be written to a JSON file and compared against ones written
+before, e.g. with the build before a change to the hooks (the benchmark
+itself is best left unrecorded):
+
+    ./python -X rewind=off Tools/rewindbench/rewindbench.py -w before.json
+    ./python -X rewind=off Tools/rewindbench/rewindbench.py -r before.json
+
+The comparison runs each program as many times over as the results it
+compares against did. It exits with status 1 if any program got slower to
+record or to import, or wrote more bytes per event, by more than the
+threshold, and by more than the noise: how far the runs of the old and new
+results were from the best of them, relative to what was measured. Comparing a build against
+its own results shows how much noise there is; more runs with -n, or longer
+ones with --time, make for less.
+"""
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+sys.path.insert(0, ROOT)
+import rewindlog
+
+# what the interactive programs are given on stdin; they may well end on
+# EOFError once it runs out, which is measured like any other exit
+STDIN = {
+    "rpg.py": "3\n",
+    "convert_points.py": "3\n1\n2\n3\n4\n5\n6\n1\ny\n",
+    "shape_calculator.py": "1\n1\n3\n4\n\n",
+}
+# programs that only run in a terminal
+SKIP = {"ascii_draw.py", "ascii_draw2.py"}
+# the empty program whose times are taken off those of the others
+EMPTY = "rewindbench_empty.py"
+# most times a run runs a program over
+MAX_LOOPS = 100000
+# runs to take the best of when working out how many times over to run
+COUNT_REPEAT = 3
+# runs the program it is given a number of times, recorded into RUNNER_LOG
+RUNNER = "rewindbench_run.py"
+RUNNER_LOG = "rewindbench_run.rewind"
+RUNNER_SOURCE = """\
+import sys, time
+name, loops = sys.argv[1], int(sys.argv[2])
+# rpg.py pauses for effect, which would only make the runs take longer
+time.sleep = lambda seconds: None
+# compiled once, so that the runs time the program rather than compiling it
+with open(name, "rb") as file:
+    code = compile(file.read(), name, "exec")
+for i in range(loops):
+    try:
+        exec(code, {"__name__": "__main__", "__file__": name,
+                    "__builtins__": __builtins__})
+    except (Exception, SystemExit):
+        pass
+"""
+
+# Metrics compared against earlier results, all of which get worse as they
+# grow. Overheads are relative to the run with recording off, which makes
+# them comparable across machines.
+COMPARED = [
+    ("record_overhead", "record CPU time / CPU time"),
+    ("import_overhead", "import CPU time / CPU time"),
+    ("bytes_per_event", "bytes per event"),
+]
+
+
+def run(args, cwd, stdin):
+    """Run args once, returning the wall time, CPU time and peak RSS (in
+    kilobytes) of the process and its exit status."""
+    start = time.perf_counter()
+    process = subprocess.Popen(args, cwd=cwd, stdin=subprocess.PIPE,
+                               stdout=subprocess.DEVNULL,
+                               stderr=subprocess.DEVNULL)
+    try:
+        process.stdin.write(stdin.encode())
+        process.stdin.close()
+    except BrokenPipeError:
+        pass
+    pid, status, usage = os.wait4(process.pid, 0)
+    wall = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    return {
+        "wall": wall,
+        "cpu": usage.ru_utime + usage.ru_stime,
+        "peak_rss_kb": usage.ru_maxrss,
+        "status": process.returncode,
+    }
+
+
+def best_of(repeat, args, cwd, stdin=""):
+    runs = [run(args, cwd, stdin) for i in range(repeat)]
+    cpu = sorted(r["cpu"] for r in runs)
+    return {
+        "wall": min(r["wall"] for r in runs),
+        "cpu": cpu[0],
+        # how far the median run was from the best, for the noise in what
+        # is worked out from them; the slowest runs, held up by whatever
+        # else the machine was doing, would make it look much noisier
+        "cpu_spread": cpu[len(cpu) // 2] - cpu[0],
+        "peak_rss_kb": max(r["peak_rss_kb"] for r in runs),
+        "status": runs[-1]["status"],
+    }
+
+
+def take_off(result, empty):
+    """Set the CPU time of result less that of the empty program, in
+    result["net_cpu"], and the noise in it in result["net_cpu_spread"]."""
+    result["net_cpu"] = max(result["cpu"] - empty["cpu"], 0)
+    result["net_cpu_spread"] = result["cpu_spread"] + empty["cpu_spread"]
+
+
+def ratio(a, b):
+    """a's net CPU time over b's, and the noise in it, relative to it; None
+    for both if b took no time that could be measured."""
+    if b["net_cpu"] <= b["net_cpu_spread"] or not a["net_cpu"]:
+        return None, None
+    noise = (a["net_cpu_spread"] / a["net_cpu"]
+             + b["net_cpu_spread"] / b["net_cpu"])
+    return a["net_cpu"] / b["net_cpu"], noise
+
+
+def count_events(filename):
+    """The number of events in the .rewind log in filename, found from the
+    header of its last block and the events in it."""
+    with open(filename, "rb") as file:
+        reader = rewindlog.LogReader(file)
+        blocks = list(reader.blocks())
+        if not blocks:
+            return 0
+        count = blocks[-1].first_event
+        in_checkpoint = False
+        for name, args in reader.events(blocks[-1]):
+            if name == "CHECKPOINT":
+                in_checkpoint = True
+            elif name == "CHECKPOINT_END":
+                in_checkpoint = False
+            elif not in_checkpoint and name != "LOG":
+                count += 1
+        return count
+
+
+def count_loops(python, name, directory, seconds):
+    """How many times over a run must run the program name in directory for
+    it to take about seconds of CPU time with recording off, besides what
+    starting the interpreter takes."""
+    startup = best_of(COUNT_REPEAT, [python, "-X", "rewind=off", RUNNER,
+                                     EMPTY, "1"], directory)["cpu"]
+    loops = 1
+    while True:
+        cpu = best_of(COUNT_REPEAT, [python, "-X", "rewind=off", RUNNER, name,
+                                     str(loops)], directory,
+                      STDIN.get(name, "") * loops)["cpu"] - startup
+        if cpu >= seconds / 10 or loops >= MAX_LOOPS:
+            break
+        loops *= 10
+    if cpu <= 0:
+        return MAX_LOOPS
+    return max(1, min(MAX_LOOPS, round(loops * seconds / cpu)))
+
+
+def bench_runs(python, name, directory, options, repeat, loops):
+    """Run the program name in directory loops times over, off, recorded
+    and through recreate.py."""
+    stdin = STDIN.get(name, "") * loops
+    log = os.path.join(directory, RUNNER_LOG)
+    program = [RUNNER, name, str(loops)]
+    off = best_of(repeat, [python, "-X", "rewind=off"] + program, directory,
+                  stdin)
+    record = best_of(repeat, [python, "-X", "rewind=" + options] + program,
+                     directory, stdin)
+    log_bytes = os.path.getsize(log)
+    events = count_events(log)
+    record["events"] = events
+    record["log_bytes"] = log_bytes
+    recreate = best_of(repeat, [python, "-X", "rewind=off",
+                                os.path.join(ROOT, "recreate.py"), log],
+                       directory)
+    return {
+        "off": off,
+        "record": record,
+        "import": recreate,
+    }
+
+
+def bench_program(python, name, directory, options, repeat, loops):
+    """Run the program name, and the empty program, in directory loops times
+    over, off, recorded and through recreate.py, and work out what the
+    program itself takes."""
+    result = bench_runs(python, name, directory, options, repeat, loops)
+    empty = bench_runs(python, EMPTY, directory, options, repeat, loops)
+    for run in ("off", "record", "import"):
+        take_off(result[run], empty[run])
+    record = result["record"]
+    # which the empty program has some of too, logged as the runner runs
+    events = record["events"] - empty["record"]["events"]
+    log_bytes = record["log_bytes"] - empty["record"]["log_bytes"]
+    record["events_per_second"] = (events / record["net_cpu"]
+                                   if record["net_cpu"] else 0)
+    result["loops"] = loops
+    result["empty"] = empty
+    result["bytes_per_event"] = log_bytes / events if events > 0 else 0
+    result["bytes_per_event_noise"] = 0
+    for run in ("record", "import"):
+        result[run + "_overhead"], result[run + "_overhead_noise"] = \
+            ratio(result[run], result["off"])
+    return result
+
+
+def compare(old, new, threshold):
+    """Print how the results in new compare to those in old, and return the
+    number of regressions beyond threshold (a fraction) and the noise in
+    either."""
+    regressions = 0
+    print("\nComparing new vs. old\n")
+    for name, results in new["programs"].items():
+        if name not in old["programs"] or "skipped" in results:
+            continue
+        for metric, label in COMPARED:
+            before = old["programs"][name].get(metric)
+            after = results.get(metric)
+            if not before or after is None:
+                print("%-36s %-28s too short to measure" % (name, label))
+                continue
+            change = after / before - 1
+            noise = (old["programs"][name].get(metric + "_noise", 0)
+                     + results[metric + "_noise"])
+            flag = ""
+            if change > threshold and change > noise:
+                flag = "  REGRESSION"
+                regressions += 1
+            print("%-36s %-28s %10.3f vs. %10.3f (%+.1f%%, noise %.1f%%)%s"
+                  % (name, label, after, before, change * 100, noise * 100,
+                     flag))
+    return regressions
+
+
+def format_ratio(value):
+    return "%9.2f" % value if value is not None else "%9s" % "n/a"
+
+
+def main(options):
+    tests = options.tests
+    names = options.programs or sorted(
+        name for name in os.listdir(tests) if name.endswith(".py"))
+    old = None
+    if options.source_file:
+        with options.source_file:
+            old = json.load(options.source_file)
+    results = {
+        "python": options.python,
+        "options": options.options,
+        "repeat": options.repeat,
+        "programs": {},
+    }
+    print("%-36s %6s %9s %9s %9s %9s %10s %8s %9s %9s"
+          % ("program", "loops", "off (s)", "rec (s)", "wall (s)", "overhead",
+             "events/s", "B/event", "RSS (MB)", "import (s)"))
+    with tempfile.TemporaryDirectory() as directory:
+        for name in os.listdir(tests):
+            if name.endswith(".py"):
+                shutil.copy(os.path.join(tests, name), directory)
+        with open(os.path.join(directory, EMPTY), "w"):
+            pass
+        with open(os.path.join(directory, RUNNER), "w") as file:
+            file.write(RUNNER_SOURCE)
+        for name in names:
+            if name in SKIP:
+                results["programs"][name] = {"skipped": "needs a terminal"}
+                print("%-36s skipped, needs a terminal" % name)
+                continue
+            loops = options.loops
+            if old is not None and "loops" in old["programs"].get(name, {}):
+                loops = old["programs"][name]["loops"]
+            elif loops is None:
+                loops = count_loops(options.python, name, directory,
+                                    options.time)
+            result = bench_program(options.python, name, directory,
+                                   options.options, options.repeat, loops)
+            results["programs"][name] = result
+            print("%-36s %6d %9.3f %9.3f %9.3f %s %10.0f %8.2f %9.1f %9.3f"
+                  % (name, loops, result["off"]["net_cpu"],
+                     result["record"]["net_cpu"],
+                     result["record"]["wall"],
+                     format_ratio(result["record_overhead"]),
+                     result["record"]["events_per_second"],
+                     result["bytes_per_event"],
+                     result["record"]["peak_rss_kb"] / 1024,
+                     result["import"]["net_cpu"]))
+            sys.stdout.flush()
+    if options.dest_file:
+        with options.dest_file:
+            json.dump(results, options.dest_file, indent=2)
+    if old is not None:
+        if compare(old, results, options.threshold / 100):
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Benchmark recording and importing the programs in tests/.")
+    parser.add_argument('programs', nargs='*',
+                        help='programs in tests/ to run, all by default')
+    parser.add_argument('-p', '--python', default=sys.executable,
+                        help='interpreter to run them with')
+    parser.add_argument('-t', '--tests', default=os.path.join(ROOT, "tests"),
+                        help='directory the programs are in')
+    parser.add_argument('-o', '--options', default='',
+                        help='recording options, as for -X rewind=')
+    parser.add_argument('-n', '--repeat', type=int, default=10,
+                        help='runs of each program to take the best of')
+    parser.add_argument('--time', type=float, default=0.2,
+                        help='seconds of CPU time each run of a program should '
+                             'take with recording off, besides starting up')
+    parser.add_argument('-l', '--loops', type=int,
+                        help='times each run runs the program over, instead '
+                             'of as many as --time takes')
+    parser.add_argument('-r', '--read', dest='source_file',
+                        type=argparse.FileType('r'),
+                        help='file to read benchmark data from to compare '
+                             'against')
+    parser.add_argument('-w', '--write', dest='dest_file',
+                        type=argparse.FileType('w'),
+                        help='file to write benchmark data to')
+    parser.add_argument('--threshold', type=float, default=10,
+                        help='percentage by which a compared metric may grow '
+                             'before it counts as a regression, if it grew '
+                             'by more than the noise as well')
+    main(parser.parse_args())
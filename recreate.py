@@ -92,6 +92,15 @@
 import os.path
 import re
 import sys
+import tempfile
+import zlib
+from concurrent.futures import ProcessPoolExecutor
+from rewindlog import BLOCK_CHECKPOINT, BLOCK_RESYNC, read_blocks, read_log, replay_log
+try:
+    # the same as recreate_past, only much faster
+    from _rewindimport import recreate as recreate_native
+except ImportError:
+    recreate_native = None
 
 def define_schema(conn):
     c = conn.cursor()
@@ -113,7 +122,10 @@ def define_schema(conn):
     c.execute("""
         create table Object (
             id integer primary key,
-            data text  -- JSONR format
+            data text,  -- JSONR format
+            chunked integer  -- 1 if data is a list of references (*id) to
+                             -- the objects whose items, one after the
+                             -- other, are the items of this one
         );
     """)
 
@@ -127,6 +139,7 @@ def define_schema(conn):
             closure_freevars text, -- json-like object
             parent_id integer,
             code_file_id integer,
+            thread_id integer, -- id of the thread state that made the call
             
             constraint FunCall_fk_parent_id foreign key (parent_id)
                 references FunCall(id)
@@ -155,6 +168,34 @@ def define_schema(conn):
         );
     """)
 
+    c.execute("""
+        create table VariableChange (
+            fun_call_id integer, -- the call the variable is local to, the
+                                 -- module's for a global
+            name text,
+            heap_version integer, -- the HeapRef version the change made
+
+            constraint VariableChange_pk
+                PRIMARY KEY (fun_call_id, name, heap_version)
+        ) without rowid;
+    """)
+
+    c.execute("""
+        create table Elision (
+            snapshot_id integer, -- the last step before what was left out
+            fun_call_id integer, -- the call that made the calls or ran the
+                                 -- loop left out
+            fun_name text, -- the function called, or running the loop
+            calls integer,
+            iterations integer, -- 0 for calls
+
+            constraint Elision_fk_snapshot_id foreign key (snapshot_id)
+                references Snapshot(id)
+            constraint Elision_fk_fun_call_id foreign key (fun_call_id)
+                references FunCall(id)
+        );
+    """)
+
     c.execute("""
         create table Error (
             id integer primary key,
@@ -164,46 +205,42 @@ def define_schema(conn):
 
     conn.commit()
 
-NUMBER_REGEX = r"-?(?:(?:[1-9][0-9]*)|[0-9])(?:\.[0-9]+)?"
-CHAR_REGEX = r"[^'\\]|(?:\\(?:['\\ntr]|x[0-9A-Fa-f]{2}))"
-CHAR2_REGEX = r"[^\"\\]|(?:\\(?:[\"\\ntr]|x[0-9A-Fa-f]{2}))"
-STRING_REGEX = r"(?:'(?:%s)*')|(?:\"(?:%s)*\")" % (CHAR_REGEX, CHAR2_REGEX)
-BOOLEAN_REGEX = r"True|False"
-REF_REGEX = r"\*[0-9]+"
-NONE_REGEX = r"None"
-ARGUMENT_REGEX = re.compile("(%s|%s|%s|%s|%s)[,)]" % (
-    NUMBER_REGEX,
-    STRING_REGEX,
-    BOOLEAN_REGEX,
-    REF_REGEX,
-    NONE_REGEX
-))
-LINE_START_REGEX = re.compile(r"([A-Z_]+)\(")
-
-def parse_value(value):
-    if value[0] == "*":
-        return HeapRef(int(value[1:]))
-    else:
-        return eval(value)
-
-def parse_line(line):
-    args = []
-    m = LINE_START_REGEX.match(line)
-    fun_name = m.group(1)
-    start_idx = m.span()[1]
-    while True:
-        m = ARGUMENT_REGEX.match(line, start_idx)
-        if m is None:
-            raise Exception("Parse error on line '%s' at %d" % (line, start_idx))
-        value = parse_value(m.group(1))
-        args.append(value)
-        if m.span()[1] == len(line):
-            break
-        if line[m.span()[1]] == "\n":
-            break 
-        assert line[m.span()[1]] == " "
-        start_idx = m.span()[1] + 1
-    return (fun_name, args)
+# Indexes rewindquery.py looks changes up by, created once the tables are
+# filled, which is faster than keeping them up to date along the way. With
+# HeapRef's primary key, which orders the versions of each object, they
+# take the versions of an object or a variable to the steps that made them.
+def define_indexes(conn):
+    c = conn.cursor()
+
+    c.execute("create index Snapshot_heap on Snapshot (heap)")
+
+    conn.commit()
+
+# A list, tuple, set or dict with more than CHUNK_MAX items is saved in
+# chunks, which are shared by its versions: the object is a chunked Object
+# of the chunks its items are split into, or of the chunked Objects these
+# are split into in turn, until there are at most CHUNK_MAX of them. An item
+# ends a chunk when the chunk has CHUNK_MAX items, or at least CHUNK_MIN and
+# the CRC-32 of the item as serialized has none of the CHUNK_MASK bits set.
+# Chunks end at the same items wherever they are in the object, so a change
+# to the object gives new chunks only around the change, and the same
+# chunk is saved once.
+CHUNK_MIN = 4
+CHUNK_MAX = 64
+CHUNK_MASK = 15
+
+def split_chunks(entries):
+    chunks = []
+    start = 0
+    for i, entry in enumerate(entries):
+        length = i + 1 - start
+        if (length == CHUNK_MAX or length >= CHUNK_MIN and
+                zlib.crc32(entry.encode("utf-8")) & CHUNK_MASK == 0):
+            chunks.append(entries[start:i + 1])
+            start = i + 1
+    if start < len(entries):
+        chunks.append(entries[start:])
+    return chunks
 
 class ObjectRef(object):
     def __init__(self, id):
@@ -232,7 +269,12 @@ def __hash__(self):
         return self.id
 
 
-def recreate_past(conn, filename):
+# Returns a dict of what the import ended with, for recreate_parallel():
+# under "stacks", the ids of the calls not yet returned from, outermost
+# first, by thread id, and under "checkpoint", when start_event is given,
+# the heap version and the number of FunCall rows once the checkpoint it
+# starts from is replayed.
+def recreate_past(conn, filename, start_event=None, stop_event=None):
 
     fun_lookup = {}
     
@@ -245,7 +287,8 @@ def __init__(self,
             cell_vars,
             free_vars,
             parent,
-            code_file_id):
+            code_file_id,
+            thread_id):
             self.id = id
             self.name = name
             self.local_varnames = local_varnames
@@ -255,9 +298,10 @@ def __init__(self,
             self.free_vars = free_vars
             self.parent = parent
             self.code_file_id = code_file_id
+            self.thread_id = thread_id
 
         def save(self, cursor):
-            cursor.execute("INSERT INTO FunCall VALUES (?, ?, ?, ?, ?, ?, ?, ?)", (
+            cursor.execute("INSERT INTO FunCall VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)", (
                 self.id,
                 self.name,
                 self.local_vars_id,
@@ -265,7 +309,8 @@ def save(self, cursor):
                 serialize(self.cell_vars),
                 serialize(self.free_vars),
                 self.parent and self.parent.id,
-                self.code_file_id
+                self.code_file_id,
+                self.thread_id
             ))
 
         def __repr__(self):
@@ -340,6 +385,35 @@ def serialize(value):
         else:
             return serialize_member(value)
 
+    def save_chunk(data, chunked):
+        key = (data, chunked)
+        oid = chunk_oids.get(key)
+        if oid is None:
+            oid = new_obj_id()
+            cursor.execute("INSERT INTO Object VALUES (?, ?, ?)", (
+                oid,
+                data,
+                chunked
+            ))
+            chunk_oids[key] = oid
+        return oid
+
+    def save_chunked(obj):
+        if isinstance(obj, dict):
+            entries = list(map(format_key_value_pair, obj.items()))
+            start, end = "{", "}"
+        else:
+            entries = list(map(serialize_member, obj))
+            start, end = "[", "]"
+        oids = [save_chunk(start + ", ".join(chunk) + end, None)
+                for chunk in split_chunks(entries)]
+        while True:
+            entries = ["*" + str(oid) for oid in oids]
+            if len(entries) <= CHUNK_MAX:
+                return save_chunk("[" + ", ".join(entries) + "]", 1)
+            oids = [save_chunk("[" + ", ".join(chunk) + "]", 1)
+                    for chunk in split_chunks(entries)]
+
     def save_object(obj):
         nonlocal object_id_to_immutable_id_dict
         oid = None
@@ -350,14 +424,18 @@ def save_object(obj):
         if obj == empty_set:
             oid =  empty_set_oid
 
-        if oid is None:
+        if oid is None and isinstance(obj, (list, tuple, set, dict)) and len(obj) > CHUNK_MAX:
+            oid = save_chunked(obj)
+            object_id_to_immutable_id_dict[id(obj)] = oid
+        elif oid is None:
             oid = new_obj_id()
             object_id_to_immutable_id_dict[id(obj)] = oid
             if isinstance(obj, dict) and "global_test_module" in obj:
                 raise "here"
-            cursor.execute("INSERT INTO Object VALUES (?, ?)", (
+            cursor.execute("INSERT INTO Object VALUES (?, ?, ?)", (
                 oid,
-                serialize(obj)
+                serialize(obj),
+                None
             ))
         else:
             object_id_to_immutable_id_dict[id(obj)] = oid
@@ -368,9 +446,10 @@ def _save_object(obj, oid):
         nonlocal object_id_to_immutable_id_dict
         
         object_id_to_immutable_id_dict[id(obj)] = oid
-        cursor.execute("INSERT INTO Object VALUES (?, ?)", (
+        cursor.execute("INSERT INTO Object VALUES (?, ?, ?)", (
             oid,
-            serialize(obj)
+            serialize(obj),
+            None
         ))
         return oid
     
@@ -389,13 +468,26 @@ def update_heap_object(heap_id, new_obj):
             oid
         ))
 
-    def ensure_code_file_saved(filename, name):
+    def save_variable_change(fun_call_id, name):
+        # the names STORE_NAME and STORE_GLOBAL give are heap strings
+        if isinstance(name, HeapRef):
+            name = heap_id_to_object_dict[name.id]
+        if not isinstance(name, str):
+            return
+        cursor.execute("INSERT INTO VariableChange VALUES (?, ?, ?)", (
+            fun_call_id,
+            name,
+            heap_version
+        ))
+
+    def ensure_code_file_saved(filename):
         nonlocal activate_snapshots
         nonlocal next_code_file_id
 
         if filename not in code_files and os.path.isfile(filename):
-            if not activate_snapshots and name == "<module>":
-                activate_snapshots = True
+            # frozen code, such as the loader that runs a script, makes no
+            # steps before the first code from a source file
+            activate_snapshots = True
             the_file = open(filename, "r")
             content = the_file.read()
             the_file.close()
@@ -408,12 +500,6 @@ def ensure_code_file_saved(filename, name):
             ))
             code_files[filename] = code_file_id
 
-    def grab_var_args(a_list):
-        num_args = a_list[0]
-        args = a_list[1:1 + num_args]
-        rest = a_list[1 + num_args:]
-        return num_args, args, rest
-
     def gen_var_dict(varnames, values):
         var_dict = {}
         for i in range(len(varnames)):
@@ -422,25 +508,26 @@ def gen_var_dict(varnames, values):
             var_dict[varname] = value
         return var_dict
 
-    def process_push_frame(filename, name, global_vars_id, local_vars_id, *rest):
+    def process_push_frame(code, global_vars_id, local_vars_id, *values):
         nonlocal stack
         
-        num_local_vars, local_varnames, rest = grab_var_args(rest)
-        num_cell_vars, cell_varnames, rest = grab_var_args(rest)
-        num_free_vars, free_varnames, rest = grab_var_args(rest)
+        filename = code.filename
+        name = code.name
+        local_varnames = code.varnames
+        num_local_vars = len(local_varnames)
+        num_cell_vars = len(code.cellvars)
 
-        local_vars = rest[0:num_local_vars]
-        rest = rest[num_local_vars:]
-        cell_vars = rest[0:num_cell_vars]
-        free_vars = rest[num_cell_vars:]
+        local_vars = values[0:num_local_vars]
+        cell_vars = values[num_local_vars:num_local_vars + num_cell_vars]
+        free_vars = values[num_local_vars + num_cell_vars:]
 
         local_var_dict = gen_var_dict(local_varnames, local_vars)
-        cell_var_dict = gen_var_dict(cell_varnames, cell_vars)
-        free_var_dict = gen_var_dict(free_varnames, free_vars)
+        cell_var_dict = gen_var_dict(code.cellvars, cell_vars)
+        free_var_dict = gen_var_dict(code.freevars, free_vars)
 
         #print("push_frame", name, "cell_var_dict", cell_var_dict, "free_var_dict", free_var_dict)
 
-        ensure_code_file_saved(filename, name)
+        ensure_code_file_saved(filename)
         code_file_id = code_files.get(filename)
 
         update_heap_object(local_vars_id, local_var_dict)
@@ -454,9 +541,15 @@ def process_push_frame(filename, name, global_vars_id, local_vars_id, *rest):
             cell_var_dict,
             free_var_dict,
             stack,
-            code_file_id
+            code_file_id,
+            thread
         )
         fun_call.save(cursor)
+        if name == "<module>":
+            module_calls[global_vars_id] = fun_call.id
+        for varname, value in local_var_dict.items():
+            if value is not None:
+                save_variable_change(fun_call.id, varname)
 
         stack = fun_call
     
@@ -465,7 +558,8 @@ def process_push_frame(filename, name, global_vars_id, local_vars_id, *rest):
     def process_visit(line_no):
         nonlocal curr_line_no
         curr_line_no = line_no
-        if not activate_snapshots:
+        # the line a checkpoint gives isn't a step
+        if not activate_snapshots or in_checkpoint:
             return
         cursor.execute("INSERT INTO Snapshot VALUES (?, ?, ?, ?, ?)", (
             new_snapshot_id(), 
@@ -482,16 +576,36 @@ def process_store_name(heap_id, name, value):
         new_ns = ns.copy()
         new_ns[name] = value
         update_heap_object(heap_id, new_ns)
+        # with no call on the stack, as when recording started in the middle
+        # of a module, the name goes to the call of the module if there is
+        # one, and is left out of VariableChange otherwise
+        fun_call_id = stack.id if stack else module_calls.get(heap_id)
+        if fun_call_id is not None:
+            save_variable_change(fun_call_id, name)
 
     fun_lookup["STORE_NAME"] = process_store_name
-    fun_lookup["STORE_GLOBAL"] = process_store_name
+
+    def process_store_global(heap_id, name, value):
+        ns = heap_id_to_object_dict[heap_id]
+        new_ns = ns.copy()
+        new_ns[name] = value
+        update_heap_object(heap_id, new_ns)
+        fun_call_id = module_calls.get(heap_id, stack and stack.id)
+        if fun_call_id is not None:
+            save_variable_change(fun_call_id, name)
+
+    fun_lookup["STORE_GLOBAL"] = process_store_global
     
     def process_store_fast(index, value):
+        # the variables of a frame the log never pushed are not known
+        if stack is None:
+            return
         varname = stack.local_varnames[index]
         local_vars = heap_id_to_object_dict[stack.local_vars_id]
         new_local_vars = local_vars.copy()
         new_local_vars[varname] = value
         update_heap_object(stack.local_vars_id, new_local_vars)
+        save_variable_change(stack.id, varname)
     
     fun_lookup["STORE_FAST"] = process_store_fast
 
@@ -530,7 +644,7 @@ def process_pop_frame(filename, name):
             assert stack.name == name
             stack = stack.parent
         except:
-            print(log_line_no, curr_line_no, line)
+            print(event_no, curr_line_no)
             print("expected:", filename, name)
             print("Got:", stack[0].fun_call)
             raise "stack function names not matching"
@@ -645,6 +759,27 @@ def process_list_sort(heap_id, *new_list):
     
     fun_lookup["LIST_SORT"] = process_list_sort
 
+    # the sorted list is given as runs of items of the list before, each
+    # as the index of its first item and its length
+    def process_list_permute(heap_id, *runs):
+        a_list = heap_id_to_object_dict[heap_id]
+        new_list = []
+        for i in range(0, len(runs), 2):
+            start = runs[i]
+            new_list.extend(a_list[start:start + runs[i + 1]])
+        update_heap_object(heap_id, new_list)
+
+    fun_lookup["LIST_PERMUTE"] = process_list_permute
+
+    # the items from start up to stop replaced by those given, for changes
+    # made to the list without its methods
+    def process_list_splice(heap_id, start, stop, *items):
+        a_list = heap_id_to_object_dict[heap_id]
+        new_list = a_list[:start] + list(items) + a_list[stop:]
+        update_heap_object(heap_id, new_list)
+
+    fun_lookup["LIST_SPLICE"] = process_list_splice
+
     def process_string_inplace_add_result(heap_id, string):
         update_heap_object(heap_id, string)
 
@@ -703,7 +838,16 @@ def process_new_set(heap_id, *items):
         update_heap_object(heap_id, a_set)
     
     fun_lookup["NEW_SET"] = process_new_set
-    fun_lookup["SET_UPDATE"] = process_new_set
+
+    def process_set_update(heap_id, num_added, *rest):
+        added = rest[:num_added]
+        removed = rest[num_added + 1:]
+        a_set = heap_id_to_object_dict[heap_id]
+        new_set = a_set.difference(removed)
+        new_set.update(added)
+        update_heap_object(heap_id, new_set)
+
+    fun_lookup["SET_UPDATE"] = process_set_update
 
     def process_set_add(heap_id, item):
         a_set = heap_id_to_object_dict[heap_id]
@@ -742,6 +886,59 @@ def process_store_attr(heap_id, name, value):
         update_heap_object(heap_id, new_obj)
 
     fun_lookup["STORE_ATTR"] = process_store_attr
+
+    # the events from here on come from the thread with id thread_id, which
+    # has a stack of its own
+    def process_thread(thread_id):
+        nonlocal stack, thread
+        stacks[thread] = stack
+        thread = thread_id
+        stack = stacks.get(thread_id)
+
+    fun_lookup["THREAD"] = process_thread
+
+    # only replays of the program take inputs
+    def process_input(source, value):
+        pass
+
+    fun_lookup["INPUT"] = process_input
+
+    # calls or loop iterations sampling left out, after the last step
+    def process_elided(code, calls, iterations):
+        cursor.execute("INSERT INTO Elision VALUES (?, ?, ?, ?, ?)", (
+            next_snapshot_id - 1 or None,
+            stack and stack.id,
+            code.name,
+            calls,
+            iterations
+        ))
+
+    fun_lookup["ELIDED"] = process_elided
+
+    # a checkpoint restates the heap and the stacks as they are before the
+    # event with index next_event
+    def process_checkpoint(next_event):
+        nonlocal stack, thread, checkpoint_next_event, in_checkpoint
+        stacks.clear()
+        stack = None
+        thread = None
+        checkpoint_next_event = next_event
+        in_checkpoint = True
+
+    fun_lookup["CHECKPOINT"] = process_checkpoint
+
+    def process_checkpoint_end():
+        nonlocal event_no, start_checkpoint, in_checkpoint, activate_snapshots
+        # count events as if replaying from the start
+        event_no = checkpoint_next_event
+        in_checkpoint = False
+        # the program is running, as a segment or a recording started from
+        # running code takes it up
+        activate_snapshots = True
+        if start_event is not None and start_checkpoint is None:
+            start_checkpoint = (heap_version, next_fun_call_id - 1)
+
+    fun_lookup["CHECKPOINT_END"] = process_checkpoint_end
             
     activate_snapshots = False
     cursor = conn.cursor()
@@ -750,50 +947,271 @@ def process_store_attr(heap_id, name, value):
     next_object_id = 1
     next_code_file_id = 1
     code_files = {}
+    # the innermost call of the thread the current event comes from, and
+    # those of the other threads by thread id
     stack = None
+    thread = None
+    stacks = {}
+    # heap ID of a module's globals => id of the FunCall that ran the module
+    module_calls = {}
     # memory address in original program (heap ID) => object in this program
     heap_id_to_object_dict = {}
     # memory address in this program => immutable object ID
     object_id_to_immutable_id_dict = {}
     # memory address in original program (heap ID) => immutable object ID
     heap_version = 1
+    # (data, chunked) => object ID of a chunk
+    chunk_oids = {}
 
     curr_line_no = None
-    log_line_no = 0
+    event_no = 0
+    checkpoint_next_event = 0
+    in_checkpoint = False
+    start_checkpoint = None
     empty_list_oid = _save_object([], new_obj_id())
     empty_dict_oid = _save_object({}, new_obj_id())
     empty_set = set()
     empty_set_oid = _save_object(empty_set, new_obj_id())
     
-    file = open(filename, "r")
-    for line in file:
-        log_line_no += 1
-        if log_line_no % 100 == 0:
-            print("\rLine " + str(log_line_no), end='')
-        if line.startswith("--"):
-            continue
-        command = parse_line(line)
+    if start_event is None:
+        commands = read_log(filename, HeapRef, stop_event=stop_event)
+    else:
+        commands = replay_log(filename, start_event, HeapRef, stop_event)
+    for command in commands:
+        event_no += 1
+        if event_no % 100 == 0:
+            print("\rEvent " + str(event_no), end='')
         if command[0] not in fun_lookup:
-            print("Warning: no process function for command %s on line %d" % (command[0], log_line_no))
+            print("Warning: no process function for command %s on event %d" % (command[0], event_no))
             continue
         fun = fun_lookup[command[0]]
         try:
             fun(*command[1])
-            if log_line_no % 500 == 0:
+            if event_no % 500 == 0:
                 conn.commit()
         except Exception as e:
             print()
-            print("Exception caught on line", log_line_no, line)
+            print("Exception caught on event", event_no, command)
             raise e
     conn.commit()
-    print()
-    print("Complete")
+
+    stacks[thread] = stack
+    calls = {}
+    for thread_id, call in stacks.items():
+        ids = []
+        while call is not None:
+            ids.append(call.id)
+            call = call.parent
+        if ids:
+            calls[thread_id] = ids[::-1]
+    return {"stacks": calls, "checkpoint": start_checkpoint}
+
+# The log can be recreated in segments that start at checkpoints, each by a
+# worker process of its own into a database of its own, which are then
+# merged in order. A segment is recreated as recreating the past from its
+# checkpoint on gives it, up to the block the next segment starts at; it
+# has its own ids, from 1 up, and its own heap versions. Merging moves them
+# past those of the segments before, and drops what the segment's
+# checkpoint restates: the heap versions and variable changes it gives,
+# and the calls it pushes, which are those still on the stacks at the end
+# of the segment before, unless it is a resync checkpoint, after which the
+# stacks start anew as they do when the log is recreated in one go.
+#
+# Chunks are not shared across segments, and a global set after the module
+# it is in has run is recorded under the call that sets it when the module
+# ran in an earlier segment.
+
+def split_segments(filename, count, start_event=None):
+    """Returns the (start_event, stop_event, resync) of up to count segments
+    to recreate the log in filename in, of about as many bytes of the log
+    each, from the event start_event on, or from the start if None; resync
+    is whether the checkpoint a segment after the first starts at is a
+    resync one."""
+    blocks = read_blocks(filename)
+    first = 0
+    if start_event is not None:
+        for block in blocks:
+            if block.first_event > start_event:
+                break
+            if block.flags & BLOCK_CHECKPOINT:
+                first = block.first_event
+    # the events checkpoint blocks start at, with the bytes of the log
+    # before and whether it is a resync checkpoint; of the blocks starting
+    # at the same event, the last is the one recreating the past from there
+    # starts from
+    starts = []
+    size = 0
+    for block in blocks:
+        if block.flags & BLOCK_CHECKPOINT and block.first_event > first:
+            start = (block.first_event, size, bool(block.flags & BLOCK_RESYNC))
+            if starts and starts[-1][0] == block.first_event:
+                starts[-1] = start
+            else:
+                starts.append(start)
+        size += block.stored_size
+    chosen = []
+    for i in range(1, count):
+        for start in starts:
+            if start[1] >= size * i / count:
+                if not chosen or start[0] > chosen[-1][0]:
+                    chosen.append(start)
+                break
+    events = [event for event, before, resync in chosen]
+    return list(zip([start_event] + events, events + [None],
+                    [False] + [resync for event, before, resync in chosen]))
+
+def recreate_segment(filename, sqlite_filename, start_event, stop_event):
+    conn = sqlite3.connect(sqlite_filename)
+    define_schema(conn)
+    recreate = recreate_native or recreate_past
+    # the progress of the workers would only garble each other's
+    with open(os.devnull, "w") as devnull:
+        stdout = sys.stdout
+        sys.stdout = devnull
+        try:
+            result = recreate(conn, filename, start_event, stop_event)
+        finally:
+            sys.stdout = stdout
+    conn.close()
+    return result
+
+def shift_refs(data, offset):
+    return re.sub(r"\*(\d+)", lambda match: "*" + str(int(match.group(1)) + offset), data)
+
+def merge_segment(conn, sqlite_filename, result, restates, stacks, heap_version):
+    """Merges the database sqlite_filename a segment was recreated into into
+    conn, given what recreating it returned, whether the checkpoint it
+    starts from restates the end of the segments before, the calls on their
+    stacks at the end, and the last heap version they gave. Returns the
+    calls on the stacks at the end of the segment, and the last heap
+    version it gives."""
+    c = conn.cursor()
+    c.execute("ATTACH DATABASE ? AS segment", (sqlite_filename,))
+    c.execute("CREATE TEMP TABLE CallMap (old integer primary key, new integer)")
+    c.execute("CREATE TEMP TABLE CodeFileMap (old integer primary key, new integer)")
+
+    # the calls the checkpoint pushes are those left on the stacks
+    base = 1
+    if restates:
+        base, checkpoint_calls = result["checkpoint"]
+        pushed = {}
+        for id, name, thread_id in c.execute(
+                "SELECT id, fun_name, thread_id FROM segment.FunCall WHERE id <= ? "
+                "ORDER BY id", (checkpoint_calls,)).fetchall():
+            pushed.setdefault(thread_id, []).append((id, name))
+        for thread_id, calls in pushed.items():
+            left = stacks.get(thread_id, [])
+            names = [c.execute("SELECT fun_name FROM FunCall WHERE id = ?",
+                               (id,)).fetchone()[0] for id in left]
+            if names == [name for id, name in calls]:
+                c.executemany("INSERT INTO temp.CallMap VALUES (?, ?)",
+                              [(id, new) for (id, name), new in zip(calls, left)])
+
+    for id, file_path, source in c.execute(
+            "SELECT * FROM segment.CodeFile").fetchall():
+        row = c.execute("SELECT id FROM CodeFile WHERE file_path = ?",
+                        (file_path,)).fetchone()
+        if row is None:
+            c.execute("INSERT INTO CodeFile VALUES "
+                      "((SELECT ifnull(max(id), 0) + 1 FROM CodeFile), ?, ?)",
+                      (file_path, source))
+            row = (c.lastrowid,)
+        c.execute("INSERT INTO temp.CodeFileMap VALUES (?, ?)", (id, row[0]))
+
+    def last_id(table):
+        return c.execute("SELECT ifnull(max(id), 0) FROM " + table).fetchone()[0]
+
+    snapshot_offset = last_id("Snapshot")
+    call_offset = last_id("FunCall")
+    object_offset = last_id("Object")
+    error_offset = last_id("Error")
+    version_offset = heap_version - base
+    # the ids after the calls the checkpoint pushes follow on those before,
+    # when it pushes the calls left on the stacks and no other
+    mapped = c.execute("SELECT count(*) FROM temp.CallMap").fetchone()[0]
+    if restates and mapped == result["checkpoint"][1]:
+        call_offset -= mapped
+    new_call = ("coalesce((SELECT new FROM temp.CallMap WHERE old = {0}), "
+                "{0} + %d)" % call_offset)
+
+    c.execute("INSERT INTO Object SELECT id + ?, "
+              "CASE WHEN chunked THEN shift_refs(data, ?) ELSE data END, chunked "
+              "FROM segment.Object", (object_offset, object_offset))
+    c.execute("INSERT INTO Error SELECT id + ?, message FROM segment.Error",
+              (error_offset,))
+    c.execute("INSERT INTO HeapRef SELECT id, heap_version + ?, object_id + ? "
+              "FROM segment.HeapRef WHERE heap_version > ?",
+              (version_offset, object_offset, base))
+    c.execute("INSERT INTO FunCall SELECT " + new_call.format("id") + ", "
+              "fun_name, locals, globals, closure_cellvars, closure_freevars, " +
+              new_call.format("parent_id") + ", "
+              "(SELECT new FROM temp.CodeFileMap WHERE old = code_file_id), thread_id "
+              "FROM segment.FunCall WHERE id NOT IN (SELECT old FROM temp.CallMap)")
+    c.execute("INSERT INTO Snapshot SELECT id + ?, " + new_call.format("fun_call_id") +
+              ", heap + ?, line_no, error_id + ? FROM segment.Snapshot",
+              (snapshot_offset, version_offset, error_offset))
+    c.execute("INSERT INTO VariableChange SELECT " + new_call.format("fun_call_id") +
+              ", name, heap_version + ? FROM segment.VariableChange "
+              "WHERE heap_version > ?", (version_offset, base))
+    # before its first step, the last step is that of the segments before
+    c.execute("INSERT INTO Elision SELECT ifnull(snapshot_id + ?, nullif(?, 0)), " +
+              new_call.format("fun_call_id") + ", fun_name, calls, iterations "
+              "FROM segment.Elision", (snapshot_offset, snapshot_offset))
+
+    stacks = {}
+    for thread_id, ids in result["stacks"].items():
+        stacks[thread_id] = [c.execute("SELECT " + new_call.format("?"),
+                                       (id, id)).fetchone()[0] for id in ids]
+    last_version = c.execute(
+        "SELECT max(ifnull((SELECT max(heap_version) FROM segment.HeapRef), 0), "
+        "ifnull((SELECT max(heap) FROM segment.Snapshot), 0), ?)",
+        (base,)).fetchone()[0]
+    conn.commit()
+    c.execute("DROP TABLE temp.CallMap")
+    c.execute("DROP TABLE temp.CodeFileMap")
+    c.execute("DETACH DATABASE segment")
+    return stacks, last_version + version_offset
+
+def recreate_parallel(conn, filename, start_event=None, workers=None):
+    """Recreates the log in filename into conn as recreate_past() does, in
+    segments recreated by as many worker processes, or os.cpu_count()."""
+    workers = workers or os.cpu_count()
+    # a few segments per worker even out how long they take
+    segments = split_segments(filename, workers * 4, start_event)
+    if len(segments) == 1:
+        recreate = recreate_native or recreate_past
+        recreate(conn, filename, start_event)
+        return
+    conn.create_function("shift_refs", 2, shift_refs)
+    with tempfile.TemporaryDirectory() as directory, \
+            ProcessPoolExecutor(workers) as executor:
+        names = [os.path.join(directory, "%d.sqlite" % i)
+                 for i in range(len(segments))]
+        futures = [executor.submit(recreate_segment, filename, name, start, stop)
+                   for name, (start, stop, resync) in zip(names, segments)]
+        stacks = {}
+        heap_version = 1
+        for i, (name, future) in enumerate(zip(names, futures)):
+            restates = i > 0 and not segments[i][2]
+            stacks, heap_version = merge_segment(conn, name, future.result(),
+                                                 restates, stacks, heap_version)
+            os.remove(name)
+            print("\rSegment %d of %d" % (i + 1, len(segments)), end='')
 
 def main():
-    if len(sys.argv) < 2:
+    args = sys.argv[1:]
+    # -j N recreates the log in segments with N worker processes
+    workers = None
+    if len(args) > 1 and args[0] == "-j":
+        workers = int(args[1])
+        args = args[2:]
+    if len(args) < 1:
         print("Please provide a .rewind file.")
         return
-    filename = sys.argv[1]
+    filename = args[0]
+    # optionally, only recreate the past from the last checkpoint before
+    # the given event on
+    start_event = int(args[1]) if len(args) > 1 else None
     
     sqlite_filename = re.sub("\.rewind$", ".sqlite", filename)
     print("Reading from " + filename)
@@ -802,6 +1220,14 @@ def main():
         os.remove(sqlite_filename)
     conn = sqlite3.connect(sqlite_filename)
     define_schema(conn)
-    recreate_past(conn, filename)
+    if workers is not None and workers > 1:
+        recreate_parallel(conn, filename, start_event, workers)
+    else:
+        recreate = recreate_native or recreate_past
+        recreate(conn, filename, start_event)
+    define_indexes(conn)
+    print()
+    print("Complete")
 
-main()
\ No newline at end of file
+if __name__ == "__main__":
+    main()
\ No newline at end of file
@@ -0,0 +1,422 @@
+# Reader for the binary .rewind log format written by Modules/rewind.c.
+# The format is described in Include/rewindlog.h; keep the two in sync.
+
+import glob
+import os
+import select
+import struct
+import tempfile
+import zlib
+from collections import namedtuple
+
+MAGIC = b"RWND"
+VERSION = 11
+COMPRESS_NONE = 0
+COMPRESS_ZLIB = 1
+BLOCK_CHECKPOINT = 1
+BLOCK_RESYNC = 2
+
+# Event names and field layouts, indexed by opcode
+EVENTS = [
+    None,
+    ("LOG", "t"),
+    ("VISIT", "l"),
+    ("PUSH_FRAME", "c h h *v"),
+    ("POP_FRAME", "s s"),
+    ("STORE_DEREF", "h v"),
+    ("LIST_APPEND", "h v"),
+    ("LIST_INSERT", "h i v"),
+    ("LIST_EXTEND", "h v"),
+    ("LIST_REMOVE", "h v"),
+    ("LIST_POP", "h i"),
+    ("LIST_CLEAR", "h"),
+    ("LIST_REVERSE", "h"),
+    ("LIST_SORT", "h *v"),
+    ("LIST_STORE_SUBSCRIPT", "h v v"),
+    ("LIST_STORE_SUBSCRIPT_SLICE", "h v v v v"),
+    ("LIST_DELETE_SUBSCRIPT", "h v"),
+    ("LIST_DELETE_SUBSCRIPT_SLICE", "h v v v"),
+    ("DICT_STORE_SUBSCRIPT", "h v v"),
+    ("DICT_DELETE_SUBSCRIPT", "h v"),
+    ("DICT_UPDATE", "h v"),
+    ("DICT_CLEAR", "h"),
+    ("DICT_POP", "h v"),
+    ("DICT_POP_ITEM", "h v"),
+    ("DICT_SET_DEFAULT", "h v v"),
+    ("SET_ADD", "h v"),
+    ("SET_DISCARD", "h v"),
+    ("SET_CLEAR", "h"),
+    ("SET_UPDATE", "h #v #v"),
+    ("YIELD_VALUE", "v"),
+    ("RETURN_VALUE", "v"),
+    ("STORE_NAME", "h v v"),
+    ("STORE_FAST", "u v"),
+    ("STORE_GLOBAL", "h v v"),
+    ("DELETE_GLOBAL", "h s"),
+    ("STORE_ATTR", "h v v"),
+    ("STRING_INPLACE_ADD_RESULT", "h t"),
+    ("NEW_LIST", "h *v"),
+    ("NEW_STRING", "h s"),
+    ("NEW_DICT", "h *v"),
+    ("NEW_SET", "h *v"),
+    ("NEW_TUPLE", "h *v"),
+    ("NEW_OBJECT", "h v"),
+    ("CHECKPOINT", "u"),
+    ("CHECKPOINT_END", ""),
+    ("LIST_PERMUTE", "h *u"),
+    ("THREAD", "u"),
+    ("INPUT", "u v"),
+    ("LIST_SPLICE", "h u u *v"),
+    ("NEW_TUPLE_COPY", "h u"),
+    ("ELIDED", "c u u"),
+]
+
+VALUE_NONE = 0
+VALUE_FALSE = 1
+VALUE_TRUE = 2
+VALUE_INT = 3
+VALUE_BIGINT = 4
+VALUE_FLOAT = 5
+VALUE_REF = 6
+VALUE_BYTES = 7
+
+# Sources of INPUT events, indexed by their number
+INPUT_SOURCES = [
+    "ARGV",
+    "ENVIRON",
+    "HASH_SEED",
+    "CLOCK",
+    "URANDOM",
+    "RANDOM_SEED",
+    "READ",
+    "RECV",
+]
+
+unpack_double = struct.Struct("<d").unpack_from
+
+BLOCK_HEADER = struct.Struct("<IIQIII")
+
+# offset is where the block data starts in the file
+Block = namedtuple("Block", "offset stored_size size first_event min_line max_line flags")
+
+# The names of a code object, as given by "c" fields
+Code = namedtuple("Code", "filename name varnames cellvars freevars")
+
+class LogReader(object):
+    """Reads the blocks and events of a .rewind log.
+
+    Heap ids are returned as ints, values that refer to heap objects as
+    ref_type(heap_id), and code objects as Code tuples.
+    """
+
+    def __init__(self, file, ref_type=int):
+        self.file = file
+        self.ref_type = ref_type
+        header = file.read(len(MAGIC) + 2)
+        if header[:len(MAGIC)] != MAGIC:
+            raise ValueError("not a rewind log")
+        if header[len(MAGIC)] != VERSION:
+            raise ValueError("unsupported rewind log version %d" % header[len(MAGIC)])
+        self.compression = header[len(MAGIC) + 1]
+        if self.compression not in (COMPRESS_NONE, COMPRESS_ZLIB):
+            raise ValueError("unknown rewind log compression %d" % self.compression)
+        self.blocks_offset = file.tell()
+        fields = {
+            "h": self.read_heap_id,
+            "l": self.read_line,
+            "u": self.read_uvarint,
+            "i": self.read_varint,
+            "s": self.read_symbol,
+            "c": self.read_code,
+            "t": self.read_text,
+            "v": self.read_value,
+        }
+        self.layouts = [None]
+        for name, layout in EVENTS[1:]:
+            self.layouts.append((name, [
+                (field[0] if field[0] in "#*" else None, fields[field[-1]])
+                for field in layout.split()
+            ]))
+
+    def blocks(self):
+        """Yields the Block headers of the log, without reading their data.
+
+        A last block cut short, as left by a crash, is ignored.
+        """
+        size = os.fstat(self.file.fileno()).st_size
+        offset = self.blocks_offset
+        while offset + BLOCK_HEADER.size <= size:
+            self.file.seek(offset)
+            header = self.file.read(BLOCK_HEADER.size)
+            block = Block(offset + BLOCK_HEADER.size, *BLOCK_HEADER.unpack(header))
+            if block.offset + block.stored_size > size:
+                return
+            yield block
+            offset = block.offset + block.stored_size
+
+    def events(self, block, checkpoint=False):
+        """Yields the events of a block as (name, args) pairs.
+
+        The checkpoint the block may start with is skipped, unless
+        checkpoint is true or the block is flagged BLOCK_RESYNC.
+        """
+        self.file.seek(block.offset)
+        data = self.file.read(block.stored_size)
+        if self.compression == COMPRESS_ZLIB:
+            data = zlib.decompress(data)
+        self.buf = data
+        self.pos = 0
+        self.symbols = []
+        self.codes = []
+        self.tuples = []
+        self.last_heap_ids = [0, 0]
+        self.last_line = 0
+        in_checkpoint = False
+        checkpoint = checkpoint or block.flags & BLOCK_RESYNC
+        while self.pos < len(data):
+            event = self.read_event()
+            if event is None:
+                continue
+            if event[0] == "CHECKPOINT":
+                in_checkpoint = True
+            skip = in_checkpoint and not checkpoint
+            if event[0] == "CHECKPOINT_END":
+                in_checkpoint = False
+            if not skip:
+                yield event
+
+    def read_event(self):
+        opcode = self.buf[self.pos]
+        self.pos += 1
+        name, layout = self.layouts[opcode]
+        args = []
+        for repeat, read in layout:
+            if repeat is None:
+                args.append(read())
+                continue
+            count = self.read_uvarint()
+            if repeat == "#":
+                args.append(count)
+            for i in range(count):
+                args.append(read())
+        if name == "LOG":
+            return None
+        if name == "NEW_TUPLE":
+            self.tuples.append(args[1:])
+        elif name == "NEW_TUPLE_COPY":
+            return "NEW_TUPLE", [args[0]] + self.tuples[args[1]]
+        return name, args
+
+    def read_uvarint(self):
+        buf = self.buf
+        pos = self.pos
+        byte = buf[pos]
+        pos += 1
+        result = byte & 0x7f
+        shift = 7
+        while byte & 0x80:
+            byte = buf[pos]
+            pos += 1
+            result |= (byte & 0x7f) << shift
+            shift += 7
+        self.pos = pos
+        return result
+
+    def read_varint(self):
+        value = self.read_uvarint()
+        return (value >> 1) ^ -(value & 1)
+
+    def read_heap_id(self):
+        value = self.read_uvarint()
+        base = value & 1
+        value >>= 1
+        heap_id = self.last_heap_ids[base] + ((value >> 1) ^ -(value & 1))
+        self.last_heap_ids[base] = heap_id
+        return heap_id
+
+    def read_line(self):
+        self.last_line += self.read_varint()
+        return self.last_line
+
+    def read_text(self):
+        length = self.read_uvarint()
+        end = self.pos + length
+        text = self.buf[self.pos:end].decode("utf-8", "surrogatepass")
+        self.pos = end
+        return text
+
+    def read_symbol(self):
+        index = self.read_uvarint()
+        if index == 0:
+            symbol = self.read_text()
+            self.symbols.append(symbol)
+            return symbol
+        return self.symbols[index - 1]
+
+    def read_symbols(self):
+        return tuple(self.read_symbol() for i in range(self.read_uvarint()))
+
+    def read_code(self):
+        index = self.read_uvarint()
+        if index == 0:
+            code = Code(self.read_symbol(), self.read_symbol(),
+                        self.read_symbols(), self.read_symbols(), self.read_symbols())
+            self.codes.append(code)
+            return code
+        return self.codes[index - 1]
+
+    def read_value(self):
+        tag = self.buf[self.pos]
+        self.pos += 1
+        if tag == VALUE_REF:
+            return self.ref_type(self.read_heap_id())
+        elif tag == VALUE_INT:
+            return self.read_varint()
+        elif tag == VALUE_NONE:
+            return None
+        elif tag == VALUE_TRUE:
+            return True
+        elif tag == VALUE_FALSE:
+            return False
+        elif tag == VALUE_FLOAT:
+            value, = unpack_double(self.buf, self.pos)
+            self.pos += 8
+            return value
+        elif tag == VALUE_BIGINT:
+            return int(self.read_text())
+        elif tag == VALUE_BYTES:
+            length = self.read_uvarint()
+            end = self.pos + length
+            data = self.buf[self.pos:end]
+            self.pos = end
+            return data
+        else:
+            raise ValueError("unknown value tag %d" % tag)
+
+def read_blocks(filename):
+    """Returns the Block headers of the .rewind log in filename."""
+    with open(filename, "rb") as file:
+        return list(LogReader(file).blocks())
+
+def read_log(filename, ref_type=int, first_event=0, stop_event=None):
+    """Yields the events of the .rewind log in filename as (name, args),
+    starting from the event with index first_event, up to the first block
+    that starts at or after the event with index stop_event, if not None.
+
+    Only the blocks from the one holding first_event on are decompressed.
+    """
+    with open(filename, "rb") as file:
+        reader = LogReader(file, ref_type)
+        blocks = list(reader.blocks())
+        start = 0
+        while start + 1 < len(blocks) and blocks[start + 1].first_event <= first_event:
+            start += 1
+        for block in blocks[start:]:
+            if stop_event is not None and block.first_event >= stop_event:
+                return
+            index = block.first_event
+            in_checkpoint = False
+            for event in reader.events(block):
+                if event[0] == "CHECKPOINT":
+                    in_checkpoint = True
+                if index >= first_event:
+                    yield event
+                if not in_checkpoint:
+                    index += 1
+                if event[0] == "CHECKPOINT_END":
+                    in_checkpoint = False
+
+def replay_log(filename, event, ref_type=int, stop_event=None):
+    """Yields the events to replay to get to the state of the program at the
+    event with index event, as (name, args): the contents of the last
+    checkpoint at or before it, from its CHECKPOINT event (whose argument is
+    the index of the event after the checkpoint) to its CHECKPOINT_END
+    event, and all events from there on, up to the first block that starts
+    at or after the event with index stop_event, if not None. Without such a
+    checkpoint, this is the whole log.
+    """
+    with open(filename, "rb") as file:
+        reader = LogReader(file, ref_type)
+        blocks = list(reader.blocks())
+        start = 0
+        for i, block in enumerate(blocks):
+            if block.first_event > event:
+                break
+            if block.flags & BLOCK_CHECKPOINT:
+                start = i
+        for i, block in enumerate(blocks[start:]):
+            if stop_event is not None and block.first_event >= stop_event and i > 0:
+                return
+            yield from reader.events(block, checkpoint=i == 0)
+
+def fork_checkpoints(filename):
+    """Returns the fork checkpoints of the .rewind log in filename, as taken
+    with the "fork" recording option, as (event, fifo) pairs in the order of
+    their events: the index of the event each was taken before, and the
+    FIFO its frozen process takes requests from.
+    """
+    prefix = filename + "."
+    checkpoints = []
+    for fifo in glob.glob(glob.escape(filename) + ".*.fork"):
+        event = fifo[len(prefix):-len(".fork")]
+        if event.isdigit():
+            checkpoints.append((int(event), fifo))
+    return sorted(checkpoints)
+
+def seek(filename, event, seek_filename):
+    """Runs the program recorded into the .rewind log in filename forward to
+    the event with index event, from the last fork checkpoint at or before
+    it, recording it from there into a new log at seek_filename. That log
+    ends with a checkpoint of the state of the program at the event, unless
+    the program ended before; replay_log(seek_filename, event) gives it.
+
+    Returns the index of the event the fork checkpoint was taken before, or
+    None if there is none to run from. Raises OSError if the run failed.
+    """
+    candidates = [c for c in fork_checkpoints(filename) if c[0] <= event]
+    for start, fifo in reversed(candidates):
+        try:
+            fd = os.open(fifo, os.O_WRONLY | os.O_NONBLOCK)
+        except OSError:
+            # its process is gone
+            continue
+        with tempfile.TemporaryDirectory() as directory:
+            reply = os.path.join(directory, "reply")
+            os.mkfifo(reply)
+            reply_fd = os.open(reply, os.O_RDONLY | os.O_NONBLOCK)
+            try:
+                try:
+                    os.write(fd, b"seek %d %s %s\n" % (event, os.fsencode(reply),
+                             os.fsencode(os.path.abspath(seek_filename))))
+                finally:
+                    os.close(fd)
+                status = b""
+                while not status.endswith(b"\n"):
+                    select.select([reply_fd], [], [])
+                    data = os.read(reply_fd, 64)
+                    if not data:
+                        raise OSError("the fork checkpoint at event %d is gone" % start)
+                    status += data
+            finally:
+                os.close(reply_fd)
+        if int(status) != 0:
+            raise OSError("running forward from the fork checkpoint at event %d "
+                          "failed with status %d" % (start, int(status)))
+        return start
+    return None
+
+def release_fork_checkpoints(filename):
+    """Has the frozen processes of the fork checkpoints of the .rewind log in
+    filename exit."""
+    for event, fifo in fork_checkpoints(filename):
+        try:
+            fd = os.open(fifo, os.O_WRONLY | os.O_NONBLOCK)
+        except OSError:
+            fd = None
+        try:
+            os.unlink(fifo)
+        except OSError:
+            pass
+        if fd is not None:
+            os.write(fd, b"quit\n")
+            os.close(fd)
@@ -0,0 +1,152 @@
+# Looks up when things changed in a database recreate.py recreated the past
+# of a program into: the steps that changed a heap object, or a variable of
+# a function call, and the last one before or the first one after a given
+# step, as a debugger needs to run back or forward to the step that set a
+# value (a reverse watchpoint).
+#
+# A step is the id of the Snapshot taken when it began. Every change gives
+# a new heap version, and a Snapshot holds the last version before it, so
+# the change with version v was made by the step of the last Snapshot whose
+# heap is less than v. The versions of an object are found by HeapRef's
+# primary key, those of a variable in VariableChange, and the step of a
+# version by the Snapshot_heap index, all in a few B-tree lookups.
+#
+#     ./python -X rewind=off rewindquery.py prog.sqlite object HEAP_ID [STEP]
+#     ./python -X rewind=off rewindquery.py prog.sqlite var FUN_CALL NAME [STEP]
+#
+# lists the steps that changed the object or the variable, or, given a
+# step, the last one at or before it and the next one after it.
+#
+#     ./python -X rewind=off rewindquery.py prog.sqlite elided [STEP]
+#
+# lists where a program recorded with the sample option had calls or loop
+# iterations left out of its log, or what was left out right after a step,
+# which has no steps of its own to run back or forward to.
+
+import sqlite3
+import sys
+
+def step_of(conn, heap_version):
+    """Returns the step that made the change with heap_version, None if it
+    was made before the first one."""
+    row = conn.execute(
+        "SELECT id FROM Snapshot WHERE heap < ? ORDER BY heap DESC, id DESC LIMIT 1",
+        (heap_version,)).fetchone()
+    return row and row[0]
+
+def heap_at(conn, step):
+    """Returns the heap version of the state the program was in at step."""
+    row = conn.execute("SELECT heap FROM Snapshot WHERE id = ?", (step,)).fetchone()
+    if row is None:
+        raise KeyError("no step %d" % step)
+    return row[0]
+
+def _steps(conn, versions):
+    return [(step_of(conn, version), version) for (version,) in versions]
+
+def _last(conn, query, params, step):
+    row = conn.execute(query + " AND heap_version <= ? ORDER BY heap_version DESC LIMIT 1",
+                       params + (heap_at(conn, step),)).fetchone()
+    return row and (step_of(conn, row[0]), row[0])
+
+def _next(conn, query, params, step):
+    row = conn.execute(query + " AND heap_version > ? ORDER BY heap_version LIMIT 1",
+                       params + (heap_at(conn, step),)).fetchone()
+    return row and (step_of(conn, row[0]), row[0])
+
+OBJECT_VERSIONS = "SELECT heap_version FROM HeapRef WHERE id = ?"
+VARIABLE_VERSIONS = ("SELECT heap_version FROM VariableChange "
+                     "WHERE fun_call_id = ? AND name = ?")
+
+def object_changes(conn, heap_id):
+    """Returns the changes to the heap object heap_id as (step,
+    heap_version) pairs, in the order they were made."""
+    return _steps(conn, conn.execute(OBJECT_VERSIONS + " ORDER BY heap_version",
+                                     (heap_id,)))
+
+def last_object_change(conn, heap_id, step):
+    """Returns the last change to the heap object heap_id in the state the
+    program was in at step, as (step, heap_version), or None."""
+    return _last(conn, OBJECT_VERSIONS, (heap_id,), step)
+
+def next_object_change(conn, heap_id, step):
+    """Returns the first change to the heap object heap_id after the state
+    the program was in at step, as (step, heap_version), or None."""
+    return _next(conn, OBJECT_VERSIONS, (heap_id,), step)
+
+def variable_changes(conn, fun_call_id, name):
+    """Returns the changes to the variable name of the function call
+    fun_call_id, or of the module a global is in, as (step, heap_version)
+    pairs, in the order they were made."""
+    return _steps(conn, conn.execute(VARIABLE_VERSIONS + " ORDER BY heap_version",
+                                     (fun_call_id, name)))
+
+def last_variable_change(conn, fun_call_id, name, step):
+    """Returns the last change to the variable name of the function call
+    fun_call_id in the state the program was in at step, as (step,
+    heap_version), or None."""
+    return _last(conn, VARIABLE_VERSIONS, (fun_call_id, name), step)
+
+def next_variable_change(conn, fun_call_id, name, step):
+    """Returns the first change to the variable name of the function call
+    fun_call_id after the state the program was in at step, as (step,
+    heap_version), or None."""
+    return _next(conn, VARIABLE_VERSIONS, (fun_call_id, name), step)
+
+ELISIONS = ("SELECT snapshot_id, fun_call_id, fun_name, calls, iterations "
+            "FROM Elision")
+
+def elisions(conn, step=None):
+    """Returns what sampling left out, after step if given, as (step,
+    fun_call_id, fun_name, calls, iterations) rows: the calls of fun_name
+    left out, made from fun_call_id, or if iterations isn't 0, the
+    iterations of a loop fun_call_id ran and the calls they made."""
+    if step is None:
+        return conn.execute(ELISIONS + " ORDER BY rowid").fetchall()
+    return conn.execute(ELISIONS + " WHERE snapshot_id IS ? ORDER BY rowid",
+                        (step,)).fetchall()
+
+def print_elisions(conn, after):
+    for step, fun_call_id, fun_name, calls, iterations in elisions(conn, after):
+        if iterations:
+            print("after step %s: %d iterations in %s (call %s), making %d calls" %
+                  (step, iterations, fun_name, fun_call_id, calls))
+        else:
+            print("after step %s: %d calls of %s from call %s" %
+                  (step, calls, fun_name, fun_call_id))
+
+def main():
+    usage = ("usage: rewindquery.py DATABASE object HEAP_ID [STEP]\n"
+             "       rewindquery.py DATABASE var FUN_CALL NAME [STEP]\n"
+             "       rewindquery.py DATABASE elided [STEP]")
+    args = sys.argv[1:]
+    if len(args) in (2, 3) and args[1] == "elided":
+        print_elisions(sqlite3.connect(args[0]), int(args[2]) if args[2:] else None)
+        return
+    if len(args) < 3 or args[1] not in ("object", "var"):
+        sys.exit(usage)
+    conn = sqlite3.connect(args[0])
+    if args[1] == "object":
+        key = (int(args[2]),)
+        rest = args[3:]
+        changes, last, next = object_changes, last_object_change, next_object_change
+    else:
+        if len(args) < 4:
+            sys.exit(usage)
+        key = (int(args[2]), args[3])
+        rest = args[4:]
+        changes, last, next = variable_changes, last_variable_change, next_variable_change
+    if not rest:
+        for step, version in changes(conn, *key):
+            print("step %s (heap version %d)" % (step, version))
+        return
+    step = int(rest[0])
+    for label, change in (("last", last(conn, *key, step)),
+                          ("next", next(conn, *key, step))):
+        if change is None:
+            print("%s: none" % label)
+        else:
+            print("%s: step %s (heap version %d)" % (label, change[0], change[1]))
+
+if __name__ == "__main__":
+    main()
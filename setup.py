@@ -1545,8 +1545,18 @@ def detect_sqlite(self):
                                library_dirs=sqlite_libdir,
                                extra_link_args=sqlite_extra_link_args,
                                libraries=["sqlite3",]))
+            # Native importer of rewind logs, on _sqlite3 connections
+            rewindimport_libs = ["sqlite3"]
+            if sysconfig.get_config_var("HAVE_LIBZ"):
+                rewindimport_libs.append("z")
+            self.add(Extension('_rewindimport', ['_rewindimport.c'],
+                               define_macros=sqlite_defines,
+                               include_dirs=include_dirs,
+                               library_dirs=sqlite_libdir,
+                               extra_link_args=sqlite_extra_link_args,
+                               libraries=rewindimport_libs))
         else:
-            self.missing.append('_sqlite3')
+            self.missing.extend(['_sqlite3', '_rewindimport'])
 
     def detect_platform_specific_exts(self):
         # Unix-only modules